@@ -0,0 +1,84 @@
+/**
+ * bench/endpoint.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "harness.h"
+
+#include <sfd/net/ip-endpoint.h>
+#include <sfd/net/unix-endpoint.h>
+
+using namespace sfd;
+using namespace sfd::net;
+using namespace sfd::bench;
+
+/**
+ * The cost of converting endpoints to and from native socket addresses, which happens on
+ * every send_to, recv_from, connect and accept.
+ */
+
+static void endpoint_ip_create_sockaddr(State& state)
+{
+	IPEndPoint ep(IPAddress::localhost(), 8080);
+	socklen_t len;
+
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		struct sockaddr *sa = ep.create_sockaddr(len);
+		ep.free_sockaddr(sa);
+	}
+}
+
+static void endpoint_ip_from_sockaddr(State& state)
+{
+	IPEndPoint ep(IPAddress::localhost(), 8080);
+	socklen_t len;
+	struct sockaddr *sa = ep.create_sockaddr(len);
+
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		delete EndPoint::from_sockaddr(sa);
+	}
+
+	ep.free_sockaddr(sa);
+}
+
+static void endpoint_unix_create_sockaddr(State& state)
+{
+	UnixEndPoint ep("/tmp/sfd-bench.sock");
+	socklen_t len;
+
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		struct sockaddr *sa = ep.create_sockaddr(len);
+		ep.free_sockaddr(sa);
+	}
+}
+
+static void endpoint_unix_from_sockaddr(State& state)
+{
+	UnixEndPoint ep("/tmp/sfd-bench.sock");
+	socklen_t len;
+	struct sockaddr *sa = ep.create_sockaddr(len);
+
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		delete EndPoint::from_sockaddr(sa);
+	}
+
+	ep.free_sockaddr(sa);
+}
+
+SFD_BENCHMARK("endpoint.ip.create_sockaddr", endpoint_ip_create_sockaddr);
+SFD_BENCHMARK("endpoint.ip.from_sockaddr", endpoint_ip_from_sockaddr);
+SFD_BENCHMARK("endpoint.unix.create_sockaddr", endpoint_unix_create_sockaddr);
+SFD_BENCHMARK("endpoint.unix.from_sockaddr", endpoint_unix_from_sockaddr);
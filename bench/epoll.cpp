@@ -0,0 +1,80 @@
+/**
+ * bench/epoll.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "harness.h"
+
+#include <sfd/epoll.h>
+#include <sfd/event.h>
+#include <vector>
+
+using namespace sfd;
+using namespace sfd::bench;
+
+/**
+ * The cost of Epoll::wait returning, and building the event list for, a number of ready file
+ * descriptors.  The descriptors are signalled eventfds registered level-triggered, so that
+ * they stay ready for every wait.
+ */
+static void epoll_wait_ready(State& state, unsigned int ready)
+{
+	state.pause();
+
+	Epoll epoll;
+	std::vector<Event *> fds;
+
+	for (unsigned int i = 0; i < ready; i++) {
+		Event *event = new Event();
+		event->invoke();
+		epoll.add(event, EpollEventType::IN);
+		fds.push_back(event);
+	}
+
+	std::vector<EpollEvent> events;
+	state.resume();
+
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		events.clear();
+		epoll.wait(events, ready, 0);
+	}
+
+	state.pause();
+	state.items(state.iterations() * ready);
+
+	for (Event *event : fds) {
+		delete event;
+	}
+}
+
+static void epoll_wait_1(State& state)
+{
+	epoll_wait_ready(state, 1);
+}
+
+static void epoll_wait_64(State& state)
+{
+	epoll_wait_ready(state, 64);
+}
+
+static void epoll_wait_1024(State& state)
+{
+	epoll_wait_ready(state, 1024);
+}
+
+SFD_BENCHMARK("epoll.wait.1", epoll_wait_1);
+SFD_BENCHMARK("epoll.wait.64", epoll_wait_64);
+SFD_BENCHMARK("epoll.wait.1024", epoll_wait_1024);
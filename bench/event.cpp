@@ -0,0 +1,71 @@
+/**
+ * bench/event.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "harness.h"
+
+#include <sfd/event.h>
+#include <atomic>
+#include <thread>
+
+using namespace sfd;
+using namespace sfd::bench;
+
+/**
+ * The cost of signalling an eventfd, and the latency of waking another thread with one.
+ */
+
+static void event_invoke(State& state)
+{
+	Event event;
+
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		event.invoke();
+	}
+}
+
+static void event_wakeup(State& state)
+{
+	state.pause();
+
+	Event ping, pong;
+	std::atomic<uint64_t> sent_at(0);
+
+	// The other thread blocks on the first eventfd, records how long it took to wake up, and
+	// then wakes this thread with the second.
+	std::thread waiter([&]() {
+		for (uint64_t i = 0; i < state.iterations(); i++) {
+			ping.acknowledge();
+			state.latencies().record(metrics::now() - sent_at.load(std::memory_order_acquire));
+			pong.invoke();
+		}
+	});
+
+	state.resume();
+
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		sent_at.store(metrics::now(), std::memory_order_release);
+		ping.invoke();
+		pong.acknowledge();
+	}
+
+	state.pause();
+	waiter.join();
+}
+
+SFD_BENCHMARK("event.invoke", event_invoke);
+SFD_BENCHMARK("event.wakeup", event_wakeup);
@@ -0,0 +1,103 @@
+/**
+ * bench/fd.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "harness.h"
+
+#include <sfd/regular-file.h>
+#include <unistd.h>
+
+using namespace sfd;
+using namespace sfd::bench;
+
+/**
+ * The cost of the FileDescriptor::read and write wrappers, both out-of-line and inlined,
+ * against the raw system calls on the same descriptors.
+ */
+
+static void fd_read_wrapper(State& state)
+{
+	RegularFile zero("/dev/zero", FileOpenMode::READ);
+	char buffer[64];
+
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		zero.read(buffer, sizeof(buffer));
+	}
+}
+
+static void fd_read_inline(State& state)
+{
+	RegularFile zero("/dev/zero", FileOpenMode::READ);
+	char buffer[64];
+
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		zero.read_inline(buffer, sizeof(buffer));
+	}
+}
+
+static void fd_read_raw(State& state)
+{
+	RegularFile zero("/dev/zero", FileOpenMode::READ);
+	int fd = zero.fd();
+	char buffer[64];
+
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		if (::read(fd, buffer, sizeof(buffer)) < 0) {
+			break;
+		}
+	}
+}
+
+static void fd_write_wrapper(State& state)
+{
+	RegularFile null("/dev/null", FileOpenMode::WRITE);
+	char buffer[64] = { 0 };
+
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		null.write(buffer, sizeof(buffer));
+	}
+}
+
+static void fd_write_inline(State& state)
+{
+	RegularFile null("/dev/null", FileOpenMode::WRITE);
+	char buffer[64] = { 0 };
+
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		null.write_inline(buffer, sizeof(buffer));
+	}
+}
+
+static void fd_write_raw(State& state)
+{
+	RegularFile null("/dev/null", FileOpenMode::WRITE);
+	int fd = null.fd();
+	char buffer[64] = { 0 };
+
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		if (::write(fd, buffer, sizeof(buffer)) < 0) {
+			break;
+		}
+	}
+}
+
+SFD_BENCHMARK("fd.read.wrapper", fd_read_wrapper);
+SFD_BENCHMARK("fd.read.inline", fd_read_inline);
+SFD_BENCHMARK("fd.read.raw", fd_read_raw);
+SFD_BENCHMARK("fd.write.wrapper", fd_write_wrapper);
+SFD_BENCHMARK("fd.write.inline", fd_write_inline);
+SFD_BENCHMARK("fd.write.raw", fd_write_raw);
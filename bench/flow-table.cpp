@@ -0,0 +1,114 @@
+/**
+ * bench/flow-table.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "harness.h"
+
+#include <sfd/net/flow-table.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace sfd;
+using namespace sfd::net;
+using namespace sfd::bench;
+
+/**
+ * Per-datagram flow lookups over 64k active flows, against the string-keyed map that
+ * FlowTable replaces.
+ */
+
+static const unsigned int Flows = 65536;
+
+static std::vector<IPEndPoint> make_sources()
+{
+	std::vector<IPEndPoint> sources;
+
+	for (unsigned int i = 0; i < Flows; i++) {
+		sources.push_back(IPEndPoint(IPAddress::from_octets(10, (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff), 1024 + (i * 7919) % 60000));
+	}
+
+	return sources;
+}
+
+static void flow_table_find(State& state)
+{
+	state.pause();
+
+	std::vector<IPEndPoint> sources = make_sources();
+	IPEndPoint local(IPAddress::from_octets(10, 255, 0, 1), 9000);
+	FlowTable<uint64_t> table(60000000000ull);
+
+	for (const IPEndPoint& source : sources) {
+		table.insert(FlowKey::from(source, local));
+	}
+
+	state.resume();
+
+	uint64_t sum = 0;
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		sum += *table.find(FlowKey::from(sources[(i * 40503) % Flows], local));
+	}
+
+	if (sum == 1) {
+		state.pause();
+	}
+}
+
+static void flow_table_insert(State& state)
+{
+	state.pause();
+
+	std::vector<IPEndPoint> sources = make_sources();
+	IPEndPoint local(IPAddress::from_octets(10, 255, 0, 1), 9000);
+	FlowTable<uint64_t> table(60000000000ull, 16);
+
+	state.resume();
+
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		table.insert(FlowKey::from(sources[i % Flows], local))++;
+	}
+}
+
+static void flow_string_map_find(State& state)
+{
+	state.pause();
+
+	std::vector<IPEndPoint> sources = make_sources();
+	IPEndPoint local(IPAddress::from_octets(10, 255, 0, 1), 9000);
+	std::unordered_map<std::string, uint64_t> table;
+
+	for (const IPEndPoint& source : sources) {
+		table[source.address().to_string() + ":" + std::to_string(source.port())] = 0;
+	}
+
+	state.resume();
+
+	uint64_t sum = 0;
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		const IPEndPoint& source = sources[(i * 40503) % Flows];
+		sum += table[source.address().to_string() + ":" + std::to_string(source.port())];
+	}
+
+	if (sum == 1) {
+		state.pause();
+	}
+}
+
+SFD_BENCHMARK("flow_table.find", flow_table_find);
+SFD_BENCHMARK("flow_table.insert", flow_table_insert);
+SFD_BENCHMARK("flow_table.string_map_find", flow_string_map_find);
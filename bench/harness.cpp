@@ -0,0 +1,185 @@
+/**
+ * bench/harness.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "harness.h"
+
+#include <sfd/trace.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+
+using namespace sfd;
+using namespace sfd::bench;
+
+/**
+ * Runs the registered benchmarks, and prints one JSON object per benchmark on standard output.
+ *
+ * Usage: sfd-bench [--min-time <seconds>] [name-prefix...]
+ */
+
+namespace {
+	struct Benchmark {
+		const char *name;
+		BenchmarkFunction function;
+	};
+
+	std::vector<Benchmark>& benchmarks()
+	{
+		static std::vector<Benchmark> instance;
+		return instance;
+	}
+
+	bool selected(const char *name, const std::vector<std::string>& prefixes)
+	{
+		if (prefixes.empty()) {
+			return true;
+		}
+
+		for (const std::string& prefix : prefixes) {
+			if (strncmp(name, prefix.c_str(), prefix.size()) == 0) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	/**
+	 * Runs a benchmark with an increasing number of iterations, until a run takes at least the
+	 * minimum time, and reports that run.
+	 */
+	void run(const Benchmark& benchmark, uint64_t min_time_ns)
+	{
+		uint64_t iterations = 1;
+
+		for (;;) {
+			State state(iterations);
+
+			state.start();
+			benchmark.function(state);
+			state.stop();
+
+			if (state.elapsed_ns() >= min_time_ns || iterations >= (1ull << 40)) {
+				double ns_per_op = (double)state.elapsed_ns() / (double)state.iterations();
+				double items_per_sec = (double)state.item_count() * 1e9 / (double)(state.elapsed_ns() ? state.elapsed_ns() : 1);
+
+				printf("{\"benchmark\":\"%s\",\"metrics\":%d,\"trace\":%d,\"iterations\":%lu,\"elapsed_ns\":%lu,\"ns_per_op\":%.3f,\"items_per_sec\":%.1f",
+						benchmark.name, metrics::enabled(), trace::enabled(),
+						(unsigned long)state.iterations(), (unsigned long)state.elapsed_ns(), ns_per_op, items_per_sec);
+
+				const metrics::LatencyHistogram& latencies = state.latencies();
+				if (latencies.count() > 0) {
+					printf(",\"latency_count\":%lu,\"latency_p50_ns\":%lu,\"latency_p99_ns\":%lu,\"latency_p999_ns\":%lu,\"latency_max_ns\":%lu",
+							(unsigned long)latencies.count(), (unsigned long)latencies.percentile(50),
+							(unsigned long)latencies.percentile(99), (unsigned long)latencies.percentile(99.9),
+							(unsigned long)latencies.max());
+				}
+
+				printf("}\n");
+				fflush(stdout);
+				return;
+			}
+
+			// Aim a little past the minimum time, based on the rate of this run.
+			uint64_t next = iterations * 10;
+			if (state.elapsed_ns() > 0) {
+				uint64_t estimate = (uint64_t)((double)iterations * 1.2 * (double)min_time_ns / (double)state.elapsed_ns());
+				next = std::min(next, std::max(estimate, iterations + 1));
+			}
+
+			iterations = next;
+		}
+	}
+}
+
+State::State(uint64_t iterations)
+	: _iterations(iterations), _items(iterations), _elapsed_ns(0), _resumed_at(0), _running(false)
+{
+}
+
+void State::start()
+{
+	_elapsed_ns = 0;
+	resume();
+}
+
+void State::stop()
+{
+	pause();
+}
+
+/**
+ * Stops the clock, so that the work that follows is not measured.
+ */
+void State::pause()
+{
+	if (_running) {
+		_elapsed_ns += metrics::now() - _resumed_at;
+		_running = false;
+	}
+}
+
+/**
+ * Restarts the clock after a pause.
+ */
+void State::resume()
+{
+	if (!_running) {
+		_running = true;
+		_resumed_at = metrics::now();
+	}
+}
+
+Registration::Registration(const char *name, BenchmarkFunction function)
+{
+	benchmarks().push_back({ name, function });
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t min_time_ns = 200000000ull;
+	std::vector<std::string> prefixes;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+			min_time_ns = (uint64_t)(atof(argv[++i]) * 1e9);
+		} else {
+			prefixes.push_back(argv[i]);
+		}
+	}
+
+	// The epoll benchmarks need a thousand or so descriptors open at once.
+	struct rlimit limit;
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+
+	for (const Benchmark& benchmark : benchmarks()) {
+		if (selected(benchmark.name, prefixes)) {
+			run(benchmark, min_time_ns);
+		}
+	}
+
+	return 0;
+}
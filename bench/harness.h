@@ -0,0 +1,74 @@
+/**
+ * bench/harness.h
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <sfd/metrics.h>
+#include <cstdint>
+
+namespace sfd {
+	namespace bench {
+
+		/**
+		 * The state of one run of a benchmark.  A benchmark performs iterations() operations,
+		 * and may exclude setup work from the measurement with pause and resume.  Benchmarks
+		 * that process several items per iteration report the total with items, and
+		 * benchmarks that measure per-operation latency record it in latencies().
+		 */
+		class State {
+		public:
+			State(uint64_t iterations);
+
+			uint64_t iterations() const { return _iterations; }
+
+			void pause();
+			void resume();
+
+			void items(uint64_t count) { _items = count; }
+			metrics::LatencyHistogram& latencies() { return _latencies; }
+
+			void start();
+			void stop();
+
+			uint64_t elapsed_ns() const { return _elapsed_ns; }
+			uint64_t item_count() const { return _items; }
+			const metrics::LatencyHistogram& latencies() const { return _latencies; }
+
+		private:
+			uint64_t _iterations;
+			uint64_t _items;
+			uint64_t _elapsed_ns;
+			uint64_t _resumed_at;
+			bool _running;
+
+			metrics::LatencyHistogram _latencies;
+		};
+
+		typedef void (*BenchmarkFunction)(State& state);
+
+		/**
+		 * Registers a benchmark with the suite, when constructed statically.
+		 */
+		class Registration {
+		public:
+			Registration(const char *name, BenchmarkFunction function);
+		};
+	}
+}
+
+#define SFD_BENCHMARK(name, function) static ::sfd::bench::Registration registration_##function(name, function)
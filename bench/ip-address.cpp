@@ -0,0 +1,237 @@
+/**
+ * bench/ip-address.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "harness.h"
+
+#include <sfd/net/ipv6-address.h>
+#include <arpa/inet.h>
+#include <vector>
+
+using namespace sfd;
+using namespace sfd::net;
+using namespace sfd::bench;
+
+/**
+ * Formatting and parsing addresses, as done for every access-log line and every address in a
+ * configuration reload, against inet_ntop and inet_pton.
+ */
+
+static const unsigned int Addresses = 1024;
+
+static std::vector<IPAddress> make_v4_addresses()
+{
+	std::vector<IPAddress> addresses;
+	uint32_t x = 0x9e3779b9;
+
+	for (unsigned int i = 0; i < Addresses; i++) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		addresses.push_back(IPAddress(x));
+	}
+
+	return addresses;
+}
+
+static std::vector<IPv6Address> make_v6_addresses()
+{
+	std::vector<IPv6Address> addresses;
+	std::vector<IPAddress> v4 = make_v4_addresses();
+
+	for (unsigned int i = 0; i < Addresses; i++) {
+		uint32_t x = v4[i].address();
+
+		// A mix of compressible and incompressible addresses, as seen in practice.
+		if (i % 4 == 0) {
+			addresses.push_back(IPv6Address::from_v4(v4[i]));
+		} else if (i % 2 == 0) {
+			addresses.push_back(IPv6Address::from_groups(0x2001, 0xdb8, 0, 0, 0, 0, x >> 16, x & 0xffff));
+		} else {
+			addresses.push_back(IPv6Address::from_groups(0xfe80, x >> 16, x & 0xffff, i, x >> 8, 0xabcd, i * 7, x & 0xff));
+		}
+	}
+
+	return addresses;
+}
+
+static void ip_address_v4_format_to(State& state)
+{
+	std::vector<IPAddress> addresses = make_v4_addresses();
+	char buffer[IPAddress::MaxStringLength];
+	uint64_t total = 0;
+
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		total += addresses[i % Addresses].format_to(buffer);
+	}
+
+	if (total == 1) {
+		state.pause();
+	}
+}
+
+static void ip_address_v4_to_string(State& state)
+{
+	std::vector<IPAddress> addresses = make_v4_addresses();
+	uint64_t total = 0;
+
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		total += addresses[i % Addresses].to_string().size();
+	}
+
+	if (total == 1) {
+		state.pause();
+	}
+}
+
+static void ip_address_v4_inet_ntop(State& state)
+{
+	std::vector<IPAddress> addresses = make_v4_addresses();
+	char buffer[INET_ADDRSTRLEN];
+	uint64_t total = 0;
+
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		struct in_addr in;
+		in.s_addr = htonl(addresses[i % Addresses].address());
+
+		total += inet_ntop(AF_INET, &in, buffer, sizeof(buffer))[0];
+	}
+
+	if (total == 1) {
+		state.pause();
+	}
+}
+
+static void ip_address_v4_parse(State& state)
+{
+	std::vector<std::string> text;
+	for (const IPAddress& address : make_v4_addresses()) {
+		text.push_back(address.to_string());
+	}
+
+	IPAddress address = IPAddress::any();
+	uint64_t total = 0;
+
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		IPAddress::parse(text[i % Addresses], address);
+		total += address.address();
+	}
+
+	if (total == 1) {
+		state.pause();
+	}
+}
+
+static void ip_address_v4_inet_pton(State& state)
+{
+	std::vector<std::string> text;
+	for (const IPAddress& address : make_v4_addresses()) {
+		text.push_back(address.to_string());
+	}
+
+	struct in_addr in;
+	uint64_t total = 0;
+
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		inet_pton(AF_INET, text[i % Addresses].c_str(), &in);
+		total += in.s_addr;
+	}
+
+	if (total == 1) {
+		state.pause();
+	}
+}
+
+static void ip_address_v6_format_to(State& state)
+{
+	std::vector<IPv6Address> addresses = make_v6_addresses();
+	char buffer[IPv6Address::MaxStringLength];
+	uint64_t total = 0;
+
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		total += addresses[i % Addresses].format_to(buffer);
+	}
+
+	if (total == 1) {
+		state.pause();
+	}
+}
+
+static void ip_address_v6_inet_ntop(State& state)
+{
+	std::vector<IPv6Address> addresses = make_v6_addresses();
+	char buffer[INET6_ADDRSTRLEN];
+	uint64_t total = 0;
+
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		total += inet_ntop(AF_INET6, addresses[i % Addresses].address().data(), buffer, sizeof(buffer))[0];
+	}
+
+	if (total == 1) {
+		state.pause();
+	}
+}
+
+static void ip_address_v6_parse(State& state)
+{
+	std::vector<std::string> text;
+	for (const IPv6Address& address : make_v6_addresses()) {
+		text.push_back(address.to_string());
+	}
+
+	IPv6Address address = IPv6Address::any();
+	uint64_t total = 0;
+
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		IPv6Address::parse(text[i % Addresses], address);
+		total += address.address()[15];
+	}
+
+	if (total == 1) {
+		state.pause();
+	}
+}
+
+static void ip_address_v6_inet_pton(State& state)
+{
+	std::vector<std::string> text;
+	for (const IPv6Address& address : make_v6_addresses()) {
+		text.push_back(address.to_string());
+	}
+
+	uint8_t address[16];
+	uint64_t total = 0;
+
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		inet_pton(AF_INET6, text[i % Addresses].c_str(), address);
+		total += address[15];
+	}
+
+	if (total == 1) {
+		state.pause();
+	}
+}
+
+SFD_BENCHMARK("ip_address.v4_format_to", ip_address_v4_format_to);
+SFD_BENCHMARK("ip_address.v4_to_string", ip_address_v4_to_string);
+SFD_BENCHMARK("ip_address.v4_inet_ntop", ip_address_v4_inet_ntop);
+SFD_BENCHMARK("ip_address.v4_parse", ip_address_v4_parse);
+SFD_BENCHMARK("ip_address.v4_inet_pton", ip_address_v4_inet_pton);
+SFD_BENCHMARK("ip_address.v6_format_to", ip_address_v6_format_to);
+SFD_BENCHMARK("ip_address.v6_inet_ntop", ip_address_v6_inet_ntop);
+SFD_BENCHMARK("ip_address.v6_parse", ip_address_v6_parse);
+SFD_BENCHMARK("ip_address.v6_inet_pton", ip_address_v6_inet_pton);
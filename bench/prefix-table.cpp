@@ -0,0 +1,192 @@
+/**
+ * bench/prefix-table.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "harness.h"
+
+#include <sfd/net/prefix-table.h>
+#include <vector>
+
+using namespace sfd;
+using namespace sfd::net;
+using namespace sfd::bench;
+
+/**
+ * Longest-prefix-match lookups against 100k-prefix tables, as made for every accepted
+ * connection and every datagram, and the cost of bulk loading such a table.
+ */
+
+static const unsigned int Prefixes = 100000;
+static const unsigned int Addresses = 65536;
+
+static uint64_t next_random(uint64_t& x)
+{
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	return x;
+}
+
+/**
+ * A mix of prefix lengths resembling a routing table, dominated by /24s.
+ */
+static std::vector<std::pair<IPPrefix, IPPrefixTable::Value>> make_v4_prefixes()
+{
+	static const unsigned int lengths[] = { 8, 12, 16, 19, 20, 22, 23, 24, 24, 24, 24, 24, 28, 32 };
+	std::vector<std::pair<IPPrefix, IPPrefixTable::Value>> prefixes;
+	uint64_t x = 0x9e3779b97f4a7c15ull;
+
+	for (unsigned int i = 0; i < Prefixes; i++) {
+		uint64_t r = next_random(x);
+		prefixes.push_back(std::make_pair(IPPrefix(IPAddress(r), lengths[(r >> 32) % 14]), i));
+	}
+
+	return prefixes;
+}
+
+static std::vector<std::pair<IPv6Prefix, IPv6PrefixTable::Value>> make_v6_prefixes()
+{
+	static const unsigned int lengths[] = { 29, 32, 40, 44, 48, 48, 48, 56, 64 };
+	std::vector<std::pair<IPv6Prefix, IPv6PrefixTable::Value>> prefixes;
+	uint64_t x = 0x9e3779b97f4a7c15ull;
+
+	for (unsigned int i = 0; i < Prefixes; i++) {
+		uint64_t r = next_random(x);
+		uint16_t high = 0x2000 | ((r >> 48) & 0xfff);
+
+		prefixes.push_back(std::make_pair(IPv6Prefix(IPv6Address::from_groups(high, r >> 32, r >> 16, r, 0, 0, 0, 1), lengths[(r >> 8) % 9]), i));
+	}
+
+	return prefixes;
+}
+
+/**
+ * Addresses within the loaded prefixes, so that lookups reach the deeper levels.
+ */
+template<typename Address, typename Prefixes>
+static std::vector<Address> make_addresses(const Prefixes& prefixes)
+{
+	std::vector<Address> addresses;
+
+	for (unsigned int i = 0; i < Addresses; i++) {
+		addresses.push_back(prefixes[(i * 40503) % prefixes.size()].first.address());
+	}
+
+	return addresses;
+}
+
+static void prefix_table_v4_load(State& state)
+{
+	std::vector<std::pair<IPPrefix, IPPrefixTable::Value>> prefixes = make_v4_prefixes();
+	IPPrefixTable table;
+
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		table.load(prefixes);
+	}
+
+	state.items(state.iterations() * Prefixes);
+}
+
+static void prefix_table_v4_lookup(State& state)
+{
+	state.pause();
+
+	std::vector<std::pair<IPPrefix, IPPrefixTable::Value>> prefixes = make_v4_prefixes();
+	std::vector<IPAddress> addresses = make_addresses<IPAddress>(prefixes);
+	IPPrefixTable table;
+	table.load(prefixes);
+	IPPrefixTable::Reader reader = table.reader();
+
+	state.resume();
+
+	uint64_t total = 0;
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		total += reader.lookup(addresses[i % Addresses]);
+	}
+
+	if (total == 1) {
+		state.pause();
+	}
+}
+
+static void prefix_table_v4_lookup_batch(State& state)
+{
+	state.pause();
+
+	std::vector<std::pair<IPPrefix, IPPrefixTable::Value>> prefixes = make_v4_prefixes();
+	std::vector<IPAddress> addresses = make_addresses<IPAddress>(prefixes);
+	std::vector<IPPrefixTable::Value> values(64);
+	IPPrefixTable table;
+	table.load(prefixes);
+	IPPrefixTable::Reader reader = table.reader();
+
+	state.resume();
+
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		reader.lookup(&addresses[(i * 64) % Addresses], values.data(), 64);
+	}
+
+	state.items(state.iterations() * 64);
+}
+
+static void prefix_table_v6_lookup(State& state)
+{
+	state.pause();
+
+	std::vector<std::pair<IPv6Prefix, IPv6PrefixTable::Value>> prefixes = make_v6_prefixes();
+	std::vector<IPv6Address> addresses = make_addresses<IPv6Address>(prefixes);
+	IPv6PrefixTable table;
+	table.load(prefixes);
+	IPv6PrefixTable::Reader reader = table.reader();
+
+	state.resume();
+
+	uint64_t total = 0;
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		total += reader.lookup(addresses[i % Addresses]);
+	}
+
+	if (total == 1) {
+		state.pause();
+	}
+}
+
+static void prefix_table_v6_lookup_batch(State& state)
+{
+	state.pause();
+
+	std::vector<std::pair<IPv6Prefix, IPv6PrefixTable::Value>> prefixes = make_v6_prefixes();
+	std::vector<IPv6Address> addresses = make_addresses<IPv6Address>(prefixes);
+	std::vector<IPv6PrefixTable::Value> values(64);
+	IPv6PrefixTable table;
+	table.load(prefixes);
+	IPv6PrefixTable::Reader reader = table.reader();
+
+	state.resume();
+
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		reader.lookup(&addresses[(i * 64) % Addresses], values.data(), 64);
+	}
+
+	state.items(state.iterations() * 64);
+}
+
+SFD_BENCHMARK("prefix_table.v4_load", prefix_table_v4_load);
+SFD_BENCHMARK("prefix_table.v4_lookup", prefix_table_v4_lookup);
+SFD_BENCHMARK("prefix_table.v4_lookup_batch", prefix_table_v4_lookup_batch);
+SFD_BENCHMARK("prefix_table.v6_lookup", prefix_table_v6_lookup);
+SFD_BENCHMARK("prefix_table.v6_lookup_batch", prefix_table_v6_lookup_batch);
@@ -0,0 +1,114 @@
+/**
+ * bench/socket.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "harness.h"
+
+#include <sfd/net/socket.h>
+#include <sfd/net/ip-endpoint.h>
+#include <sys/socket.h>
+
+using namespace sfd;
+using namespace sfd::net;
+using namespace sfd::bench;
+
+/**
+ * Connection and datagram rates over loopback.
+ */
+
+static void socket_accept(State& state)
+{
+	state.pause();
+
+	// The listener is kept for the whole suite, so that repeated runs do not have to rebind
+	// the port.
+	static IPSocket *listener = nullptr;
+	static IPEndPoint ep(IPAddress::localhost(), 47601);
+
+	if (!listener) {
+		listener = new IPSocket(SocketType::Stream, ProtocolType::TCP);
+		listener->bind(ep);
+		listener->listen(128);
+	}
+
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		IPSocket client(SocketType::Stream, ProtocolType::TCP);
+		client.connect(ep);
+
+		state.resume();
+		Socket *accepted = listener->accept();
+		state.pause();
+
+		// Reset the connection rather than closing it gracefully, so that thousands of
+		// connections in TIME_WAIT do not exhaust the ephemeral ports.
+		struct linger linger = { 1, 0 };
+		::setsockopt(client.fd(), SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+
+		delete accepted;
+	}
+}
+
+static void socket_send_to(State& state)
+{
+	state.pause();
+
+	IPEndPoint ep(IPAddress::localhost(), 47602);
+	IPSocket receiver(SocketType::Datagram, ProtocolType::UDP);
+	receiver.bind(ep);
+
+	IPSocket sender(SocketType::Datagram, ProtocolType::UDP);
+	char message[64] = { 0 };
+
+	state.resume();
+
+	// Datagrams that overflow the receiver are dropped, which does not affect the sender.
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		sender.send_to(message, sizeof(message), ep);
+	}
+}
+
+static void socket_recv_from(State& state)
+{
+	static const unsigned int Batch = 64;
+
+	state.pause();
+
+	IPEndPoint ep(IPAddress::localhost(), 47603);
+	IPSocket receiver(SocketType::Datagram, ProtocolType::UDP);
+	receiver.bind(ep);
+
+	IPSocket sender(SocketType::Datagram, ProtocolType::UDP);
+	char message[64] = { 0 };
+
+	for (uint64_t i = 0; i < state.iterations(); i++) {
+		if (i % Batch == 0) {
+			state.pause();
+
+			for (unsigned int j = 0; j < Batch; j++) {
+				sender.send_to(message, sizeof(message), ep);
+			}
+
+			state.resume();
+		}
+
+		receiver.recv_from(message, sizeof(message), nullptr);
+	}
+}
+
+SFD_BENCHMARK("socket.accept", socket_accept);
+SFD_BENCHMARK("socket.send_to", socket_send_to);
+SFD_BENCHMARK("socket.recv_from", socket_recv_from);
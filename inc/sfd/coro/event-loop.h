@@ -0,0 +1,282 @@
+/**
+ * inc/sfd/coro/event-loop.h
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <sfd/fd.h>
+#include <sfd/epoll.h>
+#include <sfd/timer.h>
+#include <sfd/exception.h>
+#include <sfd/coro/task.h>
+#include <sfd/net/socket.h>
+#include <sfd/net/busy-poller.h>
+#include <sfd/net/endpoint.h>
+#include <coroutine>
+#include <cstdint>
+#include <vector>
+#include <errno.h>
+#include <sys/types.h>
+
+namespace sfd {
+	namespace coro {
+		class EventLoop;
+
+		/**
+		 * The state shared by the I/O awaitables.  While a coroutine is suspended on a file
+		 * descriptor, the event loop calls attempt whenever the descriptor becomes ready, and
+		 * resumes the coroutine once attempt reports that the operation has completed.
+		 */
+		struct IoWait {
+			EventLoop *loop;
+			FileDescriptor *fd;
+			std::coroutine_handle<> handle;
+			bool (*attempt)(IoWait *wait);
+		};
+
+		/**
+		 * Awaits the completion of a read.  The result is that of FileDescriptor::read, with
+		 * errno set on error.
+		 */
+		class ReadAwaitable : private IoWait {
+		public:
+			ReadAwaitable(EventLoop& loop, FileDescriptor& fd, void *buffer, size_t size);
+
+			bool await_ready() { return attempt(this); }
+			void await_suspend(std::coroutine_handle<> handle);
+			int await_resume() const { errno = _error; return _result; }
+
+		private:
+			static bool try_read(IoWait *wait);
+
+			void *_buffer;
+			size_t _size;
+			int _result;
+			int _error;
+		};
+
+		/**
+		 * Awaits the completion of a write.  The result is that of FileDescriptor::write, with
+		 * errno set on error.  As with write, fewer bytes than requested may be written.
+		 */
+		class WriteAwaitable : private IoWait {
+		public:
+			WriteAwaitable(EventLoop& loop, FileDescriptor& fd, const void *buffer, size_t size);
+
+			bool await_ready() { return attempt(this); }
+			void await_suspend(std::coroutine_handle<> handle);
+			int await_resume() const { errno = _error; return _result; }
+
+		private:
+			static bool try_write(IoWait *wait);
+
+			const void *_buffer;
+			size_t _size;
+			int _result;
+			int _error;
+		};
+
+		/**
+		 * Awaits an incoming connection.  The result is the accepted socket, or NULL on error
+		 * (with errno set).
+		 */
+		class AcceptAwaitable : private IoWait {
+		public:
+			AcceptAwaitable(EventLoop& loop, net::Socket& listener);
+
+			bool await_ready() { return attempt(this); }
+			void await_suspend(std::coroutine_handle<> handle);
+			net::Socket *await_resume() const { errno = _error; return _result; }
+
+		private:
+			static bool try_accept(IoWait *wait);
+
+			net::Socket *_result;
+			int _error;
+		};
+
+		/**
+		 * Awaits the establishment of an outgoing connection.  The result is zero on success,
+		 * or an errno value describing why the connection failed.
+		 */
+		class ConnectAwaitable : private IoWait {
+		public:
+			ConnectAwaitable(EventLoop& loop, net::Socket& socket, const net::EndPoint& ep);
+
+			bool await_ready() { return attempt(this); }
+			void await_suspend(std::coroutine_handle<> handle);
+			int await_resume() const { return _error; }
+
+		private:
+			static bool try_connect(IoWait *wait);
+
+			const net::EndPoint& _ep;
+			bool _started;
+			int _error;
+		};
+
+		/**
+		 * Awaits a datagram.  The result is the number of bytes received, or -1 on error (with
+		 * errno set).  If requested, the sender's endpoint is returned as a new object owned by
+		 * the caller.
+		 */
+		class RecvFromAwaitable : private IoWait {
+		public:
+			RecvFromAwaitable(EventLoop& loop, net::Socket& socket, void *buffer, size_t size, const net::EndPoint **from);
+
+			bool await_ready() { return attempt(this); }
+			void await_suspend(std::coroutine_handle<> handle);
+			ssize_t await_resume() const { errno = _error; return _result; }
+
+		private:
+			static bool try_recv_from(IoWait *wait);
+
+			void *_buffer;
+			size_t _size;
+			const net::EndPoint **_from;
+			ssize_t _result;
+			int _error;
+		};
+
+		/**
+		 * Awaits the passing of a period of time.  Sleeping for zero nanoseconds yields to the
+		 * other runnable coroutines.
+		 */
+		class SleepAwaitable {
+		public:
+			SleepAwaitable(EventLoop& loop, uint64_t duration_ns) : _loop(loop), _duration_ns(duration_ns) {
+			}
+
+			bool await_ready() const { return false; }
+			void await_suspend(std::coroutine_handle<> handle);
+			void await_resume() const {
+			}
+
+		private:
+			EventLoop& _loop;
+			uint64_t _duration_ns;
+		};
+
+		/**
+		 * Runs coroutines on a single thread, resuming them as the file descriptors and timers
+		 * they await become ready.  Each awaited file descriptor is registered with the loop's
+		 * epoll instance one-shot, only while a coroutine is waiting on it, and is placed into
+		 * non-blocking mode the first time it is awaited.  Call forget() before destroying a
+		 * file descriptor that has been awaited on.
+		 *
+		 * Only one coroutine may wait to read, and one to write, on a file descriptor at a time.
+		 */
+		class EventLoop {
+			friend class ReadAwaitable;
+			friend class WriteAwaitable;
+			friend class AcceptAwaitable;
+			friend class ConnectAwaitable;
+			friend class RecvFromAwaitable;
+			friend class SleepAwaitable;
+			friend class detail::PromiseBase;
+
+		public:
+			EventLoop();
+			~EventLoop();
+
+			void spawn(Task<void>&& task);
+			void run();
+			void stop();
+
+			void forget(FileDescriptor& fd);
+
+			void busy_poll(uint64_t budget_ns, unsigned int socket_busy_poll_us = 50);
+			const net::BusyPollStatistics& busy_poll_statistics() const { return _poller.statistics(); }
+
+			ReadAwaitable read(FileDescriptor& fd, void *buffer, size_t size) {
+				return ReadAwaitable(*this, fd, buffer, size);
+			}
+
+			WriteAwaitable write(FileDescriptor& fd, const void *buffer, size_t size) {
+				return WriteAwaitable(*this, fd, buffer, size);
+			}
+
+			AcceptAwaitable accept(net::Socket& listener) {
+				return AcceptAwaitable(*this, listener);
+			}
+
+			ConnectAwaitable connect(net::Socket& socket, const net::EndPoint& ep) {
+				return ConnectAwaitable(*this, socket, ep);
+			}
+
+			RecvFromAwaitable recv_from(net::Socket& socket, void *buffer, size_t size, const net::EndPoint **from = nullptr) {
+				return RecvFromAwaitable(*this, socket, buffer, size, from);
+			}
+
+			SleepAwaitable sleep(uint64_t duration_ns) {
+				return SleepAwaitable(*this, duration_ns);
+			}
+
+		private:
+			struct FileState {
+				FileDescriptor *owner;
+				IoWait *reader;
+				IoWait *writer;
+				bool registered;
+			};
+
+			struct Sleeper {
+				uint64_t deadline;
+				uint64_t sequence;
+				std::coroutine_handle<> handle;
+
+				bool operator>(const Sleeper& other) const {
+					return deadline > other.deadline || (deadline == other.deadline && sequence > other.sequence);
+				}
+			};
+
+			FileState& prepare(FileDescriptor& fd);
+			void wait_readable(IoWait& wait);
+			void wait_writable(IoWait& wait);
+			void arm(FileState& state);
+
+			void sleep_until(uint64_t deadline, std::coroutine_handle<> handle);
+			void expire_sleepers();
+
+			void schedule(std::coroutine_handle<> handle) { _ready.push_back(handle); }
+			void run_ready();
+			void task_finished();
+
+			Epoll _epoll;
+			net::BusyPoller _poller;
+			unsigned int _socket_busy_poll_us;
+			Timer _timer;
+
+			std::vector<FileState> _files;
+			std::vector<std::coroutine_handle<>> _ready;
+			std::vector<std::coroutine_handle<>> _running;
+			std::vector<Sleeper> _sleepers;
+			uint64_t _sleeper_sequence;
+			uint64_t _timer_deadline;
+
+			unsigned int _active;
+			bool _stopping;
+		};
+
+		class EventLoopException : public Exception {
+		public:
+
+			EventLoopException(const std::string& msg) : Exception(msg) {
+			}
+		};
+	}
+}
@@ -0,0 +1,42 @@
+/**
+ * inc/sfd/coro/frame-pool.h
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <cstddef>
+
+namespace sfd {
+	namespace coro {
+
+		/**
+		 * A per-thread cache of coroutine frames, in size classes of FrameGranularity bytes.
+		 * Frames are returned to the cache of the thread that destroys them, and each size
+		 * class keeps at most MaxCachedFrames.  Frames larger than MaxPooledSize come straight
+		 * from the global allocator.
+		 */
+		class FramePool {
+		public:
+			static const size_t FrameGranularity = 64;
+			static const size_t MaxPooledSize = 4096;
+			static const size_t MaxCachedFrames = 1024;
+
+			static void *allocate(size_t size);
+			static void release(void *frame, size_t size);
+		};
+	}
+}
@@ -0,0 +1,194 @@
+/**
+ * inc/sfd/coro/task.h
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <sfd/coro/frame-pool.h>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+namespace sfd {
+	namespace coro {
+		class EventLoop;
+
+		template<typename T>
+		class Task;
+
+		namespace detail {
+
+			/**
+			 * The parts of a task's promise that do not depend on its result type.  Frames are
+			 * allocated from the FramePool, and a finished task resumes whichever coroutine is
+			 * awaiting it (symmetric transfer), or, for a task spawned onto an event loop,
+			 * destroys itself.
+			 */
+			class PromiseBase {
+			public:
+				struct FinalAwaiter {
+					bool await_ready() const noexcept { return false; }
+
+					template<typename Promise>
+					std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+						PromiseBase& promise = handle.promise();
+
+						if (promise._continuation) {
+							return promise._continuation;
+						}
+
+						if (promise._loop) {
+							promise.detached_finished();
+							handle.destroy();
+						}
+
+						return std::noop_coroutine();
+					}
+
+					void await_resume() noexcept {
+					}
+				};
+
+				static void *operator new(size_t size) {
+					return FramePool::allocate(size);
+				}
+
+				static void operator delete(void *frame, size_t size) {
+					FramePool::release(frame, size);
+				}
+
+				std::suspend_always initial_suspend() noexcept { return {}; }
+				FinalAwaiter final_suspend() noexcept { return {}; }
+
+				void unhandled_exception() noexcept {
+					_exception = std::current_exception();
+				}
+
+				void continuation(std::coroutine_handle<> continuation) { _continuation = continuation; }
+				void detach(EventLoop *loop) { _loop = loop; }
+
+			protected:
+				void rethrow() {
+					if (_exception) {
+						std::rethrow_exception(_exception);
+					}
+				}
+
+			private:
+				void detached_finished() noexcept;
+
+				std::coroutine_handle<> _continuation;
+				EventLoop *_loop = nullptr;
+				std::exception_ptr _exception;
+			};
+
+			template<typename T>
+			class Promise : public PromiseBase {
+			public:
+				Task<T> get_return_object() noexcept;
+
+				void return_value(T value) {
+					_value = std::move(value);
+				}
+
+				T result() {
+					rethrow();
+					return std::move(*_value);
+				}
+
+			private:
+				std::optional<T> _value;
+			};
+
+			template<>
+			class Promise<void> : public PromiseBase {
+			public:
+				Task<void> get_return_object() noexcept;
+
+				void return_void() noexcept {
+				}
+
+				void result() {
+					rethrow();
+				}
+			};
+		}
+
+		/**
+		 * A lazily-started coroutine, producing a value of type T.  A task runs when it is
+		 * awaited by another coroutine, or when it is spawned onto an EventLoop.  Exceptions
+		 * propagate to the awaiting coroutine.
+		 */
+		template<typename T = void>
+		class Task {
+		public:
+			typedef detail::Promise<T> promise_type;
+			typedef std::coroutine_handle<promise_type> Handle;
+
+			explicit Task(Handle handle) : _handle(handle) {
+			}
+
+			Task(Task&& other) noexcept : _handle(std::exchange(other._handle, nullptr)) {
+			}
+
+			Task(const Task&) = delete;
+			Task& operator=(const Task&) = delete;
+
+			~Task() {
+				if (_handle) {
+					_handle.destroy();
+				}
+			}
+
+			bool await_ready() const noexcept {
+				return false;
+			}
+
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+				_handle.promise().continuation(awaiting);
+				return _handle;
+			}
+
+			T await_resume() {
+				return _handle.promise().result();
+			}
+
+			/**
+			 * Gives up ownership of the coroutine, e.g. so that an event loop can run it detached.
+			 */
+			Handle release() {
+				return std::exchange(_handle, nullptr);
+			}
+
+		private:
+			Handle _handle;
+		};
+
+		namespace detail {
+
+			template<typename T>
+			inline Task<T> Promise<T>::get_return_object() noexcept {
+				return Task<T>(Task<T>::Handle::from_promise(*this));
+			}
+
+			inline Task<void> Promise<void>::get_return_object() noexcept {
+				return Task<void>(Task<void>::Handle::from_promise(*this));
+			}
+		}
+	}
+}
@@ -42,7 +42,7 @@ namespace sfd {
 			ET = 1u << 31
 		};
 
-		static inline EpollEventType operator|(EpollEventType& l, EpollEventType& r) {
+		static inline EpollEventType operator|(const EpollEventType& l, const EpollEventType& r) {
 			return (EpollEventType) ((unsigned long) l | (unsigned long) r);
 		}
 	}
@@ -66,6 +66,10 @@ namespace sfd {
 		inline bool hup() const {
 			return event_type & EpollEventType::HUP;
 		}
+
+		inline bool rdhup() const {
+			return event_type & EpollEventType::RDHUP;
+		}
 	};
 
 	/**
@@ -76,6 +80,7 @@ namespace sfd {
 		Epoll();
 		
 		void add(FileDescriptor *fd, EpollEventType::EpollEventType event_types);
+		void modify(FileDescriptor *fd, EpollEventType::EpollEventType event_types);
 		void remove(FileDescriptor *fd);
 		bool wait(std::vector<EpollEvent>& events, int max_events = 24, int timeout = -1);
 	};
@@ -20,6 +20,7 @@
 
 #include <sfd/fd.h>
 #include <sfd/exception.h>
+#include <cstdint>
 
 namespace sfd {
 
@@ -30,7 +31,13 @@ namespace sfd {
 	public:
 		Event();
 
+		static Event *adopt(FileDescriptor::NativeFD fd);
+
 		void invoke();
+		uint64_t acknowledge();
+
+	private:
+		Event(FileDescriptor::NativeFD fd);
 	};
 
 	class EventException : public Exception {
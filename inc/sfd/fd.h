@@ -18,7 +18,9 @@
  */
 #pragma once
 
+#include <sfd/exception.h>
 #include <cstddef>
+#include <unistd.h>
 
 namespace sfd {
 
@@ -39,13 +41,54 @@ namespace sfd {
 
 		int read(void *buffer, size_t size);
 		int write(const void *buffer, size_t size);
+
+		/**
+		 * Performs a read operation on the file descriptor, inlined into the caller as a plain
+		 * system call.  Code compiled with SFD_METRICS or SFD_TRACE calls read() instead, so
+		 * these are only uninstrumented if the caller is, whatever the library was built with.
+		 * @param buffer The buffer to read into.
+		 * @param size The maximum size of the buffer.
+		 * @return The number of bytes read into the buffer.
+		 */
+		inline int read_inline(void *buffer, size_t size) {
+#if defined(SFD_METRICS) || defined(SFD_TRACE)
+			return read(buffer, size);
+#else
+			return ::read(_fd, buffer, size);
+#endif
+		}
+
+		/**
+		 * Performs a write operation on the file descriptor, inlined into the caller.  See
+		 * read_inline().
+		 * @param buffer The buffer to read from.
+		 * @param size The number of bytes in the buffer to write.
+		 * @return The number of bytes written.
+		 */
+		inline int write_inline(const void *buffer, size_t size) {
+#if defined(SFD_METRICS) || defined(SFD_TRACE)
+			return write(buffer, size);
+#else
+			return ::write(_fd, buffer, size);
+#endif
+		}
 		
 		inline bool valid() const { return _fd >= 0; }
 
+		bool non_blocking() const;
+		void non_blocking(bool enable);
+
 	protected:
 		FileDescriptor(NativeFD fd);
 
 	private:
 		NativeFD _fd;
 	};
+
+	class FileDescriptorException : public Exception {
+	public:
+
+		FileDescriptorException(const std::string& msg) : Exception(msg) {
+		}
+	};
 }
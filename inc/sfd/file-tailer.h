@@ -0,0 +1,118 @@
+/**
+ * inc/sfd/file-tailer.h
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <sfd/inotify.h>
+#include <sfd/epoll.h>
+#include <sfd/regular-file.h>
+#include <sfd/exception.h>
+#include <sys/types.h>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace sfd {
+
+	/**
+	 * A batch of bytes appended to a tailed file.
+	 */
+	struct TailBatch {
+		unsigned int file;
+		uint64_t offset;
+		std::vector<char> data;
+	};
+
+	/**
+	 * Follows a set of files as they are appended to, in the manner of "tail -F".  Changes are
+	 * discovered through inotify rather than by polling, and only the appended bytes are read,
+	 * with pread from the last offset seen.  A file that is truncated is re-read from the start,
+	 * and a file that is rotated (renamed or deleted, and re-created at the same path) is read to
+	 * the end before the tailer switches to the new file.
+	 */
+	class FileTailer {
+	public:
+		typedef unsigned int FileID;
+
+		FileTailer(size_t max_batch_size = 256 * 1024);
+		~FileTailer();
+
+		FileTailer(const FileTailer&) = delete;
+		FileTailer& operator=(const FileTailer&) = delete;
+
+		FileID add(const std::string& path, bool from_start = false);
+		void remove(FileID file);
+
+		Inotify& inotify() { return _inotify; }
+
+		bool handle(const EpollEvent& event);
+		void process_events();
+
+		size_t collect(std::vector<TailBatch>& batches, size_t max_bytes = SIZE_MAX);
+
+		const std::string& path(FileID file) const { return _files.at(file)->path; }
+		uint64_t offset(FileID file) const { return _files.at(file)->offset; }
+
+	private:
+		struct TailedFile {
+			std::string path;
+			std::string directory;
+			std::string name;
+
+			RegularFile *file;
+			int watch;
+			dev_t device;
+			ino_t inode;
+
+			uint64_t offset;
+			bool dirty;
+			bool check_rotation;
+		};
+
+		struct DirectoryWatch {
+			int watch;
+			unsigned int references;
+		};
+
+		bool open(TailedFile& file, FileID id);
+		void close(TailedFile& file, FileID id);
+		bool reopen_if_rotated(TailedFile& file, FileID id);
+		size_t read_appended(FileID id, TailedFile& file, std::vector<TailBatch>& batches, size_t max_bytes);
+
+		void watch_directory(const std::string& directory);
+		void unwatch_directory(const std::string& directory);
+
+		Inotify _inotify;
+		size_t _max_batch_size;
+
+		std::vector<TailedFile *> _files;
+		std::unordered_map<int, std::vector<FileID>> _file_watches;
+		std::map<std::string, DirectoryWatch> _directories;
+		std::unordered_map<int, std::string> _directory_watches;
+		std::vector<InotifyEvent> _events;
+	};
+
+	class FileTailerException : public Exception {
+	public:
+
+		FileTailerException(const std::string& msg) : Exception(msg) {
+		}
+	};
+}
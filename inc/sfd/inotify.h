@@ -0,0 +1,87 @@
+/**
+ * inc/sfd/inotify.h
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <sfd/fd.h>
+#include <sfd/exception.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sfd {
+	namespace InotifyEventType {
+
+		enum InotifyEventType {
+			ACCESS = 0x00000001,
+			MODIFY = 0x00000002,
+			ATTRIB = 0x00000004,
+			CLOSE_WRITE = 0x00000008,
+			CLOSE_NOWRITE = 0x00000010,
+			OPEN = 0x00000020,
+			MOVED_FROM = 0x00000040,
+			MOVED_TO = 0x00000080,
+			CREATE = 0x00000100,
+			DELETE = 0x00000200,
+			DELETE_SELF = 0x00000400,
+			MOVE_SELF = 0x00000800,
+			UNMOUNT = 0x00002000,
+			Q_OVERFLOW = 0x00004000,
+			IGNORED = 0x00008000,
+			ONLYDIR = 0x01000000,
+			DONT_FOLLOW = 0x02000000,
+			ISDIR = 0x40000000
+		};
+
+		static inline InotifyEventType operator|(const InotifyEventType& l, const InotifyEventType& r) {
+			return (InotifyEventType) ((unsigned long) l | (unsigned long) r);
+		}
+	}
+
+	struct InotifyEvent {
+		int watch;
+		InotifyEventType::InotifyEventType event_type;
+		uint32_t cookie;
+		std::string name;
+
+		inline bool is(InotifyEventType::InotifyEventType type) const {
+			return event_type & type;
+		}
+	};
+
+	/**
+	 * Represents a managed inotify object.  The object is non-blocking, and becomes readable
+	 * (e.g. through Epoll) when there are events waiting.
+	 */
+	class Inotify : public FileDescriptor {
+	public:
+		Inotify();
+
+		int add_watch(const std::string& path, InotifyEventType::InotifyEventType events);
+		void remove_watch(int watch);
+
+		bool read_events(std::vector<InotifyEvent>& events);
+	};
+
+	class InotifyException : public Exception {
+	public:
+
+		InotifyException(const std::string& msg) : Exception(msg) {
+		}
+	};
+}
@@ -0,0 +1,90 @@
+/**
+ * inc/sfd/ipc/shm-channel.h
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <sfd/event.h>
+#include <sfd/shared-memory.h>
+#include <sfd/net/socket.h>
+#include <sfd/exception.h>
+#include <atomic>
+#include <cstdint>
+
+namespace sfd {
+	namespace ipc {
+
+		/**
+		 * A one-way message channel between co-located processes (or threads), built on a ring of
+		 * fixed-size slots in shared memory.  Any number of producers may send, and a single
+		 * consumer receives.  Sending and receiving are lock-free and involve no system calls,
+		 * except that a producer invokes the channel's eventfd when it finds the consumer asleep.
+		 *
+		 * One side creates the channel and passes it to the other over a Unix socket with
+		 * send_setup; the other side attaches with receive_setup.
+		 */
+		class ShmChannel {
+		public:
+			static ShmChannel *create(size_t slot_count, size_t slot_size);
+			static ShmChannel *receive_setup(net::UnixSocket& socket);
+
+			~ShmChannel();
+
+			ShmChannel(const ShmChannel&) = delete;
+			ShmChannel& operator=(const ShmChannel&) = delete;
+
+			void send_setup(net::UnixSocket& socket);
+
+			bool send(const void *message, size_t length);
+			bool try_receive(void *buffer, size_t& length);
+			size_t receive(void *buffer, size_t length);
+
+			bool prepare_to_sleep();
+			void woken();
+
+			Event& notifier() { return *_notifier; }
+
+			size_t slot_count() const { return _slot_count; }
+			size_t max_message_size() const { return _slot_size; }
+
+		private:
+			struct Header;
+			struct Slot;
+
+			ShmChannel(SharedMemory *memory, Event *notifier, size_t slot_count, size_t slot_size, size_t slot_stride);
+
+			Slot *slot(uint64_t position) const;
+			bool empty() const;
+
+			SharedMemory *_memory;
+			Event *_notifier;
+			Header *_header;
+			char *_slots;
+
+			size_t _slot_count;
+			size_t _slot_size;
+			size_t _slot_stride;
+		};
+
+		class ShmChannelException : public Exception {
+		public:
+
+			ShmChannelException(const std::string& msg) : Exception(msg) {
+			}
+		};
+	}
+}
@@ -0,0 +1,90 @@
+/**
+ * inc/sfd/loop-lag-monitor.h
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <sfd/epoll.h>
+#include <sfd/timer.h>
+#include <sfd/metrics.h>
+#include <cstdint>
+
+namespace sfd {
+
+	/**
+	 * Measures how far behind an event loop is running.  A periodic timer is registered with
+	 * the loop, and the delay between each expiry and the loop getting round to handling it
+	 * (the wake-to-dispatch lag) is recorded.  The loop can also report the length of each of
+	 * its iterations, with IterationScope.  Both are kept as histograms and as moving averages,
+	 * which respond within a few samples to the loop becoming overloaded.
+	 */
+	class LoopLagMonitor {
+	public:
+		LoopLagMonitor(uint64_t interval_ns = 10000000ull);
+
+		void attach(Epoll& epoll);
+		void detach(Epoll& epoll);
+
+		bool handle(const EpollEvent& event);
+
+		void begin_iteration() { _iteration_start = metrics::now(); }
+		void end_iteration();
+
+		uint64_t interval() const { return _interval_ns; }
+
+		/**
+		 * The moving averages of the wake-to-dispatch lag and of the iteration time, in
+		 * nanoseconds.
+		 */
+		uint64_t lag() const { return _lag_average; }
+		uint64_t iteration_time() const { return _iteration_average; }
+
+		const metrics::LatencyHistogram& lag_histogram() const { return _lag; }
+		const metrics::LatencyHistogram& iteration_histogram() const { return _iterations; }
+
+		void reset();
+
+		/**
+		 * Reports the time spent in one iteration of the loop to a monitor, for the lifetime
+		 * of the scope.
+		 */
+		class IterationScope {
+		public:
+			IterationScope(LoopLagMonitor& monitor) : _monitor(monitor) { _monitor.begin_iteration(); }
+			~IterationScope() { _monitor.end_iteration(); }
+
+		private:
+			LoopLagMonitor& _monitor;
+		};
+
+	private:
+		static uint64_t smooth(uint64_t average, uint64_t sample) {
+			// An exponentially weighted moving average, with a weight of 1/8 for each sample.
+			return average - (average >> 3) + (sample >> 3);
+		}
+
+		Timer _timer;
+		uint64_t _interval_ns;
+		uint64_t _next_expiry;
+		uint64_t _iteration_start;
+
+		metrics::LatencyHistogram _lag;
+		metrics::LatencyHistogram _iterations;
+		uint64_t _lag_average;
+		uint64_t _iteration_average;
+	};
+}
@@ -0,0 +1,216 @@
+/**
+ * inc/sfd/metrics.h
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <sfd/trace.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace sfd {
+	namespace metrics {
+		namespace Counter {
+
+			enum Counter {
+				EPOLL_WAITS,
+				EPOLL_EVENTS,
+				EPOLL_IDLE_NS,
+				EPOLL_BUSY_NS,
+				SOCKET_BYTES_IN,
+				SOCKET_BYTES_OUT,
+				ACCEPTS,
+				COUNT
+			};
+		}
+
+		/**
+		 * The kinds of wrapper that system calls are attributed to.  Calls made through the
+		 * FileDescriptor base class (read and write) are attributed to GENERIC.
+		 */
+		namespace FileDescriptorKind {
+
+			enum FileDescriptorKind {
+				GENERIC,
+				EPOLL,
+				EVENT,
+				SIGNAL,
+				REGULAR_FILE,
+				SOCKET,
+				PIPE,
+				INOTIFY,
+				TIMER,
+				COUNT
+			};
+		}
+
+		/**
+		 * A histogram of latencies (or any other non-negative quantity), with logarithmic buckets
+		 * in the manner of an HDR histogram: each power of two is split into eight linear
+		 * sub-buckets, so recorded values are accurate to within 12.5%.  Recording is a handful
+		 * of instructions, and safe to read (but not to record) concurrently.
+		 */
+		class LatencyHistogram {
+		public:
+			static const unsigned int SubBucketBits = 3;
+			static const unsigned int SubBuckets = 1u << SubBucketBits;
+			static const unsigned int BucketCount = (64 - SubBucketBits + 1) * SubBuckets;
+
+			LatencyHistogram();
+			LatencyHistogram(const LatencyHistogram& other);
+			LatencyHistogram& operator=(const LatencyHistogram& other);
+
+			inline void record(uint64_t value) {
+				std::atomic<uint64_t>& bucket = _buckets[bucket_index(value)];
+				bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			}
+
+			void merge(const LatencyHistogram& other);
+			void reset();
+
+			uint64_t count() const;
+			uint64_t percentile(double p) const;
+			uint64_t max() const;
+
+			static inline unsigned int bucket_index(uint64_t value) {
+				if (value < SubBuckets) {
+					return (unsigned int)value;
+				}
+
+				unsigned int msb = 63 - __builtin_clzll(value);
+				unsigned int sub_bucket = (unsigned int)(value >> (msb - SubBucketBits)) & (SubBuckets - 1);
+
+				return (msb - SubBucketBits + 1) * SubBuckets + sub_bucket;
+			}
+
+			static uint64_t bucket_lower_bound(unsigned int index);
+			static uint64_t bucket_upper_bound(unsigned int index);
+
+		private:
+			std::atomic<uint64_t> _buckets[BucketCount];
+		};
+
+		/**
+		 * An aggregate of the metrics recorded by every thread, taken by snapshot().
+		 */
+		struct Snapshot {
+			uint64_t timestamp_ns;
+			unsigned int threads;
+
+			uint64_t counters[Counter::COUNT];
+			uint64_t syscalls[FileDescriptorKind::COUNT];
+			uint64_t eagains[FileDescriptorKind::COUNT];
+
+			LatencyHistogram wait_to_dispatch;
+			LatencyHistogram handler_time;
+
+			std::string to_string() const;
+		};
+
+		/**
+		 * The metrics recorded by a single thread.
+		 */
+		struct ThreadMetrics {
+			std::atomic<uint64_t> counters[Counter::COUNT];
+			std::atomic<uint64_t> syscalls[FileDescriptorKind::COUNT];
+			std::atomic<uint64_t> eagains[FileDescriptorKind::COUNT];
+
+			LatencyHistogram wait_to_dispatch;
+			LatencyHistogram handler_time;
+
+			uint64_t last_wake;
+		};
+
+		bool enabled();
+		Snapshot snapshot();
+
+		ThreadMetrics& thread_metrics();
+		uint64_t now();
+
+		const char *counter_name(Counter::Counter counter);
+		const char *kind_name(FileDescriptorKind::FileDescriptorKind kind);
+
+		/**
+		 * Only the owning thread writes to its metrics, so counters are bumped with a plain
+		 * load and store, rather than an atomic read-modify-write.
+		 */
+		static inline void add(Counter::Counter counter, uint64_t value) {
+			std::atomic<uint64_t>& c = thread_metrics().counters[counter];
+			c.store(c.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+		}
+
+		static inline void syscall(FileDescriptorKind::FileDescriptorKind kind, bool would_block) {
+			ThreadMetrics& m = thread_metrics();
+
+			m.syscalls[kind].store(m.syscalls[kind].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+			if (would_block) {
+				m.eagains[kind].store(m.eagains[kind].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			}
+		}
+
+		/**
+		 * Measures the dispatch of one event by the application: the delay between Epoll::wait
+		 * returning and the handler starting, and the time spent in the handler.  Construct one
+		 * around each handler invocation.  When SFD_TRACE is defined, the start and end of the
+		 * handler are also recorded in the trace ring.  This compiles to nothing unless
+		 * SFD_METRICS or SFD_TRACE is defined.
+		 * @param fd The native file descriptor the handled event belongs to, if any.
+		 */
+		class HandlerScope {
+		public:
+			HandlerScope(int fd = -1)
+#ifdef SFD_METRICS
+				: _start(now())
+#endif
+			{
+#ifdef SFD_METRICS
+				ThreadMetrics& m = thread_metrics();
+				m.wait_to_dispatch.record(_start - m.last_wake);
+#endif
+#ifdef SFD_TRACE
+				_fd = fd;
+#endif
+				SFD_TRACE_EVENT(HANDLER_START, fd, 0);
+			}
+
+			~HandlerScope() {
+				SFD_TRACE_EVENT(HANDLER_END, _fd, 0);
+#ifdef SFD_METRICS
+				thread_metrics().handler_time.record(now() - _start);
+#endif
+			}
+
+		private:
+#ifdef SFD_METRICS
+			uint64_t _start;
+#endif
+#ifdef SFD_TRACE
+			int _fd;
+#endif
+		};
+	}
+}
+
+#ifdef SFD_METRICS
+# define SFD_METRIC_ADD(counter, value) ::sfd::metrics::add(::sfd::metrics::Counter::counter, (value))
+# define SFD_METRIC_SYSCALL(kind, rc) ::sfd::metrics::syscall(::sfd::metrics::FileDescriptorKind::kind, (rc) < 0 && errno == EAGAIN)
+#else
+# define SFD_METRIC_ADD(counter, value) do { } while (0)
+# define SFD_METRIC_SYSCALL(kind, rc) do { (void)(rc); } while (0)
+#endif
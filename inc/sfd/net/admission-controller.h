@@ -0,0 +1,146 @@
+/**
+ * inc/sfd/net/admission-controller.h
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <sfd/epoll.h>
+#include <sfd/timer.h>
+#include <sfd/loop-lag-monitor.h>
+#include <sfd/net/socket.h>
+#include <sfd/exception.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace sfd {
+	namespace net {
+		namespace AdmissionPolicy {
+
+			enum AdmissionPolicy {
+				/**
+				 * Stop accepting while overloaded.  New connections wait in the kernel's
+				 * accept queue (and beyond that, the client's SYN retries) until the loop
+				 * recovers.
+				 */
+				Pause,
+
+				/**
+				 * Accept new connections and reset them straight away, so clients fail fast
+				 * and can retry elsewhere.
+				 */
+				Reject,
+
+				/**
+				 * Hand new connections to a sibling controller (typically another worker
+				 * thread's loop).  If no sibling can take them, they are rejected.
+				 */
+				Shed
+			};
+		}
+
+		/**
+		 * The loop lag at which a listener is considered overloaded, and the (lower) lag it has
+		 * to recover to before it is considered healthy again.  A threshold of zero is ignored.
+		 */
+		struct AdmissionThresholds {
+			uint64_t lag_high_ns = 5000000ull;
+			uint64_t lag_low_ns = 1000000ull;
+			uint64_t iteration_high_ns = 0;
+			uint64_t iteration_low_ns = 0;
+		};
+
+		/**
+		 * Accepts connections on a listener on behalf of an event loop, but stops admitting new
+		 * work when the loop is falling behind (as measured by a LoopLagMonitor), so that an
+		 * overloaded server degrades by turning connections away, rather than by serving every
+		 * connection slowly.  Accepted connections are passed to a callback, which owns them.
+		 */
+		class AdmissionController {
+		public:
+			typedef std::function<void (Socket *socket)> AcceptCallback;
+
+			AdmissionController(Socket& listener, LoopLagMonitor& monitor, AdmissionPolicy::AdmissionPolicy policy,
+				const AdmissionThresholds& thresholds, const AcceptCallback& callback);
+			~AdmissionController();
+
+			void shed_to(AdmissionController& sibling);
+
+			void thresholds(const AdmissionThresholds& thresholds) { _thresholds = thresholds; }
+			const AdmissionThresholds& thresholds() const { return _thresholds; }
+
+			void attach(Epoll& epoll);
+			void detach(Epoll& epoll);
+
+			bool handle(const EpollEvent& event);
+
+			bool overloaded() const { return _overloaded; }
+			bool paused() const { return _paused; }
+
+			uint64_t accepted() const { return _accepted; }
+			uint64_t rejected() const { return _rejected; }
+			uint64_t shed() const { return _shed; }
+			uint64_t received() const { return _received; }
+			uint64_t pauses() const { return _pauses; }
+			uint64_t paused_ns() const;
+
+		private:
+			static const unsigned int MaxAcceptsPerEvent = 32;
+
+			bool evaluate();
+			void accept_pending();
+			void admit(Socket *socket);
+			void reject(Socket *socket);
+			bool shed(Socket *socket);
+			void receive_shed();
+			void pause();
+			void resume();
+
+			Socket& _listener;
+			LoopLagMonitor& _monitor;
+			AdmissionPolicy::AdmissionPolicy _policy;
+			AdmissionThresholds _thresholds;
+			AcceptCallback _callback;
+
+			std::vector<AdmissionController *> _siblings;
+			unsigned int _next_sibling;
+			UnixSocket *_inbox;
+			UnixSocket *_inbox_sender;
+
+			Epoll *_epoll;
+			Timer _recheck;
+			std::atomic<bool> _overloaded;
+			bool _paused;
+			uint64_t _paused_since;
+
+			uint64_t _accepted;
+			uint64_t _rejected;
+			uint64_t _shed;
+			uint64_t _received;
+			uint64_t _pauses;
+			uint64_t _paused_total_ns;
+		};
+
+		class AdmissionControllerException : public Exception {
+		public:
+
+			AdmissionControllerException(const std::string& msg) : Exception(msg) {
+			}
+		};
+	}
+}
@@ -0,0 +1,93 @@
+/**
+ * inc/sfd/net/busy-poller.h
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <sfd/epoll.h>
+#include <sfd/net/socket.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sfd {
+	namespace net {
+
+		/**
+		 * How well a BusyPoller's spin budget fits the traffic it sees.  A spin is one
+		 * zero-timeout wait; it is useful if it found events.  A wakeup is a call to wait
+		 * that returned events, either while spinning or after falling back to a blocking
+		 * wait.
+		 */
+		struct BusyPollStatistics {
+			uint64_t useful_spins;
+			uint64_t wasted_spins;
+			uint64_t spin_wakeups;
+			uint64_t blocking_wakeups;
+			uint64_t budget_exhausted;
+			uint64_t spin_ns;
+
+			/**
+			 * The fraction of spins that found work.  A low efficiency means the budget is
+			 * burning the core for little gain.
+			 */
+			double efficiency() const {
+				uint64_t spins = useful_spins + wasted_spins;
+				return spins ? (double)useful_spins / spins : 0.0;
+			}
+
+			/**
+			 * The fraction of wakeups that were served without sleeping.  A low hit rate means
+			 * the budget is too short to cover the gaps between messages.
+			 */
+			double hit_rate() const {
+				uint64_t wakeups = spin_wakeups + blocking_wakeups;
+				return wakeups ? (double)spin_wakeups / wakeups : 0.0;
+			}
+
+			std::string to_string() const;
+		};
+
+		/**
+		 * An opt-in busy-polling wait for latency-critical loops.  Rather than sleeping in
+		 * epoll_wait straight away, the poller spins with zero-timeout waits for up to its
+		 * budget, and only then falls back to a blocking wait.  Sockets added through the
+		 * poller are also asked to busy-poll their device queue in the kernel
+		 * (SO_BUSY_POLL and SO_PREFER_BUSY_POLL).  Spinning occupies the calling core for the
+		 * whole budget, so the loop should have a core to itself.
+		 */
+		class BusyPoller {
+		public:
+			BusyPoller(Epoll& epoll, uint64_t budget_ns = 50000);
+
+			uint64_t budget() const { return _budget_ns; }
+			void budget(uint64_t budget_ns) { _budget_ns = budget_ns; }
+
+			bool add(Socket *socket, EpollEventType::EpollEventType events, unsigned int busy_poll_us = 50);
+			static bool enable(FileDescriptor& fd, unsigned int busy_poll_us = 50);
+			bool wait(std::vector<EpollEvent>& events, int max_events = 24, int timeout = -1);
+
+			const BusyPollStatistics& statistics() const { return _statistics; }
+			void reset();
+
+		private:
+			Epoll& _epoll;
+			uint64_t _budget_ns;
+			BusyPollStatistics _statistics;
+		};
+	}
+}
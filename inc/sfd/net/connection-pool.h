@@ -0,0 +1,129 @@
+/**
+ * inc/sfd/net/connection-pool.h
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <sfd/epoll.h>
+#include <sfd/timer.h>
+#include <sfd/net/socket.h>
+#include <sfd/net/endpoint.h>
+#include <sfd/net/connector.h>
+#include <sfd/exception.h>
+#include <cstdint>
+#include <deque>
+
+namespace sfd {
+	namespace net {
+
+		struct ConnectionPoolOptions {
+			/**
+			 * The number of idle connections the pool tries to keep ready at all times.
+			 */
+			unsigned int min_idle = 4;
+
+			/**
+			 * The largest number of idle connections the pool will hold on to.  Connections
+			 * released beyond this are closed.
+			 */
+			unsigned int max_idle = 16;
+
+			uint64_t connect_timeout_ns = 1000000000ull;
+
+			/**
+			 * How long a connection may sit idle before it is closed, or zero to keep idle
+			 * connections indefinitely.
+			 */
+			uint64_t max_idle_time_ns = 60000000000ull;
+
+			/**
+			 * How often idle connections are aged out and the pool is topped up to min_idle.
+			 */
+			uint64_t maintenance_interval_ns = 1000000000ull;
+		};
+
+		/**
+		 * Keeps a set of established connections to a single endpoint ready for use, so that
+		 * callers do not pay for connection setup on the request path.  Connections are opened
+		 * in the background with a Connector, and reused most-recently-released first, so
+		 * that the warmest connections (and their caches) are handed out again.  Idle
+		 * connections are watched for readiness, and any that receive unexpected data or are
+		 * closed by the peer are evicted.  The pool is driven by an Epoll instance.
+		 */
+		class ConnectionPool {
+		public:
+			ConnectionPool(const EndPoint& ep, const ConnectionPoolOptions& options = ConnectionPoolOptions());
+			~ConnectionPool();
+
+			void attach(Epoll& epoll);
+			void detach(Epoll& epoll);
+
+			bool handle(const EpollEvent& event);
+
+			Socket *acquire();
+			void release(Socket *socket, bool reusable = true);
+
+			void replenish();
+
+			unsigned int idle() const { return _idle.size(); }
+			unsigned int pending() const { return _connector.pending(); }
+
+			uint64_t hits() const { return _hits; }
+			uint64_t misses() const { return _misses; }
+			uint64_t evictions() const { return _evictions; }
+			uint64_t connect_failures() const { return _connect_failures; }
+
+		private:
+			static const uint64_t MaxBackoffIntervals = 64;
+
+			struct IdleConnection {
+				Socket *socket;
+				uint64_t since;
+			};
+
+			void connected(Socket *socket, int error);
+			void park(Socket *socket);
+			void evict(std::deque<IdleConnection>::iterator connection);
+			void maintain();
+
+			static bool healthy(Socket *socket);
+
+			const EndPoint& _ep;
+			ConnectionPoolOptions _options;
+
+			Epoll *_epoll;
+			Connector _connector;
+			Timer _maintenance;
+			std::deque<IdleConnection> _idle;
+
+			uint64_t _hits;
+			uint64_t _misses;
+			uint64_t _evictions;
+			uint64_t _connect_failures;
+
+			uint64_t _retry_at;
+			uint64_t _backoff_ns;
+		};
+
+		class ConnectionPoolException : public Exception {
+		public:
+
+			ConnectionPoolException(const std::string& msg) : Exception(msg) {
+			}
+		};
+	}
+}
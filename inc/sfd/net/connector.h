@@ -0,0 +1,80 @@
+/**
+ * inc/sfd/net/connector.h
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <sfd/epoll.h>
+#include <sfd/timer.h>
+#include <sfd/net/socket.h>
+#include <sfd/net/endpoint.h>
+#include <sfd/exception.h>
+#include <cstdint>
+#include <functional>
+#include <map>
+
+namespace sfd {
+	namespace net {
+
+		/**
+		 * Invoked when a connection attempt finishes, with the socket and zero on success, or
+		 * the socket and an errno value (ETIMEDOUT if the deadline passed) on failure.  The
+		 * callback owns the socket in either case.
+		 */
+		typedef std::function<void (Socket *socket, int error)> ConnectCallback;
+
+		/**
+		 * Runs many outbound connection attempts concurrently, each with its own deadline.  An
+		 * attempt completes when its socket becomes writable (EPOLLOUT), and its outcome is
+		 * read from SO_ERROR.  The connector is driven by an Epoll instance.
+		 */
+		class Connector {
+		public:
+			Connector();
+			~Connector();
+
+			void attach(Epoll& epoll);
+			void detach(Epoll& epoll);
+
+			bool handle(const EpollEvent& event);
+
+			void connect(Socket *socket, const EndPoint& ep, uint64_t timeout_ns, const ConnectCallback& callback);
+			unsigned int pending() const { return _attempts.size(); }
+
+		private:
+			struct Attempt {
+				uint64_t deadline;
+				ConnectCallback callback;
+			};
+
+			void complete(Socket *socket, int error);
+			void expire();
+			void arm_timer();
+
+			Epoll *_epoll;
+			Timer _timer;
+			std::map<Socket *, Attempt> _attempts;
+		};
+
+		class ConnectorException : public Exception {
+		public:
+
+			ConnectorException(const std::string& msg) : Exception(msg) {
+			}
+		};
+	}
+}
@@ -0,0 +1,432 @@
+/**
+ * inc/sfd/net/flow-table.h
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <sfd/epoll.h>
+#include <sfd/timer.h>
+#include <sfd/metrics.h>
+#include <sfd/net/ip-endpoint.h>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace sfd {
+	namespace net {
+
+		/**
+		 * Identifies a UDP flow by its 4-tuple.  Addresses and ports are in host byte order.
+		 */
+		struct FlowKey {
+			uint32_t source_address;
+			uint32_t destination_address;
+			uint16_t source_port;
+			uint16_t destination_port;
+
+			static FlowKey from(const IPEndPoint& source, const IPEndPoint& destination) {
+				return FlowKey {
+					source.address().address(),
+					destination.address().address(),
+					(uint16_t)source.port(),
+					(uint16_t)destination.port()
+				};
+			}
+
+			bool operator==(const FlowKey& other) const {
+				return source_address == other.source_address && destination_address == other.destination_address
+					&& source_port == other.source_port && destination_port == other.destination_port;
+			}
+
+			/**
+			 * A fast, well-mixed 64-bit hash of the 4-tuple (a multiply-xorshift over the two
+			 * halves of the key, finished with the MurmurHash3 finaliser).
+			 */
+			uint64_t hash() const {
+				uint64_t addresses = (uint64_t)source_address << 32 | destination_address;
+				uint64_t ports = (uint64_t)source_port << 16 | destination_port;
+
+				uint64_t h = addresses * 0x9e3779b97f4a7c15ull ^ (ports + 0x632be59bd9b4e019ull) * 0xc2b2ae3d27d4eb4full;
+
+				h ^= h >> 33;
+				h *= 0xff51afd7ed558ccdull;
+				h ^= h >> 33;
+				h *= 0xc4ceb9fe1a85ec53ull;
+				h ^= h >> 33;
+
+				return h;
+			}
+		};
+
+		/**
+		 * Maps UDP flows to per-flow state, for serving many logical connections over one
+		 * unconnected socket.  The table uses open addressing with linear probing, so a lookup
+		 * is usually a single cache line.  When the table fills, it grows incrementally: entries
+		 * are migrated to the larger table a few slots at a time, on each insert and on each
+		 * timer tick, so no single operation pays for rehashing the whole table.  Flows that
+		 * have not been looked up for the idle timeout are expired by a timer, which also scans
+		 * the table a bounded number of slots at a time.  The timer is registered with an Epoll
+		 * instance.
+		 *
+		 * Flow activity is timestamped with the time of the last timer tick, rather than by
+		 * reading the clock on every lookup, so expiry is accurate to the scan interval.
+		 */
+		template<typename T>
+		class FlowTable {
+		public:
+			typedef std::function<void (const FlowKey& key, T& value)> ExpiryCallback;
+
+			/**
+			 * Creates an empty flow table.
+			 * @param idle_timeout_ns How long a flow may go without being looked up before it
+			 * is expired.
+			 * @param initial_capacity The initial number of slots, rounded up to a power of two.
+			 * @param scan_interval_ns How often the timer ticks.
+			 */
+			FlowTable(uint64_t idle_timeout_ns, size_t initial_capacity = 1024, uint64_t scan_interval_ns = 100000000ull)
+				: _idle_timeout_ns(idle_timeout_ns),
+					_scan_interval_ns(scan_interval_ns),
+					_size(0),
+					_migrate_position(0),
+					_scan_position(0),
+					_now(metrics::now()),
+					_expired(0)
+			{
+				size_t capacity = MinimumCapacity;
+				while (capacity < initial_capacity) {
+					capacity <<= 1;
+				}
+
+				_slots.resize(capacity);
+			}
+
+			/**
+			 * Sets a callback to be invoked with each flow as it expires, to release its state.
+			 * The callback must not modify the table.
+			 */
+			void on_expire(const ExpiryCallback& callback) { _on_expire = callback; }
+
+			void attach(Epoll& epoll) {
+				epoll.add(&_timer, EpollEventType::IN);
+				_timer.arm(_scan_interval_ns, _scan_interval_ns);
+			}
+
+			void detach(Epoll& epoll) {
+				_timer.disarm();
+				epoll.remove(&_timer);
+			}
+
+			bool handle(const EpollEvent& event) {
+				if (event.fd != &_timer) {
+					return false;
+				}
+
+				_timer.acknowledge();
+				tick(metrics::now());
+
+				return true;
+			}
+
+			/**
+			 * Advances the table's clock, and does one round of background work: migrating
+			 * slots, if the table is growing, and expiring idle flows.
+			 * @param now The current time, from metrics::now.
+			 */
+			void tick(uint64_t now) {
+				_now = now;
+
+				if (resizing()) {
+					migrate(TickMigrationSlots);
+				}
+
+				expire(TickScanSlots);
+			}
+
+			/**
+			 * Looks up a flow, and marks it as active.  Flows move as the table grows and as
+			 * other flows are removed, so the returned pointer is only valid until the table is
+			 * next modified or ticks.
+			 * @return The flow's state, or nullptr if the flow is not in the table.
+			 */
+			T *find(const FlowKey& key) {
+				uint64_t hash = key.hash();
+
+				Slot *slot = find_slot(_slots, key, hash);
+				if (!slot && resizing()) {
+					slot = find_old_slot(key, hash);
+				}
+
+				if (!slot) {
+					return nullptr;
+				}
+
+				slot->last_seen = _now;
+				return &slot->value;
+			}
+
+			/**
+			 * Looks up a flow, adding it with default-constructed state if it is not in the
+			 * table, and marks it as active.
+			 * @param key The flow to look up.
+			 * @param inserted If not null, set to whether the flow was added.
+			 * @return The flow's state.
+			 */
+			T& insert(const FlowKey& key, bool *inserted = nullptr) {
+				uint64_t hash = key.hash();
+
+				if (resizing()) {
+					migrate(InsertMigrationSlots);
+				}
+
+				Slot *slot = find_slot(_slots, key, hash);
+
+				if (!slot && resizing()) {
+					// The flow is still waiting to be migrated, so move it now, rather than
+					// keeping two copies.
+					Slot *old = find_old_slot(key, hash);
+					if (old) {
+						slot = place(std::move(*old));
+						old->state = Moved;
+					}
+				}
+
+				if (inserted) {
+					*inserted = (slot == nullptr);
+				}
+
+				if (!slot) {
+					if (!resizing() && (_size + 1) * 4 > _slots.size() * 3) {
+						grow();
+					}
+
+					Slot fresh;
+					fresh.state = Full;
+					fresh.hash = hash;
+					fresh.key = key;
+
+					slot = place(std::move(fresh));
+					_size++;
+				}
+
+				slot->last_seen = _now;
+				return slot->value;
+			}
+
+			/**
+			 * Removes a flow from the table.
+			 * @return True if the flow was in the table.
+			 */
+			bool erase(const FlowKey& key) {
+				uint64_t hash = key.hash();
+
+				Slot *slot = find_slot(_slots, key, hash);
+				if (slot) {
+					remove(slot - _slots.data());
+					_size--;
+
+					return true;
+				}
+
+				if (resizing()) {
+					slot = find_old_slot(key, hash);
+					if (slot) {
+						slot->state = Moved;
+						slot->value = T();
+						_size--;
+
+						return true;
+					}
+				}
+
+				return false;
+			}
+
+			size_t size() const { return _size; }
+			size_t capacity() const { return _slots.size(); }
+			bool resizing() const { return !_old_slots.empty(); }
+			uint64_t expired() const { return _expired; }
+
+		private:
+			static const size_t MinimumCapacity = 16;
+			static const size_t InsertMigrationSlots = 8;
+			static const size_t TickMigrationSlots = 4096;
+			static const size_t TickScanSlots = 4096;
+
+			enum SlotState : uint8_t { Empty, Full, Moved };
+
+			struct Slot {
+				SlotState state = Empty;
+				uint64_t hash = 0;
+				FlowKey key = {};
+				uint64_t last_seen = 0;
+				T value = T();
+			};
+
+			/**
+			 * Finds a flow in the current table.  The current table never contains moved
+			 * slots, so the probe stops at the first empty slot.
+			 */
+			Slot *find_slot(std::vector<Slot>& slots, const FlowKey& key, uint64_t hash) {
+				size_t mask = slots.size() - 1;
+
+				for (size_t i = hash & mask;; i = (i + 1) & mask) {
+					Slot& slot = slots[i];
+
+					if (slot.state == Empty) {
+						return nullptr;
+					}
+
+					if (slot.hash == hash && slot.key == key) {
+						return &slot;
+					}
+				}
+			}
+
+			/**
+			 * Finds a flow in the table being migrated from.  Slots that have been migrated are
+			 * marked as moved, and the probe continues past them.
+			 */
+			Slot *find_old_slot(const FlowKey& key, uint64_t hash) {
+				size_t mask = _old_slots.size() - 1;
+				size_t i = hash & mask;
+
+				for (size_t probes = 0; probes < _old_slots.size(); probes++, i = (i + 1) & mask) {
+					Slot& slot = _old_slots[i];
+
+					if (slot.state == Empty) {
+						return nullptr;
+					}
+
+					if (slot.state == Full && slot.hash == hash && slot.key == key) {
+						return &slot;
+					}
+				}
+
+				return nullptr;
+			}
+
+			/**
+			 * Puts a flow, which must not already be in the current table, into its first free
+			 * slot.
+			 */
+			Slot *place(Slot&& entry) {
+				size_t mask = _slots.size() - 1;
+				size_t i = entry.hash & mask;
+
+				while (_slots[i].state != Empty) {
+					i = (i + 1) & mask;
+				}
+
+				_slots[i] = std::move(entry);
+				_slots[i].state = Full;
+
+				return &_slots[i];
+			}
+
+			/**
+			 * Empties a slot in the current table, shifting later entries in the same probe run
+			 * back, so that the table never needs tombstones.
+			 */
+			void remove(size_t index) {
+				size_t mask = _slots.size() - 1;
+				size_t hole = index;
+
+				for (size_t i = (index + 1) & mask; _slots[i].state != Empty; i = (i + 1) & mask) {
+					size_t home = _slots[i].hash & mask;
+
+					// The entry can fill the hole if the hole lies on its probe path, i.e.
+					// cyclically between its home slot and where it is now.
+					if (((i - home) & mask) >= ((i - hole) & mask)) {
+						_slots[hole] = std::move(_slots[i]);
+						hole = i;
+					}
+				}
+
+				_slots[hole] = Slot();
+			}
+
+			void grow() {
+				_old_slots.swap(_slots);
+				_slots.assign(_old_slots.size() * 2, Slot());
+
+				_migrate_position = 0;
+				_scan_position = 0;
+			}
+
+			void migrate(size_t count) {
+				size_t end = std::min(_old_slots.size(), _migrate_position + count);
+
+				for (; _migrate_position < end; _migrate_position++) {
+					Slot& slot = _old_slots[_migrate_position];
+
+					if (slot.state == Full) {
+						place(std::move(slot));
+						slot.state = Moved;
+					}
+				}
+
+				if (_migrate_position == _old_slots.size()) {
+					std::vector<Slot>().swap(_old_slots);
+				}
+			}
+
+			/**
+			 * Expires idle flows from the next few slots of the current table.  Flows still in
+			 * the old table are expired once they have been migrated.
+			 */
+			void expire(size_t count) {
+				size_t mask = _slots.size() - 1;
+
+				for (size_t n = 0; n < count && _size > 0; n++) {
+					Slot& slot = _slots[_scan_position];
+
+					if (slot.state == Full && _now > slot.last_seen && _now - slot.last_seen >= _idle_timeout_ns) {
+						if (_on_expire) {
+							_on_expire(slot.key, slot.value);
+						}
+
+						// Removing the flow may shift another into this slot, so look at it
+						// again before moving on.
+						remove(_scan_position);
+						_size--;
+						_expired++;
+
+						continue;
+					}
+
+					_scan_position = (_scan_position + 1) & mask;
+				}
+			}
+
+			uint64_t _idle_timeout_ns;
+			uint64_t _scan_interval_ns;
+
+			std::vector<Slot> _slots;
+			std::vector<Slot> _old_slots;
+			size_t _size;
+			size_t _migrate_position;
+			size_t _scan_position;
+
+			Timer _timer;
+			uint64_t _now;
+			uint64_t _expired;
+			ExpiryCallback _on_expire;
+		};
+	}
+}
@@ -19,7 +19,9 @@
 #pragma once
 
 #include <cstdint>
+#include <cstddef>
 #include <string>
+#include <string_view>
 
 namespace sfd {
 	namespace net {
@@ -27,6 +29,11 @@ namespace sfd {
 		class IPAddress {
 		public:
 			typedef uint32_t AddressStorageType;
+
+			/**
+			 * The longest textual form of an address ("255.255.255.255"), excluding any terminator.
+			 */
+			static const size_t MaxStringLength = 15;
 			
 			IPAddress(AddressStorageType address) : _address(address) {
 			}
@@ -63,13 +70,15 @@ namespace sfd {
 				d = (_address >> 0) & 0xff;
 			}
 
-			std::string to_string() const {
-				uint8_t a, b, c, d;
-				to_octets(a, b, c, d);
+			size_t format_to(char *buffer) const;
 
-				return std::to_string(a) + "." + std::to_string(b) + "." + std::to_string(c) + "." + std::to_string(d);
+			std::string to_string() const {
+				char buffer[MaxStringLength];
+				return std::string(buffer, format_to(buffer));
 			}
 
+			static bool parse(std::string_view text, IPAddress& address);
+
 			static inline IPAddress from_octets(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
 				return IPAddress((uint32_t) a << 24 | (uint32_t) b << 16 | (uint32_t) c << 8 | (uint32_t) d);
 			}
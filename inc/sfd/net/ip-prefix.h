@@ -0,0 +1,172 @@
+/**
+ * inc/sfd/net/ip-prefix.h
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <sfd/net/ip-address.h>
+#include <sfd/net/ipv6-address.h>
+#include <sfd/exception.h>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace sfd {
+	namespace net {
+
+		/**
+		 * An IPv4 network prefix, such as 10.0.0.0/8.  Any host bits in the address are
+		 * cleared on construction, so equal networks compare equal.
+		 */
+		class IPPrefix {
+		public:
+			typedef IPAddress AddressType;
+
+			static const unsigned int AddressBits = 32;
+			static const size_t MaxStringLength = IPAddress::MaxStringLength + 3;
+
+			IPPrefix(const IPAddress& address, unsigned int length);
+
+			const IPAddress& address() const {
+				return _address;
+			}
+
+			unsigned int length() const {
+				return _length;
+			}
+
+			bool contains(const IPAddress& address) const {
+				return _length == 0 || ((address.address() ^ _address.address()) >> (AddressBits - _length)) == 0;
+			}
+
+			bool operator==(const IPPrefix& other) const {
+				return _length == other._length && _address.address() == other._address.address();
+			}
+
+			/**
+			 * Orders prefixes by address, and a prefix before the longer prefixes that share
+			 * its address, so that every prefix is followed by the prefixes it contains.
+			 */
+			bool operator<(const IPPrefix& other) const {
+				if (_address.address() != other._address.address()) {
+					return _address.address() < other._address.address();
+				}
+
+				return _length < other._length;
+			}
+
+			size_t format_to(char *buffer) const;
+
+			std::string to_string() const {
+				char buffer[MaxStringLength];
+				return std::string(buffer, format_to(buffer));
+			}
+
+			static bool parse(std::string_view text, IPPrefix& prefix);
+
+			/**
+			 * Extracts count bits (1-32) of an address, starting offset bits from the most
+			 * significant bit.  Bits past the end of the address read as zero.
+			 */
+			static inline uint32_t bits(const IPAddress& address, unsigned int offset, unsigned int count) {
+				return ((uint64_t)address.address() << (32 + offset)) >> (64 - count);
+			}
+
+		private:
+			IPAddress _address;
+			unsigned int _length;
+		};
+
+		/**
+		 * An IPv6 network prefix, such as 2001:db8::/32.  Any host bits in the address are
+		 * cleared on construction, so equal networks compare equal.
+		 */
+		class IPv6Prefix {
+		public:
+			typedef IPv6Address AddressType;
+
+			static const unsigned int AddressBits = 128;
+			static const size_t MaxStringLength = IPv6Address::MaxStringLength + 4;
+
+			IPv6Prefix(const IPv6Address& address, unsigned int length);
+
+			const IPv6Address& address() const {
+				return _address;
+			}
+
+			unsigned int length() const {
+				return _length;
+			}
+
+			bool contains(const IPv6Address& address) const {
+				return IPv6Prefix(address, _length) == *this;
+			}
+
+			bool operator==(const IPv6Prefix& other) const {
+				return _length == other._length && _address == other._address;
+			}
+
+			/**
+			 * Orders prefixes by address, and a prefix before the longer prefixes that share
+			 * its address, so that every prefix is followed by the prefixes it contains.
+			 */
+			bool operator<(const IPv6Prefix& other) const {
+				if (_address != other._address) {
+					return _address.address() < other._address.address();
+				}
+
+				return _length < other._length;
+			}
+
+			size_t format_to(char *buffer) const;
+
+			std::string to_string() const {
+				char buffer[MaxStringLength];
+				return std::string(buffer, format_to(buffer));
+			}
+
+			static bool parse(std::string_view text, IPv6Prefix& prefix);
+
+			/**
+			 * Extracts count bits (1-16) of an address, starting offset bits from the most
+			 * significant bit.  Bits past the end of the address read as zero.
+			 */
+			static inline uint32_t bits(const IPv6Address& address, unsigned int offset, unsigned int count) {
+				const uint8_t *bytes = address.address().data();
+				unsigned int byte = offset / 8;
+
+				uint32_t window = (uint32_t)bytes[byte] << 16;
+				if (byte + 1 < 16) window |= (uint32_t)bytes[byte + 1] << 8;
+				if (byte + 2 < 16) window |= bytes[byte + 2];
+
+				return (window >> (24 - offset % 8 - count)) & ((1u << count) - 1);
+			}
+
+		private:
+			IPv6Address _address;
+			unsigned int _length;
+		};
+
+		class IPPrefixException : public Exception {
+		public:
+
+			IPPrefixException(const std::string& msg) : Exception(msg) {
+			}
+		};
+	}
+}
@@ -0,0 +1,90 @@
+/**
+ * inc/sfd/net/ipv6-address.h
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <sfd/net/ip-address.h>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace sfd {
+	namespace net {
+
+		/**
+		 * A 128-bit IPv6 address, stored in network byte order.
+		 */
+		class IPv6Address {
+		public:
+			typedef std::array<uint8_t, 16> AddressStorageType;
+
+			/**
+			 * The longest textual form of an address (an IPv4-mapped address with eight
+			 * full groups' worth of text), excluding any terminator.
+			 */
+			static const size_t MaxStringLength = 45;
+
+			IPv6Address(const AddressStorageType& address) : _address(address) {
+			}
+
+			const AddressStorageType& address() const {
+				return _address;
+			}
+
+			uint16_t group(unsigned int index) const {
+				return (uint16_t)_address[index * 2] << 8 | _address[index * 2 + 1];
+			}
+
+			bool operator==(const IPv6Address& other) const {
+				return _address == other._address;
+			}
+
+			bool operator!=(const IPv6Address& other) const {
+				return _address != other._address;
+			}
+
+			bool is_v4_mapped() const;
+			IPAddress to_v4() const;
+
+			size_t format_to(char *buffer) const;
+
+			std::string to_string() const {
+				char buffer[MaxStringLength];
+				return std::string(buffer, format_to(buffer));
+			}
+
+			static bool parse(std::string_view text, IPv6Address& address);
+
+			static IPv6Address from_groups(uint16_t a, uint16_t b, uint16_t c, uint16_t d, uint16_t e, uint16_t f, uint16_t g, uint16_t h);
+			static IPv6Address from_v4(const IPAddress& address);
+
+			static inline IPv6Address any() {
+				return IPv6Address(AddressStorageType {});
+			}
+
+			static inline IPv6Address localhost() {
+				return from_groups(0, 0, 0, 0, 0, 0, 0, 1);
+			}
+
+		private:
+			AddressStorageType _address;
+		};
+	}
+}
@@ -0,0 +1,103 @@
+/**
+ * inc/sfd/net/listener-handoff.h
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <sfd/epoll.h>
+#include <sfd/net/socket.h>
+#include <sfd/net/unix-endpoint.h>
+#include <sfd/exception.h>
+#include <string>
+#include <vector>
+
+namespace sfd {
+	namespace net {
+
+		/**
+		 * A listening socket handed from one process to another.
+		 */
+		struct HandoffListener {
+			std::string name;
+			std::string metadata;
+			Socket *socket;
+		};
+
+		/**
+		 * Offers a process's listening sockets to its replacement during a hot restart.  The
+		 * replacement connects to the handoff endpoint and receives duplicates of the listening
+		 * sockets (over SCM_RIGHTS), so the kernel accept queues are never closed and no
+		 * connection attempt is lost.  Once the replacement has acknowledged the handoff, this
+		 * process must stop accepting on the offered listeners, finish serving the connections it
+		 * already has, and exit.  The handshake is bounded by a timeout, so that a replacement
+		 * that stalls part way through cannot hold up this process's event loop.
+		 */
+		class ListenerHandoffServer {
+		public:
+			static const unsigned int DefaultTimeout = 250;
+
+			ListenerHandoffServer(const UnixEndPoint& ep, unsigned int timeout_ms = DefaultTimeout);
+			~ListenerHandoffServer();
+
+			void offer(const std::string& name, Socket& listener, const std::string& metadata = "");
+
+			UnixSocket& socket() { return _socket; }
+
+			bool handle(const EpollEvent& event);
+			bool serve();
+
+			bool handed_off() const {
+				return _handed_off;
+			}
+
+		private:
+			struct Offer {
+				std::string name;
+				std::string metadata;
+				Socket *listener;
+			};
+
+			void handoff(UnixSocket& connection);
+
+			std::string _path;
+			UnixSocket _socket;
+			std::vector<Offer> _offers;
+			unsigned int _timeout_ms;
+			bool _handed_off;
+		};
+
+		/**
+		 * Requests the listening sockets of a running process, as part of a hot restart.
+		 */
+		class ListenerHandoffClient {
+		public:
+			ListenerHandoffClient(const UnixEndPoint& ep);
+
+			std::vector<HandoffListener> request();
+
+		private:
+			UnixEndPoint _endpoint;
+		};
+
+		class ListenerHandoffException : public Exception {
+		public:
+
+			ListenerHandoffException(const std::string& msg) : Exception(msg) {
+			}
+		};
+	}
+}
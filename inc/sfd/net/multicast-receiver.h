@@ -0,0 +1,184 @@
+/**
+ * inc/sfd/net/multicast-receiver.h
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <sfd/epoll.h>
+#include <sfd/timer.h>
+#include <sfd/net/socket.h>
+#include <sfd/net/ip-address.h>
+#include <sfd/exception.h>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+namespace sfd {
+	namespace net {
+
+		/**
+		 * Extracts the sequence number from a datagram's header.  The parse function returns
+		 * false if the datagram carries no sequence number (e.g. a heartbeat), in which case
+		 * it is not considered for gap detection.  Sequence numbers are width bytes wide, and
+		 * are compared modulo 2^(8 * width), so that they may wrap.
+		 */
+		class SequenceParser {
+		public:
+			typedef std::function<bool (const void *data, size_t length, uint64_t& sequence)> ParseFunction;
+
+			SequenceParser() : _width(8) {
+			}
+
+			template<typename F> requires (!std::is_same_v<std::decay_t<F>, SequenceParser>)
+			SequenceParser(F&& parse, unsigned int width = 8) : _parse(std::forward<F>(parse)), _width(width) {
+			}
+
+			explicit operator bool() const {
+				return (bool)_parse;
+			}
+
+			bool operator()(const void *data, size_t length, uint64_t& sequence) const {
+				return _parse(data, length, sequence);
+			}
+
+			unsigned int width() const {
+				return _width;
+			}
+
+		private:
+			ParseFunction _parse;
+			unsigned int _width;
+		};
+
+		/**
+		 * The receive statistics of one multicast group.  A gap is a jump forwards in the
+		 * sequence numbers; lost counts the sequence numbers skipped over.  A datagram whose
+		 * sequence number is at most ReorderWindow behind the last one seen is counted as
+		 * reordered (or duplicated), and does not move the expected sequence number backwards.
+		 * A jump further backwards is taken to be the sender restarting its sequence, and is
+		 * counted as a reset.  Datagrams longer than the receiver's maximum datagram size are
+		 * counted as truncated, and are dropped.
+		 */
+		struct MulticastGroupStatistics {
+			static const uint64_t ReorderWindow = 64;
+
+			uint64_t packets;
+			uint64_t bytes;
+			uint64_t gaps;
+			uint64_t lost;
+			uint64_t reordered;
+			uint64_t resets;
+			uint64_t truncated;
+			uint64_t kernel_drops;
+			uint64_t last_sequence;
+
+			double packets_per_sec;
+			double bytes_per_sec;
+
+			std::string to_string() const;
+		};
+
+		/**
+		 * Receives datagrams from many multicast groups.  Each group has its own socket, which
+		 * is drained with batched recvmmsg calls when it becomes readable, and every datagram is
+		 * passed to a handler along with the group it arrived on.  If the group has a sequence
+		 * parser, gaps in each group's sequence numbers are detected and counted.  The receiver
+		 * is driven by an Epoll instance.
+		 */
+		class MulticastReceiver {
+		public:
+			typedef unsigned int GroupID;
+			typedef std::function<void (GroupID group, const void *data, size_t length)> PacketHandler;
+
+			MulticastReceiver(const PacketHandler& handler, unsigned int batch_size = 32, size_t max_datagram = 2048);
+			~MulticastReceiver();
+
+			GroupID add_group(const IPAddress& group, int port, const IPAddress& interface = IPAddress::any(),
+				const SequenceParser& parser = SequenceParser());
+			GroupID add_source_group(const IPAddress& group, const IPAddress& source, int port,
+				const IPAddress& interface = IPAddress::any(), const SequenceParser& parser = SequenceParser());
+
+			void attach(Epoll& epoll);
+			void detach(Epoll& epoll);
+
+			bool handle(const EpollEvent& event);
+			unsigned int drain(GroupID group);
+
+			unsigned int groups() const { return _groups.size(); }
+			const MulticastGroupStatistics& statistics(GroupID group) const { return _groups.at(group)->statistics; }
+
+			/**
+			 * How many recvmmsg calls have been made, and how many datagrams they returned, so
+			 * that the effectiveness of batching can be checked.
+			 */
+			uint64_t receive_calls() const { return _receive_calls; }
+			uint64_t received() const { return _received; }
+
+			static SequenceParser big_endian_sequence(size_t offset, size_t width);
+
+		private:
+			static const unsigned int MaxBatchesPerEvent = 4;
+
+			struct Group {
+				IPAddress address;
+				IPSocket socket;
+				SequenceParser parser;
+				MulticastGroupStatistics statistics;
+
+				bool sequenced;
+				uint64_t rate_packets;
+				uint64_t rate_bytes;
+				uint32_t drop_counter;
+
+				Group(const IPAddress& address, const SequenceParser& parser);
+			};
+
+			GroupID add(Group *group, int port);
+			void account(Group& group, const void *data, size_t length);
+			void update_rates();
+
+			PacketHandler _handler;
+			unsigned int _batch_size;
+			size_t _max_datagram;
+
+			std::vector<Group *> _groups;
+
+			std::vector<char> _buffers;
+			std::vector<char> _control;
+			std::vector<struct iovec> _iovecs;
+			std::vector<struct mmsghdr> _messages;
+
+			Timer _rate_timer;
+			uint64_t _rate_since;
+
+			uint64_t _receive_calls;
+			uint64_t _received;
+		};
+
+		class MulticastReceiverException : public Exception {
+		public:
+
+			MulticastReceiverException(const std::string& msg) : Exception(msg) {
+			}
+		};
+	}
+}
@@ -0,0 +1,555 @@
+/**
+ * inc/sfd/net/prefix-table.h
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <sfd/net/ip-prefix.h>
+#include <sfd/exception.h>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sfd {
+	namespace net {
+
+		class PrefixTableException : public Exception {
+		public:
+
+			PrefixTableException(const std::string& msg) : Exception(msg) {
+			}
+		};
+
+		/**
+		 * Tracks the readers of a data structure that is updated by publishing a new copy
+		 * and retiring the old one (read-copy-update).  Each reader thread claims a slot, and
+		 * marks it with the current epoch for the duration of each read.  A writer that has
+		 * published a new copy calls synchronize, which returns once every read that could
+		 * have seen the old copy has finished, so that the old copy can be freed.
+		 *
+		 * Where the kernel supports it, the writer issues an expedited membarrier() so that
+		 * readers need only a compiler barrier, rather than a full fence, on entry.
+		 */
+		class ReaderRegistry {
+		public:
+			typedef unsigned int SlotID;
+
+			static const unsigned int MaxReaders = 64;
+
+			ReaderRegistry();
+
+			SlotID claim();
+			void release(SlotID slot);
+
+			inline void enter(SlotID slot) {
+				// Acquire, so that a reader that sees a writer's new epoch also sees the table
+				// that writer published before advancing it.
+				_slots[slot].epoch.store(_epoch.load(std::memory_order_acquire), std::memory_order_relaxed);
+
+				if (_asymmetric) {
+					std::atomic_signal_fence(std::memory_order_seq_cst);
+				} else {
+					std::atomic_thread_fence(std::memory_order_seq_cst);
+				}
+			}
+
+			inline void leave(SlotID slot) {
+				_slots[slot].epoch.store(0, std::memory_order_release);
+			}
+
+			void synchronize();
+
+		private:
+			struct alignas(64) Slot {
+				std::atomic<uint64_t> epoch;
+				std::atomic<bool> claimed;
+			};
+
+			Slot _slots[MaxReaders];
+			std::atomic<uint64_t> _epoch;
+			bool _asymmetric;
+		};
+
+		/**
+		 * A longest-prefix-match table, mapping network prefixes to 31-bit values (such as
+		 * policy identifiers).  The table is a multibit trie with leaf pushing: a root array
+		 * indexed by the first RootBits bits of the address, then nodes of NodeBits bits
+		 * each, with every prefix expanded to the entries it covers at the level where it
+		 * ends.  Nodes are compressed as in Poptrie: bitmaps mark which entries lead to child
+		 * nodes and where runs of equal values begin, and a popcount of the bitmap locates
+		 * the child or the value in arrays shared by the whole trie.  A lookup is one load
+		 * per level, stopping at the first entry that holds a value.
+		 *
+		 * Updates are staged with insert and erase, and become visible atomically on commit,
+		 * which builds a new trie and swaps it in.  Lookups are made through a Reader, which
+		 * never blocks or takes a lock, so lookups may run on any number of threads whilst
+		 * another thread updates the table.
+		 */
+		template<typename Prefix, unsigned int RootBits>
+		class PrefixTable {
+		public:
+			typedef typename Prefix::AddressType Address;
+			typedef uint32_t Value;
+
+			static constexpr Value NoMatch = 0x7fffffff;
+			static constexpr unsigned int NodeBits = 6;
+
+			/**
+			 * A handle through which one thread performs lookups.  Each reader occupies
+			 * one of the table's ReaderRegistry::MaxReaders slots until it is destroyed,
+			 * which must happen before the table is destroyed.
+			 */
+			class Reader {
+			public:
+				Reader(Reader&& other) noexcept : _table(other._table), _slot(other._slot) {
+					other._table = nullptr;
+				}
+
+				Reader(const Reader&) = delete;
+				Reader& operator=(const Reader&) = delete;
+
+				~Reader() {
+					if (_table) {
+						_table->_readers.release(_slot);
+					}
+				}
+
+				/**
+				 * Returns the value of the longest prefix containing the given address, or
+				 * NoMatch if no prefix contains it.
+				 */
+				Value lookup(const Address& address) {
+					_table->_readers.enter(_slot);
+					Value value = PrefixTable::lookup(_table->_current.load(std::memory_order_acquire), address);
+					_table->_readers.leave(_slot);
+
+					return value;
+				}
+
+				/**
+				 * Looks up a batch of addresses, one level at a time across the batch, so that
+				 * the loads for different addresses overlap.  All of the lookups see the same
+				 * version of the table.
+				 */
+				void lookup(const Address *addresses, Value *values, size_t count) {
+					_table->_readers.enter(_slot);
+					PrefixTable::lookup(_table->_current.load(std::memory_order_acquire), addresses, values, count);
+					_table->_readers.leave(_slot);
+				}
+
+			private:
+				friend class PrefixTable;
+
+				Reader(PrefixTable *table, ReaderRegistry::SlotID slot) : _table(table), _slot(slot) {
+				}
+
+				PrefixTable *_table;
+				ReaderRegistry::SlotID _slot;
+			};
+
+			PrefixTable() : _current(new Trie(0)) {
+			}
+
+			~PrefixTable() {
+				delete _current.load();
+			}
+
+			PrefixTable(const PrefixTable&) = delete;
+			PrefixTable& operator=(const PrefixTable&) = delete;
+
+			/**
+			 * Claims a reader slot, for one thread to perform lookups through.
+			 */
+			Reader reader() {
+				return Reader(this, _readers.claim());
+			}
+
+			/**
+			 * Stages a prefix, replacing the value of an equal prefix if there is one.
+			 */
+			void insert(const Prefix& prefix, Value value) {
+				if (value >= NoMatch) {
+					throw PrefixTableException("Prefix value out of range");
+				}
+
+				std::lock_guard<std::mutex> lock(_update_lock);
+				_staged[prefix] = value;
+			}
+
+			/**
+			 * Stages the removal of a prefix.
+			 * @return True if the prefix was present.
+			 */
+			bool erase(const Prefix& prefix) {
+				std::lock_guard<std::mutex> lock(_update_lock);
+				return _staged.erase(prefix) > 0;
+			}
+
+			/**
+			 * Stages the removal of every prefix.
+			 */
+			void clear() {
+				std::lock_guard<std::mutex> lock(_update_lock);
+				_staged.clear();
+			}
+
+			/**
+			 * Replaces the contents of the table with the given prefixes, and commits.  If a
+			 * prefix appears more than once, its last value is used.
+			 */
+			void load(const std::vector<std::pair<Prefix, Value>>& prefixes) {
+				std::vector<std::pair<Prefix, Value>> sorted(prefixes);
+
+				for (const Entry& entry : sorted) {
+					if (entry.second >= NoMatch) {
+						throw PrefixTableException("Prefix value out of range");
+					}
+				}
+
+				std::stable_sort(sorted.begin(), sorted.end(), [](const Entry& a, const Entry& b) { return a.first < b.first; });
+
+				// Sorted input lets every insertion go straight to the end of the map.
+				std::map<Prefix, Value> staged;
+				for (size_t i = 0; i < sorted.size(); i++) {
+					if (i + 1 < sorted.size() && sorted[i].first == sorted[i + 1].first) {
+						continue;
+					}
+
+					staged.emplace_hint(staged.end(), sorted[i]);
+				}
+
+				std::lock_guard<std::mutex> lock(_update_lock);
+				_staged.swap(staged);
+				publish();
+			}
+
+			/**
+			 * Makes the staged prefixes visible to readers.  Lookups that are in progress
+			 * complete against the old version of the table, which is freed once they have.
+			 */
+			void commit() {
+				std::lock_guard<std::mutex> lock(_update_lock);
+				publish();
+			}
+
+			/**
+			 * Returns the number of prefixes in the committed table.
+			 */
+			size_t size() const {
+				std::lock_guard<std::mutex> lock(_update_lock);
+				return _current.load()->prefixes;
+			}
+
+			/**
+			 * Returns the number of bytes occupied by the committed table.
+			 */
+			size_t memory_usage() const {
+				std::lock_guard<std::mutex> lock(_update_lock);
+				const Trie *trie = _current.load();
+
+				return trie->root.size() * sizeof(uint32_t) + trie->nodes.size() * sizeof(Node) + trie->values.size() * sizeof(Value);
+			}
+
+		private:
+			typedef std::pair<Prefix, Value> Entry;
+
+			static constexpr uint32_t ChildFlag = 0x80000000;
+			static constexpr unsigned int NodeEntries = 1u << NodeBits;
+
+			/**
+			 * A compressed node.  Bit i of children is set if entry i leads to a child node,
+			 * and bit i of leaves is set if entry i holds a value that differs from the value
+			 * of the previous entry that holds one.  The node's children, and the values of
+			 * its runs of leaves, are stored contiguously from child_base and leaf_base.
+			 */
+			struct Node {
+				uint64_t children;
+				uint64_t leaves;
+				uint32_t child_base;
+				uint32_t leaf_base;
+			};
+
+			/**
+			 * One immutable version of the table.  Root entries either hold a value (or
+			 * NoMatch), or have ChildFlag set and hold the index of a node.
+			 */
+			struct Trie {
+				Trie(size_t prefixes) : root(1u << RootBits, NoMatch), prefixes(prefixes) {
+				}
+
+				std::vector<uint32_t> root;
+				std::vector<Node> nodes;
+				std::vector<Value> values;
+				size_t prefixes;
+			};
+
+			/**
+			 * Counts the set bits of a node's bitmap.
+			 */
+			static inline unsigned int count_bits(uint64_t bits) {
+#ifdef __POPCNT__
+				return std::popcount(bits);
+#else
+				// Without the POPCNT instruction std::popcount is a library call, so sum the
+				// bits inline instead.
+				bits = bits - ((bits >> 1) & 0x5555555555555555ull);
+				bits = (bits & 0x3333333333333333ull) + ((bits >> 2) & 0x3333333333333333ull);
+				bits = (bits + (bits >> 4)) & 0x0f0f0f0f0f0f0f0full;
+
+				return (bits * 0x0101010101010101ull) >> 56;
+#endif
+			}
+
+			/**
+			 * Follows one address through a node.
+			 * @return The child node to continue at, or null if the value has been found.
+			 */
+			static inline const Node *step(const Trie *trie, const Node *node, unsigned int index, Value& value) {
+				uint64_t upto = (2ull << index) - 1;
+
+				if (node->children & (1ull << index)) {
+					return &trie->nodes[node->child_base + count_bits(node->children & upto) - 1];
+				}
+
+				value = trie->values[node->leaf_base + count_bits(node->leaves & upto) - 1];
+				return nullptr;
+			}
+
+			static inline Value lookup(const Trie *trie, const Address& address) {
+				uint32_t entry = trie->root[Prefix::bits(address, 0, RootBits)];
+
+				if (!(entry & ChildFlag)) {
+					return entry;
+				}
+
+				const Node *node = &trie->nodes[entry & ~ChildFlag];
+				Value value = NoMatch;
+
+				for (unsigned int offset = RootBits; node; offset += NodeBits) {
+					node = step(trie, node, Prefix::bits(address, offset, NodeBits), value);
+				}
+
+				return value;
+			}
+
+			static void lookup(const Trie *trie, const Address *addresses, Value *values, size_t count) {
+				const size_t BatchSize = 16;
+
+				for (size_t base = 0; base < count; base += BatchSize) {
+					size_t n = std::min(BatchSize, count - base);
+					const Node *nodes[BatchSize];
+					size_t pending = 0;
+
+					for (size_t i = 0; i < n; i++) {
+						__builtin_prefetch(&trie->root[Prefix::bits(addresses[base + i], 0, RootBits)]);
+					}
+
+					for (size_t i = 0; i < n; i++) {
+						uint32_t entry = trie->root[Prefix::bits(addresses[base + i], 0, RootBits)];
+
+						if (entry & ChildFlag) {
+							nodes[i] = &trie->nodes[entry & ~ChildFlag];
+							__builtin_prefetch(nodes[i]);
+							pending++;
+						} else {
+							nodes[i] = nullptr;
+							values[base + i] = entry;
+						}
+					}
+
+					for (unsigned int offset = RootBits; pending; offset += NodeBits) {
+						for (size_t i = 0; i < n; i++) {
+							if (nodes[i]) {
+								nodes[i] = step(trie, nodes[i], Prefix::bits(addresses[base + i], offset, NodeBits), values[base + i]);
+
+								if (nodes[i]) {
+									__builtin_prefetch(nodes[i]);
+								} else {
+									pending--;
+								}
+							}
+						}
+					}
+				}
+			}
+
+			/**
+			 * Sets the value of the entries of one level of the trie that a prefix ending
+			 * within that level covers, unless a longer prefix already covers them.
+			 */
+			static void cover(const Entry& entry, unsigned int offset, unsigned int stride, Value *entries, int *lengths) {
+				unsigned int length = entry.first.length();
+				unsigned int covered = length - offset;
+				size_t first = covered ? Prefix::bits(entry.first.address(), offset, covered) << (stride - covered) : 0;
+
+				for (size_t i = first; i < first + (1u << (stride - covered)); i++) {
+					if ((int)length > lengths[i]) {
+						lengths[i] = length;
+						entries[i] = entry.second;
+					}
+				}
+			}
+
+			/**
+			 * Builds the node at the given index from a range of prefixes, and then its
+			 * children, recursively.  The prefixes are ordered by address, all extend past
+			 * offset bits, and all share the node's leading bits, so the prefixes that
+			 * continue below each entry form a contiguous run, in order of entry.
+			 */
+			static void build_node(Trie *trie, uint32_t index, const Entry *begin, const Entry *end, unsigned int offset, Value inherited) {
+				struct Group {
+					uint32_t entry;
+					const Entry *begin;
+					const Entry *end;
+				};
+
+				Group groups[NodeEntries];
+				unsigned int group_count = 0;
+				bool ending = false;
+
+				for (const Entry *entry = begin; entry < end; entry++) {
+					if (entry->first.length() <= offset + NodeBits) {
+						ending = true;
+						continue;
+					}
+
+					uint32_t i = Prefix::bits(entry->first.address(), offset, NodeBits);
+
+					if (group_count > 0 && groups[group_count - 1].entry == i) {
+						groups[group_count - 1].end = entry + 1;
+					} else {
+						groups[group_count++] = { i, entry, entry + 1 };
+					}
+				}
+
+				Node node = { 0, 0, 0, (uint32_t)trie->values.size() };
+				for (unsigned int g = 0; g < group_count; g++) {
+					node.children |= 1ull << groups[g].entry;
+				}
+
+				// Most nodes on a long prefix's path hold no prefixes of their own, so every
+				// leaf has the inherited value, and only the first leaf starts a run.
+				Value entries[NodeEntries];
+
+				if (ending) {
+					int lengths[NodeEntries];
+
+					std::fill(entries, entries + NodeEntries, inherited);
+					std::fill(lengths, lengths + NodeEntries, -1);
+
+					for (const Entry *entry = begin; entry < end; entry++) {
+						if (entry->first.length() <= offset + NodeBits) {
+							cover(*entry, offset, NodeBits, entries, lengths);
+						}
+					}
+
+					for (unsigned int i = 0; i < NodeEntries; i++) {
+						if (!(node.children & (1ull << i)) && (node.leaves == 0 || entries[i] != trie->values.back())) {
+							node.leaves |= 1ull << i;
+							trie->values.push_back(entries[i]);
+						}
+					}
+				} else if (~node.children) {
+					node.leaves = ~node.children & (node.children + 1);
+					trie->values.push_back(inherited);
+				}
+
+				// Reserve the children's slots before building them, so that they are contiguous.
+				node.child_base = trie->nodes.size();
+				trie->nodes.resize(trie->nodes.size() + group_count);
+				trie->nodes[index] = node;
+
+				for (unsigned int g = 0; g < group_count; g++) {
+					const Group& group = groups[g];
+					build_node(trie, node.child_base + g, group.begin, group.end, offset + NodeBits, ending ? entries[group.entry] : inherited);
+				}
+			}
+
+			/**
+			 * Builds a trie from the staged prefixes.
+			 */
+			Trie *build() const {
+				std::vector<Entry> sorted(_staged.begin(), _staged.end());
+				const Entry *begin = sorted.data();
+				const Entry *end = begin + sorted.size();
+
+				std::vector<Value> entries(1u << RootBits, NoMatch);
+				std::vector<int> lengths(1u << RootBits, -1);
+				std::vector<std::pair<const Entry *, const Entry *>> groups(1u << RootBits);
+
+				for (const Entry *entry = begin; entry < end; entry++) {
+					if (entry->first.length() <= RootBits) {
+						cover(*entry, 0, RootBits, entries.data(), lengths.data());
+						continue;
+					}
+
+					auto& group = groups[Prefix::bits(entry->first.address(), 0, RootBits)];
+					if (!group.first) {
+						group.first = entry;
+					}
+
+					group.second = entry + 1;
+				}
+
+				Trie *trie = new Trie(sorted.size());
+
+				for (size_t i = 0; i < trie->root.size(); i++) {
+					if (!groups[i].first) {
+						trie->root[i] = entries[i];
+						continue;
+					}
+
+					uint32_t index = trie->nodes.size();
+					trie->nodes.resize(index + 1);
+					build_node(trie, index, groups[i].first, groups[i].second, RootBits, entries[i]);
+
+					trie->root[i] = ChildFlag | index;
+				}
+
+				trie->nodes.shrink_to_fit();
+				trie->values.shrink_to_fit();
+				return trie;
+			}
+
+			void publish() {
+				Trie *old = _current.exchange(build());
+
+				_readers.synchronize();
+				delete old;
+			}
+
+			std::map<Prefix, Value> _staged;
+			std::atomic<Trie *> _current;
+			ReaderRegistry _readers;
+			mutable std::mutex _update_lock;
+		};
+
+		/**
+		 * IPv4 tables index the root by 18 bits (a 1MB array), so that the common /24
+		 * prefixes end in the first level of nodes.  IPv6 prefixes are longer and sparser,
+		 * so a 16-bit root suffices.
+		 */
+		typedef PrefixTable<IPPrefix, 18> IPPrefixTable;
+		typedef PrefixTable<IPv6Prefix, 16> IPv6PrefixTable;
+	}
+}
@@ -0,0 +1,161 @@
+/**
+ * inc/sfd/net/rate-limiter.h
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <sfd/fd.h>
+#include <sfd/epoll.h>
+#include <sfd/timer.h>
+#include <sfd/exception.h>
+#include <cstdint>
+#include <list>
+#include <vector>
+
+namespace sfd {
+	namespace net {
+
+		/**
+		 * A token bucket, measured in bytes.  Tokens accumulate at the configured rate, up to
+		 * the burst size, and are spent by sending.  The burst size must be at least one byte.
+		 */
+		class TokenBucket {
+		public:
+			TokenBucket(uint64_t rate_bytes_per_sec, uint64_t burst_bytes);
+
+			void configure(uint64_t rate_bytes_per_sec, uint64_t burst_bytes);
+
+			uint64_t rate() const { return _rate; }
+			uint64_t burst() const { return _burst; }
+
+			void refill(uint64_t now);
+			bool available(size_t bytes) const { return _tokens >= (double)bytes; }
+			void consume(size_t bytes) { _tokens -= (double)bytes; }
+
+			uint64_t delay_for(size_t bytes) const;
+
+		private:
+			uint64_t _rate;
+			uint64_t _burst;
+			double _tokens;
+			uint64_t _last_refill;
+		};
+
+		class PacedWriter;
+
+		/**
+		 * A hierarchy of token buckets that gates writes in userspace, for traffic the kernel
+		 * cannot pace itself (see Socket::max_pacing_rate), or for limits shared by several
+		 * sockets.  Every class has its own rate and burst, and a write in a class spends
+		 * tokens from that class and from each of its ancestors, so a parent caps the
+		 * aggregate of its children.  Writers that run out of tokens are released in order by
+		 * a timer, registered with an Epoll instance, and other writers do not overtake them
+		 * in the classes they are waiting on.
+		 */
+		class RateLimiter {
+			friend class PacedWriter;
+
+		public:
+			typedef unsigned int ClassID;
+			static const ClassID Root = 0;
+
+			RateLimiter(uint64_t rate_bytes_per_sec, uint64_t burst_bytes);
+
+			ClassID add_class(ClassID parent, uint64_t rate_bytes_per_sec, uint64_t burst_bytes);
+			void configure(ClassID id, uint64_t rate_bytes_per_sec, uint64_t burst_bytes);
+
+			uint64_t rate(ClassID id) const { return _classes.at(id).bucket.rate(); }
+			uint64_t burst(ClassID id) const { return _classes.at(id).bucket.burst(); }
+
+			void attach(Epoll& epoll);
+			void detach(Epoll& epoll);
+
+			bool handle(const EpollEvent& event);
+
+		private:
+			struct TrafficClass {
+				TrafficClass(ClassID parent, uint64_t rate, uint64_t burst) : parent(parent), bucket(rate, burst) { }
+
+				ClassID parent;
+				TokenBucket bucket;
+			};
+
+			size_t allowance(ClassID id, size_t wanted);
+			void spend(ClassID id, size_t bytes);
+			uint64_t delay_for(ClassID id, size_t wanted);
+			bool contended(const PacedWriter *writer);
+
+			void block(PacedWriter *writer);
+			void unblock(PacedWriter *writer);
+			void release();
+			void arm_timer();
+
+			std::vector<TrafficClass> _classes;
+			std::list<PacedWriter *> _blocked;
+
+			Epoll *_epoll;
+			Timer _timer;
+		};
+
+		/**
+		 * Writes to a file descriptor within the limits of a RateLimiter class.  While the
+		 * class has tokens, nothing is queued, and no blocked writer is waiting on the same
+		 * tokens, writes go straight through, so traffic under the limit is not delayed.  Anything beyond the limit is queued in the writer and sent
+		 * as tokens are released.  The file descriptor is placed into non-blocking mode, and
+		 * the writer also waits for it to become writable when the kernel's buffer fills.
+		 */
+		class PacedWriter {
+			friend class RateLimiter;
+
+		public:
+			PacedWriter(RateLimiter& limiter, RateLimiter::ClassID id, FileDescriptor& fd);
+			~PacedWriter();
+
+			void attach(Epoll& epoll);
+			void detach(Epoll& epoll);
+
+			bool handle(const EpollEvent& event);
+
+			void write(const void *data, size_t length);
+			void pump();
+
+			size_t queued() const { return _queue.size() - _queue_offset; }
+			uint64_t written() const { return _written; }
+			bool failed() const { return _failed; }
+
+		private:
+			RateLimiter& _limiter;
+			RateLimiter::ClassID _id;
+			FileDescriptor& _fd;
+
+			size_t send(const char *data, size_t length, bool& throttled);
+
+			std::vector<char> _queue;
+			size_t _queue_offset;
+			uint64_t _written;
+			bool _blocked;
+			bool _failed;
+		};
+
+		class RateLimiterException : public Exception {
+		public:
+
+			RateLimiterException(const std::string& msg) : Exception(msg) {
+			}
+		};
+	}
+}
@@ -0,0 +1,69 @@
+/**
+ * inc/sfd/net/socket-tuning.h
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+namespace sfd {
+	namespace net {
+
+		/**
+		 * A declarative set of socket options, applied in one go with Socket::tune.  Options
+		 * that are left unset are not touched.  TCP options are skipped on sockets that are not
+		 * TCP, and IP options on sockets that are not IP, so one tuning can be shared between
+		 * transports.
+		 */
+		struct SocketTuning {
+			std::optional<bool> no_delay;
+			std::optional<bool> quick_ack;
+			std::optional<bool> cork;
+			std::optional<unsigned int> not_sent_low_water;
+			std::optional<unsigned int> user_timeout_ms;
+
+			std::optional<int> send_buffer_size;
+			std::optional<int> receive_buffer_size;
+			std::optional<int> priority;
+			std::optional<unsigned int> busy_poll_us;
+			std::optional<bool> prefer_busy_poll;
+			std::optional<int> incoming_cpu;
+			std::optional<uint64_t> max_pacing_rate;
+
+			std::optional<uint8_t> type_of_service;
+
+			/**
+			 * For request-response traffic where every message is latency-sensitive: small
+			 * writes are sent immediately, ACKs are not delayed, only a little unsent data is
+			 * allowed to queue in the kernel (so that the application sees backpressure early
+			 * and can prioritise what it writes next), and a peer that stops acknowledging is
+			 * given up on after ten seconds rather than the default of many minutes.
+			 */
+			static SocketTuning low_latency_rpc();
+
+			/**
+			 * For long-lived transfers where throughput matters more than the latency of any
+			 * single write: Nagle's algorithm is left on so that small writes are coalesced,
+			 * the socket buffers are pinned at 4 MiB (enough for a 10 Gbit/s path with a few
+			 * milliseconds of RTT, capped by net.core.wmem_max and rmem_max; this disables the
+			 * kernel's buffer auto-tuning), and the packets go on the lowest priority queue.
+			 */
+			static SocketTuning bulk_transfer();
+		};
+	}
+}
@@ -21,8 +21,16 @@
 #include <sfd/fd.h>
 #include <sfd/net/types.h>
 #include <sfd/net/endpoint.h>
+#include <sfd/net/ip-address.h>
+#include <sfd/net/timestamping.h>
+#include <sfd/net/socket-tuning.h>
 #include <sfd/exception.h>
+#include <sfd/metrics.h>
+#include <sfd/trace.h>
+#include <sys/types.h>
+#include <cstdint>
 #include <string>
+#include <vector>
 
 namespace sfd {
 	namespace net {
@@ -37,23 +45,77 @@ namespace sfd {
 			};
 		}
 
+		/**
+		 * A typed view of the kernel's TCP_INFO for a connection.  Times are in microseconds.
+		 * Fields that the running kernel does not report are zero.
+		 */
+		struct TcpInfo {
+			uint8_t state;
+			uint32_t rtt_us;
+			uint32_t rtt_variance_us;
+			uint32_t congestion_window;
+			uint32_t send_mss;
+			uint32_t unacked;
+			uint32_t lost;
+			uint32_t total_retransmits;
+			uint64_t delivery_rate;
+			uint64_t bytes_acked;
+			uint64_t bytes_received;
+			uint64_t busy_time_us;
+			uint64_t rwnd_limited_us;
+			uint64_t sndbuf_limited_us;
+		};
+
+		/**
+		 * Connection establishment options for a listening TCP socket.
+		 */
+		struct ListenOptions {
+			/**
+			 * The number of pending TCP Fast Open requests (connections whose SYN carried
+			 * data) the listener will hold, or zero to leave Fast Open disabled.
+			 */
+			int fast_open_queue = 0;
+
+			/**
+			 * If non-zero, connections are not handed to accept until the client has sent
+			 * some data, or until this many seconds have passed (TCP_DEFER_ACCEPT).
+			 */
+			unsigned int defer_accept_seconds = 0;
+		};
+
+		class IPEndPoint;
+
 		class Socket : public FileDescriptor {
 		public:
 			Socket(AddressFamily::AddressFamily family, SocketType::SocketType type, ProtocolType::ProtocolType protocol);
 
 			void bind(const EndPoint& ep);
 			void listen(int max_pending);
+			void listen(int max_pending, const ListenOptions& options);
 			Socket *accept();
 
+			static Socket *adopt(FileDescriptor::NativeFD fd);
+
 			void connect(const EndPoint& ep);
+			bool begin_connect(const EndPoint& ep);
+			int finish_connect();
+			size_t connect_with_data(const EndPoint& ep, const void *data, size_t length);
 			void shutdown(ShutdownModes::ShutdownModes mode = ShutdownModes::Both);
 			
 			size_t send_to(const void *message, size_t length, const EndPoint& rep);
 			size_t recv_from(void *buffer, size_t length, EndPoint *rep);
+			size_t recv_from(void *buffer, size_t length, IPEndPoint& rep);
 
 			const EndPoint *remote_endpoint() const {
 				return _remote_endpoint;
 			}
+
+			/**
+			 * The number of bytes sent and received through this socket's send and receive
+			 * operations.  These are only maintained when the library is built with SFD_METRICS.
+			 */
+			uint64_t bytes_sent() const { return _bytes_sent; }
+			uint64_t bytes_received() const { return _bytes_received; }
 			
 			bool debug() const;
 			void debug(bool enable);
@@ -65,8 +127,71 @@ namespace sfd {
 			void broadcast(bool enable);
 
 			void bind_to_device(const std::string& device_name);
+
+			void fast_open_connect(bool enable);
+			bool fast_open_accepted() const;
+
+			bool no_delay() const;
+			void no_delay(bool enable);
+
+			bool quick_ack() const;
+			void quick_ack(bool enable);
+
+			bool cork() const;
+			void cork(bool enable);
+
+			unsigned int not_sent_low_water() const;
+			void not_sent_low_water(unsigned int bytes);
+
+			unsigned int user_timeout() const;
+			void user_timeout(unsigned int milliseconds);
+
+			int send_buffer_size() const;
+			void send_buffer_size(int bytes);
+
+			int receive_buffer_size() const;
+			void receive_buffer_size(int bytes);
+
+			int priority() const;
+			void priority(int priority);
+
+			uint8_t type_of_service() const;
+			void type_of_service(uint8_t tos);
+
+			unsigned int busy_poll() const;
+			void busy_poll(unsigned int microseconds);
+
+			bool prefer_busy_poll() const;
+			void prefer_busy_poll(bool enable);
+
+			int incoming_cpu() const;
+			void incoming_cpu(int cpu);
+
+			void linger(bool enable, int seconds);
+
+			unsigned int receive_timeout() const;
+			void receive_timeout(unsigned int milliseconds);
+
+			unsigned int send_timeout() const;
+			void send_timeout(unsigned int milliseconds);
+
+			uint64_t max_pacing_rate() const;
+			void max_pacing_rate(uint64_t bytes_per_sec);
+
+			void tune(const SocketTuning& tuning);
+
+			TcpInfo tcp_info() const;
+			size_t send_queue() const;
+			size_t receive_queue() const;
+
+			void enable_timestamping(TimestampingFlags::TimestampingFlags flags);
+			bool enable_device_timestamping(const std::string& device_name, bool transmit);
+			size_t recv_timestamped(void *buffer, size_t length, PacketTimestamps& timestamps);
+			bool recv_tx_timestamp(TxTimestamp& timestamp);
 			
 		protected:
+			Socket(FileDescriptor::NativeFD fd, AddressFamily::AddressFamily family, SocketType::SocketType type, ProtocolType::ProtocolType protocol, const EndPoint *rep);
+
 			void set_option_raw(int level, int setting, const void *value, size_t value_size);
 			void get_option_raw(int level, int setting, void *value, size_t *value_size) const;
 			
@@ -86,13 +211,39 @@ namespace sfd {
 				return value;
 			}
 
+			bool is_ip() const;
+			bool is_tcp() const;
+
 		private:
-			Socket(FileDescriptor::NativeFD fd, AddressFamily::AddressFamily family, SocketType::SocketType type, ProtocolType::ProtocolType protocol, const EndPoint *rep);
-						
 			AddressFamily::AddressFamily _family;
 			SocketType::SocketType _type;
 			ProtocolType::ProtocolType _protocol;
 			const EndPoint *_remote_endpoint;
+
+		protected:
+			inline void account_sent(ssize_t rc) {
+				SFD_TRACE_EVENT(WRITE, fd(), rc);
+#ifdef SFD_METRICS
+				if (rc > 0) {
+					_bytes_sent += rc;
+					SFD_METRIC_ADD(SOCKET_BYTES_OUT, rc);
+				}
+#endif
+			}
+
+			inline void account_received(ssize_t rc) {
+				SFD_TRACE_EVENT(READ, fd(), rc);
+#ifdef SFD_METRICS
+				if (rc > 0) {
+					_bytes_received += rc;
+					SFD_METRIC_ADD(SOCKET_BYTES_IN, rc);
+				}
+#endif
+			}
+
+		private:
+			uint64_t _bytes_sent;
+			uint64_t _bytes_received;
 		};
 
 		class SocketException : public Exception {
@@ -110,6 +261,28 @@ namespace sfd {
 			IPSocket(SocketType::SocketType type, ProtocolType::ProtocolType protocol);
 			
 			void multicast_loopback(bool enable);
+
+			void join_group(const IPAddress& group, const IPAddress& interface = IPAddress::any());
+			void leave_group(const IPAddress& group, const IPAddress& interface = IPAddress::any());
+
+			void join_source_group(const IPAddress& group, const IPAddress& source, const IPAddress& interface = IPAddress::any());
+			void leave_source_group(const IPAddress& group, const IPAddress& source, const IPAddress& interface = IPAddress::any());
+		};
+
+		class UnixSocket : public Socket {
+		public:
+			UnixSocket(SocketType::SocketType type);
+
+			UnixSocket *accept();
+			static void pair(SocketType::SocketType type, UnixSocket *& first, UnixSocket *& second);
+
+			size_t send_with_fds(const void *message, size_t length, const std::vector<FileDescriptor::NativeFD>& fds);
+			size_t recv_with_fds(void *buffer, size_t length, std::vector<FileDescriptor::NativeFD>& fds);
+
+		private:
+			UnixSocket(FileDescriptor::NativeFD fd, SocketType::SocketType type);
+
+			static const unsigned int MaxFDsPerMessage = 64;
 		};
 	}
 }
@@ -0,0 +1,79 @@
+/**
+ * inc/sfd/net/splice-proxy.h
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <sfd/pipe.h>
+#include <sfd/epoll.h>
+#include <sfd/net/socket.h>
+#include <cstdint>
+
+namespace sfd {
+	namespace net {
+
+		/**
+		 * Relays a stream between two connected sockets in both directions, by splicing
+		 * socket -> pipe -> socket, so that the relayed bytes never enter userspace.  The
+		 * proxy is driven by edge-triggered readiness events from an Epoll instance.
+		 */
+		class SpliceProxy {
+		public:
+			SpliceProxy(Socket& a, Socket& b, size_t pipe_capacity = 0);
+
+			void attach(Epoll& epoll);
+			void detach(Epoll& epoll);
+
+			bool handle(const EpollEvent& event);
+			void pump();
+
+			bool finished() const {
+				return _a_to_b.finished() && _b_to_a.finished();
+			}
+
+			uint64_t a_to_b_bytes() const { return _a_to_b.bytes; }
+			uint64_t b_to_a_bytes() const { return _b_to_a.bytes; }
+
+		private:
+			struct Direction {
+				Direction(Socket& source, Socket& destination);
+
+				bool pump(size_t capacity);
+
+				bool finished() const {
+					return source_closed && buffered == 0;
+				}
+
+				Socket& source;
+				Socket& destination;
+				Pipe pipe;
+
+				size_t buffered;
+				uint64_t bytes;
+				bool source_closed;
+				bool destination_shut;
+			};
+
+			Socket& _a;
+			Socket& _b;
+
+			Direction _a_to_b;
+			Direction _b_to_a;
+			size_t _capacity;
+		};
+	}
+}
@@ -0,0 +1,108 @@
+/**
+ * inc/sfd/net/tcp-info-sampler.h
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <sfd/epoll.h>
+#include <sfd/timer.h>
+#include <sfd/metrics.h>
+#include <sfd/net/socket.h>
+#include <sfd/exception.h>
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace sfd {
+	namespace net {
+
+		/**
+		 * The aggregate health of the sampled connections, taken by TcpInfoSampler::health().
+		 * The histograms hold one value per connection per sample; the totals are the growth of
+		 * the corresponding cumulative TCP_INFO counters between samples, summed over every
+		 * connection.
+		 */
+		struct TcpHealth {
+			uint64_t timestamp_ns;
+			unsigned int connections;
+			uint64_t samples;
+			uint64_t failed_samples;
+
+			metrics::LatencyHistogram rtt_us;
+			metrics::LatencyHistogram rtt_variance_us;
+			metrics::LatencyHistogram congestion_window;
+			metrics::LatencyHistogram delivery_rate;
+			metrics::LatencyHistogram send_queue;
+			metrics::LatencyHistogram receive_queue;
+
+			uint64_t retransmits;
+			uint64_t busy_time_us;
+			uint64_t rwnd_limited_us;
+			uint64_t sndbuf_limited_us;
+
+			std::string to_string() const;
+		};
+
+		/**
+		 * Periodically samples TCP_INFO and the queue depths of a set of connections, and
+		 * aggregates the results.  Comparing RTT and the rwnd/sndbuf-limited time against the
+		 * application's own handler latencies shows whether slow requests are spent in the
+		 * network or in the application.  The sampler is driven by a timerfd registered with
+		 * an Epoll instance.
+		 */
+		class TcpInfoSampler {
+		public:
+			TcpInfoSampler(uint64_t interval_ns = 100000000ull);
+
+			void interval(uint64_t interval_ns);
+			uint64_t interval() const { return _interval_ns; }
+
+			void add(Socket& socket);
+			void remove(Socket& socket);
+
+			void attach(Epoll& epoll);
+			void detach(Epoll& epoll);
+
+			bool handle(const EpollEvent& event);
+			void sample();
+
+			const TcpInfo *latest(const Socket& socket) const;
+
+			TcpHealth health() const { return _health; }
+			void reset();
+
+		private:
+			struct Connection {
+				TcpInfo last;
+				bool sampled;
+			};
+
+			Timer _timer;
+			uint64_t _interval_ns;
+
+			std::map<Socket *, Connection> _connections;
+			TcpHealth _health;
+		};
+
+		class TcpInfoSamplerException : public Exception {
+		public:
+
+			TcpInfoSamplerException(const std::string& msg) : Exception(msg) {
+			}
+		};
+	}
+}
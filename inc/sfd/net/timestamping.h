@@ -0,0 +1,103 @@
+/**
+ * inc/sfd/net/timestamping.h
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <sfd/metrics.h>
+#include <cstdint>
+
+namespace sfd {
+	namespace net {
+		namespace TimestampingFlags {
+
+			enum TimestampingFlags {
+				NONE = 0,
+
+				/**
+				 * Timestamp packets in software as they are received by the kernel.
+				 */
+				SOFTWARE_RX = 1,
+
+				/**
+				 * Timestamp packets in software as they leave the kernel, and report the
+				 * timestamps on the socket's error queue.
+				 */
+				SOFTWARE_TX = 2,
+
+				/**
+				 * Timestamp packets in the network interface, where the device supports it and
+				 * hardware timestamping has been enabled on it (see Socket::enable_device_timestamping).
+				 */
+				HARDWARE_RX = 4,
+				HARDWARE_TX = 8
+			};
+
+			static inline TimestampingFlags operator|(const TimestampingFlags& l, const TimestampingFlags& r) {
+				return (TimestampingFlags) ((unsigned long) l | (unsigned long) r);
+			}
+		}
+
+		namespace TxTimestampType {
+
+			enum TxTimestampType {
+				SENT = 0,
+				SCHEDULED = 1,
+				ACKNOWLEDGED = 2
+			};
+		}
+
+		/**
+		 * The kernel timestamps of a received packet, in nanoseconds since the epoch
+		 * (CLOCK_REALTIME for software timestamps, the device clock for hardware timestamps).
+		 * A timestamp that was not reported is zero.
+		 */
+		struct PacketTimestamps {
+			uint64_t software_ns;
+			uint64_t hardware_ns;
+		};
+
+		/**
+		 * A transmit timestamp, read from a socket's error queue.  The id counts the packets
+		 * sent since timestamping was enabled (for datagram sockets) or the bytes sent (for
+		 * stream sockets), and identifies which send this timestamp belongs to.
+		 */
+		struct TxTimestamp {
+			uint32_t id;
+			TxTimestampType::TxTimestampType type;
+			PacketTimestamps timestamps;
+		};
+
+		/**
+		 * Records the time from the kernel receiving a packet to the application processing it.
+		 * Recording when a packet is dequeued from an application queue, rather than when it is
+		 * read from the socket, includes the time it spent in that queue.
+		 */
+		class KernelLatency {
+		public:
+			bool record(const PacketTimestamps& timestamps);
+			void reset() { _histogram.reset(); }
+
+			const metrics::LatencyHistogram& histogram() const { return _histogram; }
+
+			static uint64_t realtime_now();
+
+		private:
+			metrics::LatencyHistogram _histogram;
+		};
+	}
+}
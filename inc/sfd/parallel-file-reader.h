@@ -0,0 +1,119 @@
+/**
+ * inc/sfd/parallel-file-reader.h
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <sfd/regular-file.h>
+#include <sfd/exception.h>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sfd {
+
+	/**
+	 * Describes a chunk of a file delivered by a ParallelFileReader.  The data remains valid
+	 * until the next call to ParallelFileReader::next.
+	 */
+	struct FileChunk {
+		uint64_t offset;
+		const char *data;
+		size_t size;
+	};
+
+	/**
+	 * Describes the progress of a ParallelFileReader.
+	 */
+	struct ParallelReadStatistics {
+		uint64_t bytes_read;
+		uint64_t chunks_delivered;
+		uint64_t elapsed_ns;
+
+		// Time workers spent waiting for the consumer to free a slot in the prefetch window,
+		// and time the consumer spent waiting for the next chunk to arrive.
+		uint64_t worker_stall_ns;
+		uint64_t consumer_stall_ns;
+
+		double throughput() const {
+			return elapsed_ns ? (double)bytes_read * 1e9 / (double)elapsed_ns : 0;
+		}
+	};
+
+	/**
+	 * Reads a file with several worker threads, and delivers it to a single consumer as a
+	 * sequence of in-order chunks.  Workers fetch chunks with pread into a bounded prefetch
+	 * window; when the window is full (because the consumer has fallen behind) they wait,
+	 * so memory use is bounded by window * chunk_size.
+	 */
+	class ParallelFileReader {
+	public:
+		ParallelFileReader(RegularFile& file, size_t chunk_size = 4 * 1024 * 1024, unsigned int workers = 4, unsigned int window = 16);
+		~ParallelFileReader();
+
+		ParallelFileReader(const ParallelFileReader&) = delete;
+		ParallelFileReader& operator=(const ParallelFileReader&) = delete;
+
+		bool next(FileChunk& chunk);
+
+		ParallelReadStatistics statistics() const;
+
+	private:
+		struct Slot {
+			std::vector<char> buffer;
+			size_t size;
+			bool ready;
+		};
+
+		void worker();
+		bool read_chunk(uint64_t index, Slot& slot);
+		uint64_t now() const;
+
+		RegularFile& _file;
+		uint64_t _file_size;
+		size_t _chunk_size;
+		uint64_t _total_chunks;
+
+		std::vector<Slot> _slots;
+		std::vector<std::thread> _workers;
+
+		mutable std::mutex _lock;
+		std::condition_variable _slot_freed;
+		std::condition_variable _chunk_ready;
+
+		uint64_t _next_fetch;
+		uint64_t _next_deliver;
+		uint64_t _released;
+		bool _holding;
+		bool _stop;
+		bool _error;
+
+		uint64_t _start_time;
+		uint64_t _bytes_read;
+		uint64_t _worker_stall;
+		uint64_t _consumer_stall;
+	};
+
+	class ParallelFileReaderException : public Exception {
+	public:
+
+		ParallelFileReaderException(const std::string& msg) : Exception(msg) {
+		}
+	};
+}
@@ -0,0 +1,90 @@
+/**
+ * inc/sfd/pipe.h
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <sfd/fd.h>
+#include <sfd/exception.h>
+#include <utility>
+
+namespace sfd {
+	namespace SpliceFlags {
+
+		enum SpliceFlags {
+			NONE = 0x00,
+			MOVE = 0x01,
+			NON_BLOCK = 0x02,
+			MORE = 0x04
+		};
+
+		static inline SpliceFlags operator|(const SpliceFlags& l, const SpliceFlags& r) {
+			return (SpliceFlags) ((unsigned long) l | (unsigned long) r);
+		}
+	}
+
+	class Pipe;
+
+	/**
+	 * Represents one end of a managed pipe.
+	 */
+	class PipeEnd : public FileDescriptor {
+		friend class Pipe;
+
+	private:
+		PipeEnd(NativeFD fd) : FileDescriptor(fd) {
+		}
+	};
+
+	/**
+	 * Represents a managed pipe, i.e. a connected pair of file descriptors.  Data written
+	 * to the write end can be read from the read end, and can be moved in and out of
+	 * the pipe without passing through userspace, by splicing.
+	 */
+	class Pipe {
+	public:
+		Pipe(bool non_blocking = false);
+
+		PipeEnd& read_end() { return _read_end; }
+		PipeEnd& write_end() { return _write_end; }
+
+		size_t capacity() const;
+		void capacity(size_t size);
+
+		size_t available() const;
+
+		int splice_in(FileDescriptor& source, size_t length, SpliceFlags::SpliceFlags flags = SpliceFlags::MOVE);
+		int splice_out(FileDescriptor& destination, size_t length, SpliceFlags::SpliceFlags flags = SpliceFlags::MOVE);
+		int tee(Pipe& destination, size_t length, SpliceFlags::SpliceFlags flags = SpliceFlags::NONE);
+
+	private:
+		Pipe(const std::pair<FileDescriptor::NativeFD, FileDescriptor::NativeFD>& fds);
+
+		static std::pair<FileDescriptor::NativeFD, FileDescriptor::NativeFD> create_pipe(bool non_blocking);
+		static unsigned int sfd_flags_to_native_flags(SpliceFlags::SpliceFlags flags);
+
+		PipeEnd _read_end;
+		PipeEnd _write_end;
+	};
+
+	class PipeException : public Exception {
+	public:
+
+		PipeException(const std::string& msg) : Exception(msg) {
+		}
+	};
+}
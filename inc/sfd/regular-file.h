@@ -20,6 +20,8 @@
 
 #include <sfd/fd.h>
 #include <sfd/exception.h>
+#include <cstdint>
+#include <functional>
 
 namespace sfd {
 	namespace FileOpenMode {
@@ -37,15 +39,46 @@ namespace sfd {
 		}
 	}
 
+	namespace FileCopyMethod {
+		enum FileCopyMethod {
+			REFLINK,
+			COPY_FILE_RANGE,
+			BUFFERED
+		};
+	}
+
+	/**
+	 * Describes the outcome of a file copy.
+	 */
+	struct FileCopyResult {
+		uint64_t bytes_copied;
+		FileCopyMethod::FileCopyMethod method;
+	};
+
+	/**
+	 * Invoked as a copy proceeds, with the number of bytes copied so far and the total
+	 * number of bytes to copy.
+	 */
+	typedef std::function<void (uint64_t copied, uint64_t total)> FileCopyProgress;
+
 	/**
 	 * Represents a managed regular file object.
 	 */
 	class RegularFile : public FileDescriptor {
 	public:
 		RegularFile(const std::string& filename, FileOpenMode::FileOpenMode mode);
-		
+
+		uint64_t size() const;
+
+		FileCopyResult copy_to(RegularFile& destination, const FileCopyProgress& progress = nullptr);
+		FileCopyResult copy_range_to(RegularFile& destination, uint64_t source_offset, uint64_t destination_offset, uint64_t length, const FileCopyProgress& progress = nullptr);
+
 	private:
 		static int sfd_mode_to_native_mode(FileOpenMode::FileOpenMode mode);
+
+		bool reflink_range_to(RegularFile& destination, uint64_t source_offset, uint64_t destination_offset, uint64_t length, bool whole_file);
+		bool copy_file_range_to(RegularFile& destination, uint64_t& source_offset, uint64_t& destination_offset, uint64_t length, uint64_t& copied, const FileCopyProgress& progress);
+		void buffered_copy_to(RegularFile& destination, uint64_t source_offset, uint64_t destination_offset, uint64_t length, uint64_t& copied, const FileCopyProgress& progress);
 	};
 
 	class RegularFileException : public Exception {
@@ -0,0 +1,60 @@
+/**
+ * inc/sfd/shared-memory.h
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <sfd/fd.h>
+#include <sfd/exception.h>
+#include <string>
+
+namespace sfd {
+
+	/**
+	 * Represents a managed, anonymous shared memory object (a memfd), mapped into the address
+	 * space of this process.  The object can be shared with another process by passing its file
+	 * descriptor, e.g. with UnixSocket::send_with_fds, and mapping it there with adopt.
+	 */
+	class SharedMemory : public FileDescriptor {
+	public:
+		SharedMemory(const std::string& name, size_t size);
+		~SharedMemory();
+
+		SharedMemory(const SharedMemory&) = delete;
+		SharedMemory& operator=(const SharedMemory&) = delete;
+
+		static SharedMemory *adopt(FileDescriptor::NativeFD fd);
+
+		void *address() const { return _address; }
+		size_t size() const { return _size; }
+
+	private:
+		SharedMemory(FileDescriptor::NativeFD fd);
+
+		void map();
+
+		void *_address;
+		size_t _size;
+	};
+
+	class SharedMemoryException : public Exception {
+	public:
+
+		SharedMemoryException(const std::string& msg) : Exception(msg) {
+		}
+	};
+}
@@ -33,6 +33,8 @@ namespace sfd {
 			QUIT = 3,
 			FPE = 8,
 			KILL = 9,
+			USR1 = 10,
+			USR2 = 12,
 			ALRM = 14,
 			TERM = 15,
 		};
@@ -47,6 +49,8 @@ namespace sfd {
 		
 		Signal(const SignalSet& signals);
 		virtual ~Signal();
+
+		int acknowledge();
 		
 	private:
 		static int create_signalfd(const SignalSet& signals);
@@ -0,0 +1,119 @@
+/**
+ * inc/sfd/tee-fan-out.h
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <sfd/fd.h>
+#include <sfd/pipe.h>
+#include <sfd/epoll.h>
+#include <sfd/regular-file.h>
+#include <sfd/exception.h>
+#include <cstdint>
+#include <vector>
+
+namespace sfd {
+	namespace FanOutPolicy {
+
+		enum FanOutPolicy {
+			/**
+			 * Data that does not fit into the sink's pipe is discarded for that sink only.
+			 * Suitable for consumers that tolerate gaps, such as packet captures.
+			 */
+			Drop,
+
+			/**
+			 * A sink that cannot keep up is disconnected, and receives no further data.
+			 */
+			Disconnect
+		};
+	}
+
+	/**
+	 * Replicates a single inbound stream to several sinks.  Each chunk read from the source is
+	 * spliced into an input pipe, duplicated with tee() into a per-sink pipe, and spliced from
+	 * there into the sink.  Each sink's pipe absorbs that sink's backpressure, so a slow sink
+	 * does not stall the others; a sink whose pipe overflows is handled according to its policy.
+	 */
+	class TeeFanOut {
+	public:
+		typedef unsigned int SinkID;
+
+		static const size_t DefaultSinkChunks = 4;
+
+		TeeFanOut(FileDescriptor& source, size_t chunk_size = 65536);
+		~TeeFanOut();
+
+		SinkID add_sink(FileDescriptor& sink, FanOutPolicy::FanOutPolicy policy, size_t pipe_capacity = 0);
+
+		void attach(Epoll& epoll);
+		void detach(Epoll& epoll);
+
+		bool handle(const EpollEvent& event);
+		void pump();
+
+		bool finished() const;
+
+		uint64_t received_bytes() const { return _received; }
+
+		bool connected(SinkID sink) const { return _sinks.at(sink)->connected; }
+		uint64_t delivered_bytes(SinkID sink) const { return _sinks.at(sink)->delivered; }
+		uint64_t dropped_bytes(SinkID sink) const { return _sinks.at(sink)->dropped; }
+
+	private:
+		struct Sink {
+			Sink(FileDescriptor& fd, FanOutPolicy::FanOutPolicy policy);
+
+			FileDescriptor& fd;
+			FanOutPolicy::FanOutPolicy policy;
+			Pipe pipe;
+
+			size_t capacity;
+			size_t buffered;
+			uint64_t delivered;
+			uint64_t dropped;
+			bool connected;
+		};
+
+		bool fill();
+		void distribute(size_t length);
+		bool drain(Sink& sink);
+		void overflow(Sink& sink, size_t length);
+		void disconnect(Sink& sink);
+		void watch(Sink& sink);
+
+		FileDescriptor& _source;
+		size_t _chunk_size;
+		bool _source_closed;
+		bool _source_spliceable;
+
+		Pipe _input;
+		RegularFile _discard;
+		std::vector<char> _copy_buffer;
+		std::vector<Sink *> _sinks;
+		Epoll *_epoll;
+
+		uint64_t _received;
+	};
+
+	class TeeFanOutException : public Exception {
+	public:
+
+		TeeFanOutException(const std::string& msg) : Exception(msg) {
+		}
+	};
+}
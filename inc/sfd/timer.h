@@ -0,0 +1,47 @@
+/**
+ * inc/sfd/timer.h
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <sfd/fd.h>
+#include <sfd/exception.h>
+#include <cstdint>
+
+namespace sfd {
+
+	/**
+	 * Represents a managed timerfd object, on the monotonic clock.  The timer becomes readable
+	 * when it expires, and is created in non-blocking mode.
+	 */
+	class Timer : public FileDescriptor {
+	public:
+		Timer();
+
+		void arm(uint64_t initial_ns, uint64_t interval_ns = 0);
+		void disarm();
+
+		uint64_t acknowledge();
+	};
+
+	class TimerException : public Exception {
+	public:
+
+		TimerException(const std::string& msg) : Exception(msg) {
+		}
+	};
+}
@@ -0,0 +1,180 @@
+/**
+ * inc/sfd/trace.h
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <sfd/fd.h>
+#include <sfd/signal.h>
+#include <sfd/epoll.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+# include <x86intrin.h>
+#endif
+
+#if defined(SFD_TRACE) && defined(__has_include)
+# if __has_include(<sys/sdt.h>)
+#  include <sys/sdt.h>
+#  define SFD_HAVE_USDT
+# endif
+#endif
+
+namespace sfd {
+	namespace trace {
+		namespace TraceEventType {
+
+			enum TraceEventType {
+				EPOLL_WAKE = 1,
+				FD_READY = 2,
+				HANDLER_START = 3,
+				HANDLER_END = 4,
+				ACCEPT = 5,
+				CONNECT = 6,
+				READ = 7,
+				WRITE = 8
+			};
+		}
+
+		namespace TraceClock {
+
+			enum TraceClock {
+				MONOTONIC = 0,
+				TSC = 1
+			};
+		}
+
+		/**
+		 * A single trace record.  The meaning of the argument depends on the event type: for
+		 * EPOLL_WAKE it is the number of ready events, for FD_READY the epoll event mask, for
+		 * ACCEPT the accepted file descriptor, for CONNECT the result, and for READ and WRITE
+		 * the result (i.e. the byte count, or -1).
+		 */
+		struct TraceRecord {
+			uint64_t timestamp;
+			int64_t argument;
+			int32_t fd;
+			uint16_t type;
+			uint16_t reserved;
+		};
+
+		/**
+		 * The layout of a trace dump: this header, followed by thread_count blocks, each of which
+		 * is a TraceThreadHeader followed by record_count records, oldest first.  Timestamps are
+		 * in the units of the clock; for the TSC, the two calibration points relate TSC values to
+		 * CLOCK_MONOTONIC nanoseconds.
+		 */
+		struct TraceFileHeader {
+			char magic[8];
+			uint32_t version;
+			uint32_t clock;
+			uint64_t calibration_ticks[2];
+			uint64_t calibration_ns[2];
+			uint32_t thread_count;
+			uint32_t record_size;
+		};
+
+		struct TraceThreadHeader {
+			uint64_t thread_id;
+			uint64_t record_count;
+		};
+
+		static const char TraceMagic[8] = { 'S', 'F', 'D', 'T', 'R', 'A', 'C', 'E' };
+		static const uint32_t TraceVersion = 1;
+
+		/**
+		 * A per-thread ring of trace records.  Only the owning thread writes to the ring; a dump
+		 * from another thread copies it without stopping the writer, so the few records being
+		 * overwritten during the copy may be torn.
+		 */
+		struct TraceRing {
+			std::atomic<uint64_t> head;
+			uint64_t mask;
+			TraceRecord *records;
+			uint64_t thread_id;
+		};
+
+		bool enabled();
+		void configure(size_t records_per_thread);
+
+		TraceRing& thread_ring();
+		void dump(FileDescriptor& out);
+
+		static inline TraceClock::TraceClock clock() {
+#if defined(__x86_64__) || defined(__i386__)
+			return TraceClock::TSC;
+#else
+			return TraceClock::MONOTONIC;
+#endif
+		}
+
+		static inline uint64_t timestamp() {
+#if defined(__x86_64__) || defined(__i386__)
+			return __rdtsc();
+#else
+			struct timespec ts;
+			::clock_gettime(CLOCK_MONOTONIC, &ts);
+			return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+		}
+
+		static inline void record(TraceEventType::TraceEventType type, int fd, int64_t argument) {
+			TraceRing& ring = thread_ring();
+			uint64_t position = ring.head.load(std::memory_order_relaxed);
+
+			TraceRecord& r = ring.records[position & ring.mask];
+			r.timestamp = timestamp();
+			r.argument = argument;
+			r.fd = fd;
+			r.type = (uint16_t)type;
+
+			ring.head.store(position + 1, std::memory_order_release);
+		}
+
+		/**
+		 * A signalfd that dumps the trace rings of every thread to a new file when the given
+		 * signal arrives.  Register it with Epoll, and pass its events to handle.
+		 */
+		class TraceDumpSignal : public Signal {
+		public:
+			TraceDumpSignal(const std::string& path_prefix, Signals::Signals signal = Signals::USR2);
+
+			bool handle(const EpollEvent& event);
+			std::string dump_now();
+
+		private:
+			std::string _path_prefix;
+			unsigned int _sequence;
+		};
+	}
+}
+
+#ifdef SFD_TRACE
+# ifdef SFD_HAVE_USDT
+#  define SFD_TRACE_EVENT(type, fd, argument) do { \
+		::sfd::trace::record(::sfd::trace::TraceEventType::type, (fd), (argument)); \
+		STAP_PROBE2(sfd, type, (fd), (argument)); \
+	} while (0)
+# else
+#  define SFD_TRACE_EVENT(type, fd, argument) ::sfd::trace::record(::sfd::trace::TraceEventType::type, (fd), (argument))
+# endif
+#else
+# define SFD_TRACE_EVENT(type, fd, argument) do { } while (0)
+#endif
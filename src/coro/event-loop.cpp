@@ -0,0 +1,490 @@
+/**
+ * src/coro/event-loop.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/coro/event-loop.h>
+#include <sfd/metrics.h>
+
+#include <algorithm>
+#include <functional>
+#include <sys/socket.h>
+
+using namespace sfd;
+using namespace sfd::coro;
+using namespace sfd::net;
+
+/**
+ * Creates a new event loop, with no coroutines.
+ */
+EventLoop::EventLoop() : _poller(_epoll, 0), _socket_busy_poll_us(0), _sleeper_sequence(0), _timer_deadline(0), _active(0), _stopping(false)
+{
+	_epoll.add(&_timer, EpollEventType::IN);
+}
+
+/**
+ * Destroys the event loop.  Coroutines that are still suspended in the loop are not resumed,
+ * and their frames are not released.
+ */
+EventLoop::~EventLoop()
+{
+}
+
+/**
+ * Schedules a task to run on the loop.  The loop owns the task from now on, and releases it
+ * when it finishes.  An exception escaping from the task terminates the program.
+ * @param task The task to run.
+ */
+void EventLoop::spawn(Task<void>&& task)
+{
+	Task<void>::Handle handle = task.release();
+
+	handle.promise().detach(this);
+	_active++;
+
+	schedule(handle);
+}
+
+/**
+ * Runs the loop until every spawned task has finished, or stop is called.
+ */
+void EventLoop::run()
+{
+	std::vector<EpollEvent> events;
+
+	_stopping = false;
+
+	for (;;) {
+		run_ready();
+
+		if (_stopping || _active == 0) {
+			return;
+		}
+
+		events.clear();
+		if (!_poller.wait(events, 256, -1)) {
+			throw EventLoopException("Error whilst waiting for events");
+		}
+
+		for (const EpollEvent& event : events) {
+			if (event.fd == &_timer) {
+				_timer.acknowledge();
+				_timer_deadline = 0;
+				expire_sleepers();
+				continue;
+			}
+
+			FileState& state = _files[event.fd->fd()];
+
+			bool readable = event.in() || event.err() || event.hup() || event.rdhup();
+			bool writable = event.out() || event.err() || event.hup();
+
+			// Complete the operations that the readiness allows.  The coroutines are resumed
+			// after every event has been processed, so that resuming one cannot disturb the
+			// state of another descriptor mid-dispatch.
+			if (readable && state.reader && state.reader->attempt(state.reader)) {
+				schedule(state.reader->handle);
+				state.reader = nullptr;
+			}
+
+			if (writable && state.writer && state.writer->attempt(state.writer)) {
+				schedule(state.writer->handle);
+				state.writer = nullptr;
+			}
+
+			// The registration is one-shot, so re-arm it for any operation that was not able
+			// to complete.
+			if (state.reader || state.writer) {
+				arm(state);
+			}
+		}
+	}
+}
+
+/**
+ * Makes run return once the coroutines that are currently runnable have been resumed.
+ */
+void EventLoop::stop()
+{
+	_stopping = true;
+}
+
+/**
+ * Makes the loop spin for up to budget_ns waiting for readiness before sleeping, for loops
+ * that have a core to themselves.  While a budget is set, every socket the loop waits on is
+ * also asked to busy-poll its device queue in the kernel (see BusyPoller::enable).
+ * @param budget_ns How long each wait spins, or zero (the default) to always sleep.
+ * @param socket_busy_poll_us How long the kernel may spin on each socket's device queue.
+ */
+void EventLoop::busy_poll(uint64_t budget_ns, unsigned int socket_busy_poll_us)
+{
+	_poller.budget(budget_ns);
+	_socket_busy_poll_us = budget_ns ? socket_busy_poll_us : 0;
+
+	if (_socket_busy_poll_us) {
+		for (FileState& state : _files) {
+			if (state.owner) {
+				net::BusyPoller::enable(*state.owner, _socket_busy_poll_us);
+			}
+		}
+	}
+}
+
+/**
+ * Removes a file descriptor from the loop.  This must be called before destroying a file
+ * descriptor that has been awaited on, and must not be called while a coroutine is waiting
+ * on it.
+ * @param fd The file descriptor to remove.
+ */
+void EventLoop::forget(FileDescriptor& fd)
+{
+	if ((size_t)fd.fd() >= _files.size()) {
+		return;
+	}
+
+	FileState& state = _files[fd.fd()];
+	if (state.owner != &fd) {
+		return;
+	}
+
+	if (state.registered) {
+		try {
+			_epoll.remove(&fd);
+		} catch (const EpollException&) {
+		}
+	}
+
+	state.owner = nullptr;
+	state.reader = nullptr;
+	state.writer = nullptr;
+	state.registered = false;
+}
+
+/**
+ * Looks up the state of a file descriptor, taking ownership of the slot if the descriptor has
+ * not been seen before.
+ */
+EventLoop::FileState& EventLoop::prepare(FileDescriptor& fd)
+{
+	size_t index = (size_t)fd.fd();
+
+	if (index >= _files.size()) {
+		_files.resize(std::max(index + 1, _files.size() * 2), FileState { nullptr, nullptr, nullptr, false });
+	}
+
+	FileState& state = _files[index];
+
+	if (state.owner != &fd) {
+		// The slot may still be registered for a previous descriptor with the same number
+		// (if that was closed without forget), which arm copes with.
+		fd.non_blocking(true);
+
+		if (_socket_busy_poll_us) {
+			net::BusyPoller::enable(fd, _socket_busy_poll_us);
+		}
+
+		state.owner = &fd;
+		state.reader = nullptr;
+		state.writer = nullptr;
+	}
+
+	return state;
+}
+
+void EventLoop::wait_readable(IoWait& wait)
+{
+	FileState& state = prepare(*wait.fd);
+
+	if (state.reader) {
+		throw EventLoopException("A coroutine is already reading from this file descriptor");
+	}
+
+	state.reader = &wait;
+	arm(state);
+}
+
+void EventLoop::wait_writable(IoWait& wait)
+{
+	FileState& state = prepare(*wait.fd);
+
+	if (state.writer) {
+		throw EventLoopException("A coroutine is already writing to this file descriptor");
+	}
+
+	state.writer = &wait;
+	arm(state);
+}
+
+/**
+ * Registers interest in the events that the waiting coroutines of a file descriptor need.
+ */
+void EventLoop::arm(FileState& state)
+{
+	EpollEventType::EpollEventType events = EpollEventType::ONESHOT | EpollEventType::RDHUP;
+
+	if (state.reader) {
+		events = events | EpollEventType::IN;
+	}
+
+	if (state.writer) {
+		events = events | EpollEventType::OUT;
+	}
+
+	// Descriptors closed without forget() leave stale registrations behind, in which case the
+	// first choice of add or modify fails, and the other succeeds.
+	if (state.registered) {
+		try {
+			_epoll.modify(state.owner, events);
+		} catch (const EpollException&) {
+			_epoll.add(state.owner, events);
+		}
+	} else {
+		try {
+			_epoll.add(state.owner, events);
+		} catch (const EpollException&) {
+			_epoll.modify(state.owner, events);
+		}
+
+		state.registered = true;
+	}
+}
+
+void EventLoop::sleep_until(uint64_t deadline, std::coroutine_handle<> handle)
+{
+	_sleepers.push_back(Sleeper { deadline, _sleeper_sequence++, handle });
+	std::push_heap(_sleepers.begin(), _sleepers.end(), std::greater<Sleeper>());
+
+	if (_timer_deadline == 0 || deadline < _timer_deadline) {
+		uint64_t now = metrics::now();
+
+		_timer_deadline = deadline;
+		_timer.arm(deadline > now ? deadline - now : 1);
+	}
+}
+
+/**
+ * Schedules every sleeper whose deadline has passed, and re-arms the timer for the next.
+ */
+void EventLoop::expire_sleepers()
+{
+	uint64_t now = metrics::now();
+
+	while (!_sleepers.empty() && _sleepers.front().deadline <= now) {
+		std::pop_heap(_sleepers.begin(), _sleepers.end(), std::greater<Sleeper>());
+		schedule(_sleepers.back().handle);
+		_sleepers.pop_back();
+	}
+
+	if (!_sleepers.empty()) {
+		_timer_deadline = _sleepers.front().deadline;
+		_timer.arm(_timer_deadline - now);
+	}
+}
+
+/**
+ * Resumes the runnable coroutines, including any that become runnable as a result.
+ */
+void EventLoop::run_ready()
+{
+	while (!_ready.empty() && !_stopping) {
+		_running.swap(_ready);
+
+		for (std::coroutine_handle<> handle : _running) {
+			handle.resume();
+		}
+
+		_running.clear();
+	}
+}
+
+void EventLoop::task_finished()
+{
+	_active--;
+}
+
+void detail::PromiseBase::detached_finished() noexcept
+{
+	if (_exception) {
+		// Nothing is waiting for the task, so treat the exception like one escaping a thread.
+		std::rethrow_exception(_exception);
+	}
+
+	_loop->task_finished();
+}
+
+ReadAwaitable::ReadAwaitable(EventLoop& loop, FileDescriptor& fd, void *buffer, size_t size)
+	: IoWait { &loop, &fd, nullptr, try_read }, _buffer(buffer), _size(size), _result(0), _error(0)
+{
+	loop.prepare(fd);
+}
+
+void ReadAwaitable::await_suspend(std::coroutine_handle<> handle)
+{
+	this->handle = handle;
+	loop->wait_readable(*this);
+}
+
+bool ReadAwaitable::try_read(IoWait *wait)
+{
+	ReadAwaitable *self = static_cast<ReadAwaitable *>(wait);
+
+	int rc = self->fd->read_inline(self->_buffer, self->_size);
+	if (rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+		return false;
+	}
+
+	self->_result = rc;
+	self->_error = rc < 0 ? errno : 0;
+	return true;
+}
+
+WriteAwaitable::WriteAwaitable(EventLoop& loop, FileDescriptor& fd, const void *buffer, size_t size)
+	: IoWait { &loop, &fd, nullptr, try_write }, _buffer(buffer), _size(size), _result(0), _error(0)
+{
+	loop.prepare(fd);
+}
+
+void WriteAwaitable::await_suspend(std::coroutine_handle<> handle)
+{
+	this->handle = handle;
+	loop->wait_writable(*this);
+}
+
+bool WriteAwaitable::try_write(IoWait *wait)
+{
+	WriteAwaitable *self = static_cast<WriteAwaitable *>(wait);
+
+	int rc = self->fd->write_inline(self->_buffer, self->_size);
+	if (rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+		return false;
+	}
+
+	self->_result = rc;
+	self->_error = rc < 0 ? errno : 0;
+	return true;
+}
+
+AcceptAwaitable::AcceptAwaitable(EventLoop& loop, Socket& listener)
+	: IoWait { &loop, &listener, nullptr, try_accept }, _result(nullptr), _error(0)
+{
+	loop.prepare(listener);
+}
+
+void AcceptAwaitable::await_suspend(std::coroutine_handle<> handle)
+{
+	this->handle = handle;
+	loop->wait_readable(*this);
+}
+
+bool AcceptAwaitable::try_accept(IoWait *wait)
+{
+	AcceptAwaitable *self = static_cast<AcceptAwaitable *>(wait);
+
+	Socket *socket = static_cast<Socket *>(self->fd)->accept();
+	if (!socket && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+		return false;
+	}
+
+	self->_result = socket;
+	self->_error = socket ? 0 : errno;
+	return true;
+}
+
+ConnectAwaitable::ConnectAwaitable(EventLoop& loop, Socket& socket, const EndPoint& ep)
+	: IoWait { &loop, &socket, nullptr, try_connect }, _ep(ep), _started(false), _error(0)
+{
+	loop.prepare(socket);
+}
+
+void ConnectAwaitable::await_suspend(std::coroutine_handle<> handle)
+{
+	this->handle = handle;
+	loop->wait_writable(*this);
+}
+
+bool ConnectAwaitable::try_connect(IoWait *wait)
+{
+	ConnectAwaitable *self = static_cast<ConnectAwaitable *>(wait);
+	Socket *socket = static_cast<Socket *>(self->fd);
+
+	if (!self->_started) {
+		self->_started = true;
+
+		try {
+			if (!socket->begin_connect(self->_ep)) {
+				return false;
+			}
+
+			self->_error = 0;
+		} catch (const SocketException&) {
+			self->_error = errno ? errno : EINVAL;
+		}
+
+		return true;
+	}
+
+	// The connection attempt has finished once the socket becomes writable.
+	try {
+		self->_error = socket->finish_connect();
+	} catch (const SocketException&) {
+		self->_error = errno;
+	}
+
+	return true;
+}
+
+RecvFromAwaitable::RecvFromAwaitable(EventLoop& loop, Socket& socket, void *buffer, size_t size, const EndPoint **from)
+	: IoWait { &loop, &socket, nullptr, try_recv_from }, _buffer(buffer), _size(size), _from(from), _result(0), _error(0)
+{
+	loop.prepare(socket);
+}
+
+void RecvFromAwaitable::await_suspend(std::coroutine_handle<> handle)
+{
+	this->handle = handle;
+	loop->wait_readable(*this);
+}
+
+bool RecvFromAwaitable::try_recv_from(IoWait *wait)
+{
+	RecvFromAwaitable *self = static_cast<RecvFromAwaitable *>(wait);
+
+	struct sockaddr_storage sa;
+	socklen_t sa_len = sizeof(sa);
+
+	ssize_t rc = ::recvfrom(self->fd->fd(), self->_buffer, self->_size, 0, (struct sockaddr *)&sa, &sa_len);
+	if (rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+		return false;
+	}
+
+	self->_result = rc;
+	self->_error = rc < 0 ? errno : 0;
+
+	if (rc >= 0 && self->_from) {
+		*self->_from = EndPoint::from_sockaddr((struct sockaddr *)&sa);
+	}
+
+	return true;
+}
+
+void SleepAwaitable::await_suspend(std::coroutine_handle<> handle)
+{
+	if (_duration_ns == 0) {
+		_loop.schedule(handle);
+	} else {
+		_loop.sleep_until(metrics::now() + _duration_ns, handle);
+	}
+}
@@ -0,0 +1,118 @@
+/**
+ * src/coro/frame-pool.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/coro/frame-pool.h>
+
+#include <new>
+
+using namespace sfd::coro;
+
+namespace {
+	struct FreeFrame {
+		FreeFrame *next;
+	};
+
+	struct SizeClass {
+		FreeFrame *head;
+		size_t count;
+	};
+
+	const size_t SizeClasses = FramePool::MaxPooledSize / FramePool::FrameGranularity;
+
+	/**
+	 * The calling thread's cached frames.  The cache is released when the thread exits.
+	 */
+	struct FrameCache {
+		SizeClass classes[SizeClasses];
+
+		FrameCache() {
+			for (SizeClass& c : classes) {
+				c.head = nullptr;
+				c.count = 0;
+			}
+		}
+
+		~FrameCache() {
+			for (SizeClass& c : classes) {
+				while (c.head) {
+					FreeFrame *frame = c.head;
+					c.head = frame->next;
+					::operator delete(frame);
+				}
+			}
+		}
+	};
+
+	thread_local FrameCache cache;
+
+	inline size_t size_class(size_t size)
+	{
+		return (size + FramePool::FrameGranularity - 1) / FramePool::FrameGranularity - 1;
+	}
+}
+
+/**
+ * Allocates a coroutine frame.
+ * @param size The size of the frame, in bytes.
+ * @return The new frame.
+ */
+void *FramePool::allocate(size_t size)
+{
+	if (size == 0 || size > MaxPooledSize) {
+		return ::operator new(size);
+	}
+
+	size_t index = size_class(size);
+	SizeClass& c = cache.classes[index];
+
+	if (c.head) {
+		FreeFrame *frame = c.head;
+		c.head = frame->next;
+		c.count--;
+
+		return frame;
+	}
+
+	// Allocate the whole size class, so that the frame can be reused for any frame in it.
+	return ::operator new((index + 1) * FrameGranularity);
+}
+
+/**
+ * Releases a coroutine frame allocated by allocate.
+ * @param frame The frame to release.
+ * @param size The size the frame was allocated with.
+ */
+void FramePool::release(void *frame, size_t size)
+{
+	if (size == 0 || size > MaxPooledSize) {
+		::operator delete(frame);
+		return;
+	}
+
+	SizeClass& c = cache.classes[size_class(size)];
+
+	if (c.count >= MaxCachedFrames) {
+		::operator delete(frame);
+		return;
+	}
+
+	FreeFrame *free_frame = (FreeFrame *)frame;
+	free_frame->next = c.head;
+	c.head = free_frame;
+	c.count++;
+}
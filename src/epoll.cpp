@@ -17,6 +17,8 @@
  * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 #include <sfd/epoll.h>
+#include <sfd/metrics.h>
+#include <sfd/trace.h>
 #include <sys/epoll.h>
 
 using namespace sfd;
@@ -45,10 +47,32 @@ void Epoll::add(FileDescriptor* incoming_fd, EpollEventType::EpollEventType even
 	evt.events = (uint32_t)events;
 
 	// Add the fd to the epollfd.
-	if (epoll_ctl(fd(), EPOLL_CTL_ADD, incoming_fd->fd(), &evt) < 0)
+	int rc = epoll_ctl(fd(), EPOLL_CTL_ADD, incoming_fd->fd(), &evt);
+	SFD_METRIC_SYSCALL(EPOLL, rc);
+
+	if (rc < 0)
 		throw EpollException("unable to add file descriptor");
 }
 
+/**
+ * Changes the events associated with a file-descriptor on the epoll watch list.  This also
+ * re-arms a file-descriptor that was added with EpollEventType::ONESHOT.
+ * @param fd The file-descriptor to modify.  This must already be on the watch list.
+ * @param events The new events to associate with the file-descriptor.
+ */
+void Epoll::modify(FileDescriptor* incoming_fd, EpollEventType::EpollEventType events)
+{
+	struct epoll_event evt;
+	evt.data.ptr = incoming_fd;
+	evt.events = (uint32_t)events;
+
+	int rc = epoll_ctl(fd(), EPOLL_CTL_MOD, incoming_fd->fd(), &evt);
+	SFD_METRIC_SYSCALL(EPOLL, rc);
+
+	if (rc < 0)
+		throw EpollException("unable to modify file descriptor");
+}
+
 /**
  * Removes a file-descriptor from the epoll watch list
  * @param fd The file-descriptor to remove from the watch list.
@@ -56,7 +80,10 @@ void Epoll::add(FileDescriptor* incoming_fd, EpollEventType::EpollEventType even
 void Epoll::remove(FileDescriptor* incoming_fd)
 {
 	// Tell the epollfd to remove the given file-descriptor.
-	if (epoll_ctl(fd(), EPOLL_CTL_DEL, incoming_fd->fd(), NULL) < 0)
+	int rc = epoll_ctl(fd(), EPOLL_CTL_DEL, incoming_fd->fd(), NULL);
+	SFD_METRIC_SYSCALL(EPOLL, rc);
+
+	if (rc < 0)
 		throw EpollException("unable to remove file descriptor");
 }
 
@@ -75,9 +102,29 @@ bool Epoll::wait(std::vector<EpollEvent>& events, int max_events, int timeout)
 	// TODO: maybe malloc() these instead.
 	struct epoll_event evts[max_events];
 
+#ifdef SFD_METRICS
+	// The time since the last wait returned was spent dispatching events.
+	metrics::ThreadMetrics& m = metrics::thread_metrics();
+	uint64_t wait_start = metrics::now();
+	SFD_METRIC_ADD(EPOLL_BUSY_NS, wait_start - m.last_wake);
+#endif
+
 	// Wait for events to become ready.
 	int count = epoll_wait(fd(), evts, max_events, timeout);
 
+#ifdef SFD_METRICS
+	m.last_wake = metrics::now();
+	SFD_METRIC_ADD(EPOLL_IDLE_NS, m.last_wake - wait_start);
+	SFD_METRIC_ADD(EPOLL_WAITS, 1);
+	SFD_METRIC_SYSCALL(EPOLL, count);
+
+	if (count > 0) {
+		SFD_METRIC_ADD(EPOLL_EVENTS, count);
+	}
+#endif
+
+	SFD_TRACE_EVENT(EPOLL_WAKE, fd(), count);
+
 	// If there was an error, check to see if it was because it was interrupted,
 	// or if there was an ACTUAL error.
 	if (count < 0) {
@@ -90,6 +137,8 @@ bool Epoll::wait(std::vector<EpollEvent>& events, int max_events, int timeout)
 
 	// Enumerate over all the ready events, and populate the event list.
 	for (int i = 0; i < count; i++) {
+		SFD_TRACE_EVENT(FD_READY, ((FileDescriptor *)evts[i].data.ptr)->fd(), evts[i].events);
+
 		events.push_back({
 			(FileDescriptor *)evts[i].data.ptr,
 			(EpollEventType::EpollEventType)evts[i].events
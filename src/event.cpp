@@ -17,8 +17,10 @@
  * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 #include <sfd/event.h>
+#include <sfd/metrics.h>
 #include <sys/eventfd.h>
 #include <unistd.h>
+#include <errno.h>
 
 using namespace sfd;
 
@@ -32,11 +34,52 @@ Event::Event() : FileDescriptor(::eventfd(0, 0))
 	}
 }
 
+/**
+ * Takes ownership of an existing eventfd, e.g. one received from another process.
+ */
+Event::Event(FileDescriptor::NativeFD fd) : FileDescriptor(fd)
+{
+	if (!valid()) {
+		throw EventException("Invalid eventfd");
+	}
+}
+
+/**
+ * Wraps an existing eventfd in a managed eventfd object.
+ * @param fd The native file descriptor of the eventfd.  Ownership passes to the new object.
+ * @return A new managed eventfd object.
+ */
+Event* Event::adopt(FileDescriptor::NativeFD fd)
+{
+	return new Event(fd);
+}
+
 /**
  * Invokes the eventfd.
  */
 void Event::invoke()
 {
 	uint64_t v = 1;
-	write(&v, sizeof(v));
+	int rc = ::write(fd(), &v, sizeof(v));
+	SFD_METRIC_SYSCALL(EVENT, rc);
+}
+
+/**
+ * Acknowledges the eventfd, by reading and resetting its counter.  This blocks until the eventfd
+ * has been invoked, unless the eventfd is in non-blocking mode.
+ * @return The number of times the eventfd was invoked since it was last acknowledged, or zero
+ * if it has not been invoked and the eventfd is in non-blocking mode.
+ */
+uint64_t Event::acknowledge()
+{
+	uint64_t v;
+
+	int rc = ::read(fd(), &v, sizeof(v));
+	SFD_METRIC_SYSCALL(EVENT, rc);
+
+	if (rc != sizeof(v)) {
+		return 0;
+	}
+
+	return v;
 }
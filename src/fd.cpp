@@ -17,7 +17,11 @@
  * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 #include <sfd/fd.h>
+#include <sfd/metrics.h>
+#include <sfd/trace.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
 
 using namespace sfd;
 
@@ -46,25 +50,71 @@ FileDescriptor::FileDescriptor(int fd) : _fd(fd)
 }
 
 /**
- * Performs a read operation on the file descriptor.
+ * Performs a read operation on the file descriptor, recording it in the metrics and the trace
+ * ring in instrumented builds.
  * @param buffer The buffer to read into.
  * @param size The maximum size of the buffer.
  * @return The number of bytes read into the buffer.
  */
 int FileDescriptor::read(void* buffer, size_t size)
 {
-	return ::read(_fd, buffer, size);
+	int rc = ::read(_fd, buffer, size);
+	SFD_METRIC_SYSCALL(GENERIC, rc);
+	SFD_TRACE_EVENT(READ, _fd, rc);
+
+	return rc;
 }
 
 /**
- * Performs a write operation on the file descriptor.
+ * Performs a write operation on the file descriptor, recording it in the metrics and the
+ * trace ring in instrumented builds.
  * @param buffer The buffer to read from.
  * @param size The number of bytes in the buffer to write.
  * @return The number of bytes written.
  */
 int FileDescriptor::write(const void* buffer, size_t size)
 {
-	return ::write(_fd, buffer, size);
+	int rc = ::write(_fd, buffer, size);
+	SFD_METRIC_SYSCALL(GENERIC, rc);
+	SFD_TRACE_EVENT(WRITE, _fd, rc);
+
+	return rc;
+}
+
+/**
+ * Determines whether or not the file descriptor is in non-blocking mode.
+ * @return True if operations on the file descriptor will not block.
+ */
+bool FileDescriptor::non_blocking() const
+{
+	int flags = ::fcntl(_fd, F_GETFL);
+	if (flags < 0) {
+		throw FileDescriptorException("Unable to read file descriptor flags");
+	}
+
+	return (flags & O_NONBLOCK) != 0;
+}
+
+/**
+ * Places the file descriptor into, or takes it out of, non-blocking mode.
+ * @param enable Whether or not operations on the file descriptor should block.
+ */
+void FileDescriptor::non_blocking(bool enable)
+{
+	int flags = ::fcntl(_fd, F_GETFL);
+	if (flags < 0) {
+		throw FileDescriptorException("Unable to read file descriptor flags");
+	}
+
+	if (enable) {
+		flags |= O_NONBLOCK;
+	} else {
+		flags &= ~O_NONBLOCK;
+	}
+
+	if (::fcntl(_fd, F_SETFL, flags) < 0) {
+		throw FileDescriptorException("Unable to update file descriptor flags");
+	}
 }
 
 /**
@@ -0,0 +1,395 @@
+/**
+ * src/file-tailer.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/file-tailer.h>
+#include <sfd/metrics.h>
+
+#include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+
+using namespace sfd;
+
+/**
+ * Constructs a new file tailer.
+ * @param max_batch_size The maximum number of bytes handed out in a single batch.
+ */
+FileTailer::FileTailer(size_t max_batch_size) : _max_batch_size(max_batch_size)
+{
+}
+
+FileTailer::~FileTailer()
+{
+	for (TailedFile *file : _files) {
+		if (file) {
+			delete file->file;
+			delete file;
+		}
+	}
+}
+
+/**
+ * Starts tailing the file at the given path.  The file does not need to exist yet.
+ * @param path The path of the file to tail.
+ * @param from_start Whether the existing contents of the file should be handed out, or only
+ * bytes appended from now on.
+ * @return An identifier for the tailed file.
+ */
+FileTailer::FileID FileTailer::add(const std::string& path, bool from_start)
+{
+	TailedFile *file = new TailedFile();
+
+	size_t slash = path.rfind('/');
+	if (slash == std::string::npos) {
+		file->directory = std::string(".");
+		file->name = path;
+	} else {
+		file->directory = slash == 0 ? std::string("/") : path.substr(0, slash);
+		file->name = path.substr(slash + 1);
+	}
+
+	file->path = path;
+	file->file = nullptr;
+	file->watch = -1;
+	file->offset = 0;
+	file->dirty = false;
+	file->check_rotation = false;
+
+	try {
+		// Watching the directory lets us see the file being (re-)created.
+		watch_directory(file->directory);
+	} catch (const InotifyException&) {
+		delete file;
+		throw FileTailerException("Unable to watch directory of tailed file");
+	}
+
+	FileID id = (FileID)_files.size();
+	_files.push_back(file);
+
+	if (open(*file, id)) {
+		file->offset = from_start ? 0 : file->file->size();
+		file->dirty = from_start;
+	}
+
+	return id;
+}
+
+/**
+ * Stops tailing a file.
+ * @param id The identifier of the file to stop tailing.
+ */
+void FileTailer::remove(FileID id)
+{
+	TailedFile *file = _files.at(id);
+	if (!file) {
+		return;
+	}
+
+	close(*file, id);
+	unwatch_directory(file->directory);
+
+	delete file;
+	_files[id] = nullptr;
+}
+
+/**
+ * Handles a readiness event, if it belongs to the tailer's inotify object.
+ * @param event The event returned from Epoll::wait.
+ * @return True if the event was consumed by the tailer.
+ */
+bool FileTailer::handle(const EpollEvent& event)
+{
+	if (event.fd != &_inotify) {
+		return false;
+	}
+
+	process_events();
+	return true;
+}
+
+/**
+ * Reads pending inotify events, and notes which files have new data to collect.
+ */
+void FileTailer::process_events()
+{
+	_events.clear();
+	_inotify.read_events(_events);
+
+	for (const InotifyEvent& event : _events) {
+		if (event.is(InotifyEventType::Q_OVERFLOW)) {
+			// Events were lost, so any file might have changed.
+			for (TailedFile *file : _files) {
+				if (file) {
+					file->dirty = true;
+					file->check_rotation = true;
+				}
+			}
+
+			continue;
+		}
+
+		auto directory = _directory_watches.find(event.watch);
+		if (directory != _directory_watches.end()) {
+			if (!event.is(InotifyEventType::CREATE | InotifyEventType::MOVED_TO)) {
+				continue;
+			}
+
+			// A file appeared in a watched directory: if it is at a path we are tailing,
+			// then the file has been (re-)created.
+			for (TailedFile *file : _files) {
+				if (file && file->name == event.name && file->directory == directory->second) {
+					file->dirty = true;
+					file->check_rotation = true;
+				}
+			}
+
+			continue;
+		}
+
+		auto watchers = _file_watches.find(event.watch);
+		if (watchers == _file_watches.end()) {
+			continue;
+		}
+
+		for (FileID id : watchers->second) {
+			TailedFile *file = _files[id];
+
+			file->dirty = true;
+
+			if (event.is(InotifyEventType::MOVE_SELF | InotifyEventType::DELETE_SELF)) {
+				file->check_rotation = true;
+			}
+
+			if (event.is(InotifyEventType::IGNORED)) {
+				file->watch = -1;
+			}
+		}
+
+		if (event.is(InotifyEventType::IGNORED)) {
+			// The kernel has removed the watch, because the file has gone.
+			_file_watches.erase(watchers);
+		}
+	}
+}
+
+/**
+ * Collects the bytes appended to any tailed file since the last collection.
+ * @param batches A list to populate with batches of new data.  This list is NOT cleared.
+ * @param max_bytes The maximum number of bytes to collect.  Files with more data remain pending
+ * for the next collection.
+ * @return The number of bytes collected.
+ */
+size_t FileTailer::collect(std::vector<TailBatch>& batches, size_t max_bytes)
+{
+	size_t total = 0;
+
+	for (FileID id = 0; id < _files.size() && total < max_bytes; id++) {
+		TailedFile *file = _files[id];
+
+		if (file && file->dirty) {
+			total += read_appended(id, *file, batches, max_bytes - total);
+		}
+	}
+
+	return total;
+}
+
+/**
+ * Reads the bytes appended to a file, following it across a truncation or rotation.
+ * @return The number of bytes read.
+ */
+size_t FileTailer::read_appended(FileID id, TailedFile& file, std::vector<TailBatch>& batches, size_t max_bytes)
+{
+	size_t total = 0;
+
+	for (;;) {
+		if (file.file) {
+			uint64_t size = file.file->size();
+
+			if (size < file.offset) {
+				// The file has been truncated, so start again from the beginning.
+				file.offset = 0;
+			}
+
+			while (file.offset < size && total < max_bytes) {
+				size_t length = std::min<uint64_t>(std::min<uint64_t>(_max_batch_size, size - file.offset), max_bytes - total);
+
+				batches.push_back({ id, file.offset, std::vector<char>(length) });
+				TailBatch& batch = batches.back();
+
+				ssize_t rc = ::pread(file.file->fd(), batch.data.data(), length, (off_t)file.offset);
+				SFD_METRIC_SYSCALL(REGULAR_FILE, rc);
+				if (rc <= 0) {
+					batches.pop_back();
+
+					if (rc < 0 && errno == EINTR) {
+						continue;
+					}
+
+					break;
+				}
+
+				batch.data.resize(rc);
+				file.offset += rc;
+				total += rc;
+			}
+
+			if (file.offset < size && total >= max_bytes) {
+				// Out of budget: leave the file pending.
+				return total;
+			}
+		}
+
+		// Only switch to a new file once the old one has been read to the end.
+		if (!file.check_rotation || !reopen_if_rotated(file, id)) {
+			break;
+		}
+	}
+
+	file.dirty = false;
+	return total;
+}
+
+/**
+ * Opens the file currently at a tailed file's path, and watches it.
+ * @return True if the file was opened.
+ */
+bool FileTailer::open(TailedFile& file, FileID id)
+{
+	try {
+		file.file = new RegularFile(file.path, FileOpenMode::READ);
+	} catch (const RegularFileException&) {
+		file.file = nullptr;
+		return false;
+	}
+
+	struct stat st;
+	if (::fstat(file.file->fd(), &st) < 0) {
+		delete file.file;
+		file.file = nullptr;
+		return false;
+	}
+
+	file.device = st.st_dev;
+	file.inode = st.st_ino;
+
+	// Watch the file through its open descriptor, so that the watch is guaranteed to be on the
+	// file we opened, even if the path has been replaced in the meantime.
+	try {
+		file.watch = _inotify.add_watch("/proc/self/fd/" + std::to_string(file.file->fd()),
+			InotifyEventType::MODIFY | InotifyEventType::ATTRIB | InotifyEventType::MOVE_SELF | InotifyEventType::DELETE_SELF);
+	} catch (const InotifyException&) {
+		file.watch = _inotify.add_watch(file.path,
+			InotifyEventType::MODIFY | InotifyEventType::ATTRIB | InotifyEventType::MOVE_SELF | InotifyEventType::DELETE_SELF);
+	}
+
+	std::vector<FileID>& watchers = _file_watches[file.watch];
+	if (std::find(watchers.begin(), watchers.end(), id) == watchers.end()) {
+		watchers.push_back(id);
+	}
+
+	return true;
+}
+
+/**
+ * Closes a tailed file, and stops watching it.
+ */
+void FileTailer::close(TailedFile& file, FileID id)
+{
+	if (file.watch >= 0) {
+		auto watchers = _file_watches.find(file.watch);
+
+		if (watchers != _file_watches.end()) {
+			watchers->second.erase(std::remove(watchers->second.begin(), watchers->second.end(), id), watchers->second.end());
+
+			if (watchers->second.empty()) {
+				_file_watches.erase(watchers);
+
+				try {
+					_inotify.remove_watch(file.watch);
+				} catch (const InotifyException&) {
+					// The kernel may already have removed the watch.
+				}
+			}
+		}
+
+		file.watch = -1;
+	}
+
+	delete file.file;
+	file.file = nullptr;
+}
+
+/**
+ * Switches to a new file at a tailed file's path, if the path now refers to a different file.
+ * @return True if the tailer switched to a new file.
+ */
+bool FileTailer::reopen_if_rotated(TailedFile& file, FileID id)
+{
+	file.check_rotation = false;
+
+	struct stat st;
+	if (::stat(file.path.c_str(), &st) < 0) {
+		// Nothing has been created at the path yet.
+		return false;
+	}
+
+	if (file.file && st.st_dev == file.device && st.st_ino == file.inode) {
+		return false;
+	}
+
+	close(file, id);
+
+	if (!open(file, id)) {
+		return false;
+	}
+
+	file.offset = 0;
+	return true;
+}
+
+void FileTailer::watch_directory(const std::string& directory)
+{
+	auto existing = _directories.find(directory);
+	if (existing != _directories.end()) {
+		existing->second.references++;
+		return;
+	}
+
+	int watch = _inotify.add_watch(directory, InotifyEventType::CREATE | InotifyEventType::MOVED_TO | InotifyEventType::ONLYDIR);
+
+	_directories[directory] = { watch, 1 };
+	_directory_watches[watch] = directory;
+}
+
+void FileTailer::unwatch_directory(const std::string& directory)
+{
+	auto existing = _directories.find(directory);
+	if (existing == _directories.end() || --existing->second.references > 0) {
+		return;
+	}
+
+	try {
+		_inotify.remove_watch(existing->second.watch);
+	} catch (const InotifyException&) {
+	}
+
+	_directory_watches.erase(existing->second.watch);
+	_directories.erase(existing);
+}
@@ -0,0 +1,107 @@
+/**
+ * src/inotify.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/inotify.h>
+#include <sfd/metrics.h>
+#include <sys/inotify.h>
+#include <errno.h>
+#include <unistd.h>
+
+using namespace sfd;
+
+/**
+ * Creates a new managed inotify object.
+ */
+Inotify::Inotify() : FileDescriptor(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+{
+	if (!valid()) {
+		throw InotifyException("Error whilst creating inotify object");
+	}
+}
+
+/**
+ * Starts watching the given path, or updates the events watched for an existing watch on it.
+ * @param path The file or directory to watch.
+ * @param events The events to watch for.
+ * @return The watch descriptor, which identifies the watch in subsequent events.
+ */
+int Inotify::add_watch(const std::string& path, InotifyEventType::InotifyEventType events)
+{
+	int watch = ::inotify_add_watch(fd(), path.c_str(), (uint32_t)events);
+	if (watch < 0) {
+		throw InotifyException("Unable to add watch");
+	}
+
+	return watch;
+}
+
+/**
+ * Stops watching the path associated with the given watch descriptor.
+ * @param watch The watch descriptor to remove.
+ */
+void Inotify::remove_watch(int watch)
+{
+	if (::inotify_rm_watch(fd(), watch) < 0) {
+		throw InotifyException("Unable to remove watch");
+	}
+}
+
+/**
+ * Reads all the events that are currently waiting.
+ * @param events A list to populate with events.  This list is NOT cleared.
+ * @return True if any events were read.
+ */
+bool Inotify::read_events(std::vector<InotifyEvent>& events)
+{
+	// Large enough to hold many events, and always at least one event with a maximum
+	// length name.
+	char buffer[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+	bool any = false;
+
+	for (;;) {
+		ssize_t count = ::read(fd(), buffer, sizeof(buffer));
+		SFD_METRIC_SYSCALL(INOTIFY, count);
+
+		if (count < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			if (errno == EAGAIN) {
+				return any;
+			}
+
+			throw InotifyException("Unable to read events");
+		}
+
+		for (char *ptr = buffer; ptr < buffer + count; ) {
+			const struct inotify_event *raw_event = (const struct inotify_event *)ptr;
+
+			events.push_back({
+				raw_event->wd,
+				(InotifyEventType::InotifyEventType)raw_event->mask,
+				raw_event->cookie,
+				raw_event->len ? std::string(raw_event->name) : std::string()
+			});
+
+			ptr += sizeof(struct inotify_event) + raw_event->len;
+		}
+
+		any = true;
+	}
+}
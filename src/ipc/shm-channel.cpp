@@ -0,0 +1,346 @@
+/**
+ * src/ipc/shm-channel.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/ipc/shm-channel.h>
+
+#include <string.h>
+#include <unistd.h>
+#include <new>
+#include <vector>
+
+using namespace sfd;
+using namespace sfd::ipc;
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2, "shared memory channels need address-free atomics");
+
+namespace {
+	const uint32_t ChannelMagic = 0x43534653;	// "SFSC"
+	const uint32_t ChannelVersion = 1;
+	const size_t CacheLineSize = 64;
+
+	size_t round_up(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+/**
+ * Lives at the start of the shared memory.  The producer and consumer indices are on their own
+ * cache lines, so that producers and the consumer do not false-share.
+ */
+struct ShmChannel::Header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t slot_count;
+	uint64_t slot_size;
+	uint64_t slot_stride;
+
+	alignas(CacheLineSize) std::atomic<uint64_t> tail;
+	alignas(CacheLineSize) std::atomic<uint64_t> head;
+	alignas(CacheLineSize) std::atomic<uint32_t> consumer_sleeping;
+};
+
+/**
+ * Each slot carries a sequence number, which tells producers and the consumer whose turn it
+ * is: a slot at position p is free for the producer that claims p when its sequence is p, and
+ * holds a message for the consumer when its sequence is p + 1.
+ */
+struct ShmChannel::Slot {
+	std::atomic<uint64_t> sequence;
+	uint32_t length;
+	uint32_t reserved;
+	char data[];
+};
+
+/**
+ * Creates a new channel.
+ * @param slot_count The number of messages the channel can hold.  Must be a power of two.
+ * @param slot_size The maximum size of a message.
+ * @return A new channel, owned by the caller.
+ */
+ShmChannel* ShmChannel::create(size_t slot_count, size_t slot_size)
+{
+	if (slot_count == 0 || (slot_count & (slot_count - 1)) != 0 || slot_size == 0) {
+		throw ShmChannelException("Invalid channel geometry");
+	}
+
+	size_t slot_stride = round_up(sizeof(Slot) + slot_size, CacheLineSize);
+	size_t size = round_up(sizeof(Header), CacheLineSize) + slot_count * slot_stride;
+
+	SharedMemory *memory = new SharedMemory("sfd-shm-channel", size);
+	Event *notifier;
+
+	try {
+		notifier = new Event();
+	} catch (...) {
+		delete memory;
+		throw;
+	}
+
+	Header *header = new (memory->address()) Header();
+	header->magic = ChannelMagic;
+	header->version = ChannelVersion;
+	header->slot_count = slot_count;
+	header->slot_size = slot_size;
+	header->slot_stride = slot_stride;
+	header->tail.store(0, std::memory_order_relaxed);
+	header->head.store(0, std::memory_order_relaxed);
+	header->consumer_sleeping.store(0, std::memory_order_relaxed);
+
+	char *slots = (char *)memory->address() + round_up(sizeof(Header), CacheLineSize);
+	for (size_t i = 0; i < slot_count; i++) {
+		Slot *slot = new (slots + i * slot_stride) Slot();
+		slot->sequence.store(i, std::memory_order_relaxed);
+	}
+
+	std::atomic_thread_fence(std::memory_order_release);
+	return new ShmChannel(memory, notifier, slot_count, slot_size, slot_stride);
+}
+
+/**
+ * Attaches to a channel created by the process on the other end of the given socket.
+ * @param socket The Unix socket the peer called send_setup on.
+ * @return A new channel, owned by the caller.
+ */
+ShmChannel* ShmChannel::receive_setup(net::UnixSocket& socket)
+{
+	std::vector<FileDescriptor::NativeFD> fds;
+	uint32_t magic;
+
+	size_t length = socket.recv_with_fds(&magic, sizeof(magic), fds);
+	if (length != sizeof(magic) || magic != ChannelMagic || fds.size() != 2) {
+		for (FileDescriptor::NativeFD fd : fds) {
+			::close(fd);
+		}
+
+		throw ShmChannelException("Invalid channel setup message");
+	}
+
+	Event *notifier = Event::adopt(fds[1]);
+	SharedMemory *memory;
+
+	try {
+		memory = SharedMemory::adopt(fds[0]);
+	} catch (...) {
+		delete notifier;
+		throw;
+	}
+
+	// Make sure the memory really is a channel, and is as big as it claims to be.  The header
+	// is written by the peer, so its geometry is read exactly once, and the copy that was
+	// checked is the one that is used.
+	const volatile Header *header = (const volatile Header *)memory->address();
+	uint64_t slot_count = 0, slot_size = 0, slot_stride = 0;
+	uint64_t slots_size, slot_need;
+
+	bool valid = memory->size() >= sizeof(Header) && header->magic == ChannelMagic && header->version == ChannelVersion;
+	if (valid) {
+		slot_count = header->slot_count;
+		slot_size = header->slot_size;
+		slot_stride = header->slot_stride;
+
+		valid = slot_count != 0 && (slot_count & (slot_count - 1)) == 0 && slot_size != 0 && slot_size <= UINT32_MAX &&
+			!__builtin_add_overflow(sizeof(Slot), slot_size, &slot_need) && slot_stride >= slot_need &&
+			!__builtin_mul_overflow(slot_count, slot_stride, &slots_size) &&
+			memory->size() - round_up(sizeof(Header), CacheLineSize) >= slots_size;
+	}
+
+	if (!valid) {
+		delete memory;
+		delete notifier;
+
+		throw ShmChannelException("Invalid channel memory");
+	}
+
+	return new ShmChannel(memory, notifier, slot_count, slot_size, slot_stride);
+}
+
+ShmChannel::ShmChannel(SharedMemory* memory, Event* notifier, size_t slot_count, size_t slot_size, size_t slot_stride)
+	: _memory(memory), _notifier(notifier), _slot_count(slot_count), _slot_size(slot_size), _slot_stride(slot_stride)
+{
+	_header = (Header *)_memory->address();
+	_slots = (char *)_memory->address() + round_up(sizeof(Header), CacheLineSize);
+}
+
+ShmChannel::~ShmChannel()
+{
+	delete _memory;
+	delete _notifier;
+}
+
+/**
+ * Passes the channel to the process on the other end of the given socket.
+ * @param socket A connected Unix socket.
+ */
+void ShmChannel::send_setup(net::UnixSocket& socket)
+{
+	std::vector<FileDescriptor::NativeFD> fds;
+	fds.push_back(_memory->fd());
+	fds.push_back(_notifier->fd());
+
+	uint32_t magic = ChannelMagic;
+	socket.send_with_fds(&magic, sizeof(magic), fds);
+}
+
+/**
+ * Sends a message.  This never blocks.
+ * @param message The message to send.
+ * @param length The length of the message, which must not exceed max_message_size.
+ * @return True if the message was sent, or false if the channel is full.
+ */
+bool ShmChannel::send(const void* message, size_t length)
+{
+	if (length > _slot_size) {
+		throw ShmChannelException("Message too large for channel");
+	}
+
+	uint64_t position = _header->tail.load(std::memory_order_relaxed);
+	Slot *target;
+
+	for (;;) {
+		target = slot(position);
+		uint64_t sequence = target->sequence.load(std::memory_order_acquire);
+		int64_t difference = (int64_t)(sequence - position);
+
+		if (difference == 0) {
+			// The slot is free: try to claim it.
+			if (_header->tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+				break;
+			}
+		} else if (difference < 0) {
+			// The consumer has not yet released this slot from the previous lap.
+			return false;
+		} else {
+			// Another producer claimed the slot first.
+			position = _header->tail.load(std::memory_order_relaxed);
+		}
+	}
+
+	memcpy(target->data, message, length);
+	target->length = (uint32_t)length;
+	target->sequence.store(position + 1, std::memory_order_release);
+
+	// Pairs with the fence in prepare_to_sleep: either the consumer sees the message when it
+	// re-checks the ring, or we see that it is asleep, and wake it.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if (_header->consumer_sleeping.load(std::memory_order_relaxed) && _header->consumer_sleeping.exchange(0)) {
+		_notifier->invoke();
+	}
+
+	return true;
+}
+
+/**
+ * Receives a message, if one is waiting.  This never blocks, and must only be called by the
+ * single consumer.
+ * @param buffer The buffer to receive the message into.
+ * @param length On entry, the size of the buffer; on return, the length of the message.
+ * @return True if a message was received, or false if the channel is empty.  A message that
+ * does not fit into the buffer, or whose length is corrupt, is discarded and an exception is
+ * thrown.
+ */
+bool ShmChannel::try_receive(void* buffer, size_t& length)
+{
+	uint64_t position = _header->head.load(std::memory_order_relaxed);
+	Slot *source = slot(position);
+
+	if (source->sequence.load(std::memory_order_acquire) != position + 1) {
+		return false;
+	}
+
+	// The length is written by a producer in another process, so it is read exactly once and
+	// checked before it is used.
+	size_t message_length = *(const volatile uint32_t *)&source->length;
+	bool fits = message_length <= _slot_size && message_length <= length;
+
+	if (fits) {
+		memcpy(buffer, source->data, message_length);
+		length = message_length;
+	}
+
+	// Hand the slot back to the producers, for the next lap around the ring.  A bad message is
+	// released too, so that it does not block the channel.
+	source->sequence.store(position + _slot_count, std::memory_order_release);
+	_header->head.store(position + 1, std::memory_order_relaxed);
+
+	if (!fits) {
+		throw ShmChannelException(message_length > _slot_size ? "Invalid message length" : "Buffer too small for message");
+	}
+
+	return true;
+}
+
+/**
+ * Receives a message, sleeping on the channel's eventfd until one arrives.
+ * @param buffer The buffer to receive the message into.
+ * @param length The size of the buffer.
+ * @return The length of the message.
+ */
+size_t ShmChannel::receive(void* buffer, size_t length)
+{
+	for (;;) {
+		size_t message_length = length;
+		if (try_receive(buffer, message_length)) {
+			return message_length;
+		}
+
+		if (prepare_to_sleep()) {
+			_notifier->acknowledge();
+			woken();
+		}
+	}
+}
+
+/**
+ * Tells producers that the consumer is about to sleep (e.g. in Epoll::wait, with the notifier
+ * registered), so that the next message sent invokes the notifier.
+ * @return True if the consumer may sleep, or false if a message arrived in the meantime.
+ */
+bool ShmChannel::prepare_to_sleep()
+{
+	_header->consumer_sleeping.store(1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if (!empty()) {
+		_header->consumer_sleeping.store(0, std::memory_order_relaxed);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Tells producers that the consumer is awake again, after prepare_to_sleep.  If the notifier is
+ * registered with Epoll, it should also be acknowledged.
+ */
+void ShmChannel::woken()
+{
+	_header->consumer_sleeping.store(0, std::memory_order_relaxed);
+}
+
+ShmChannel::Slot* ShmChannel::slot(uint64_t position) const
+{
+	return (Slot *)(_slots + (position & (_slot_count - 1)) * _slot_stride);
+}
+
+bool ShmChannel::empty() const
+{
+	uint64_t position = _header->head.load(std::memory_order_relaxed);
+	return slot(position)->sequence.load(std::memory_order_acquire) != position + 1;
+}
@@ -0,0 +1,102 @@
+/**
+ * src/loop-lag-monitor.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/loop-lag-monitor.h>
+
+using namespace sfd;
+
+/**
+ * Creates a new loop lag monitor.
+ * @param interval_ns How often to sample the lag.  Shorter intervals react faster to overload,
+ * at the cost of more wakeups.
+ */
+LoopLagMonitor::LoopLagMonitor(uint64_t interval_ns)
+	: _interval_ns(interval_ns), _next_expiry(0), _iteration_start(0)
+{
+	reset();
+}
+
+/**
+ * Registers the sampling timer with the given epoll instance, and starts sampling.
+ * @param epoll The epoll instance of the loop to monitor.
+ */
+void LoopLagMonitor::attach(Epoll& epoll)
+{
+	epoll.add(&_timer, EpollEventType::IN);
+
+	_next_expiry = metrics::now() + _interval_ns;
+	_timer.arm(_interval_ns, _interval_ns);
+}
+
+/**
+ * Stops sampling, and removes the timer from the given epoll instance.
+ * @param epoll The epoll instance the monitor was attached to.
+ */
+void LoopLagMonitor::detach(Epoll& epoll)
+{
+	_timer.disarm();
+	epoll.remove(&_timer);
+}
+
+/**
+ * Handles a readiness event, if it belongs to the sampling timer.
+ * @param event The event returned from Epoll::wait.
+ * @return True if the event was consumed by this monitor.
+ */
+bool LoopLagMonitor::handle(const EpollEvent& event)
+{
+	if (event.fd != &_timer) {
+		return false;
+	}
+
+	uint64_t expirations = _timer.acknowledge();
+	uint64_t now = metrics::now();
+
+	if (expirations == 0) {
+		return true;
+	}
+
+	// If the loop fell more than an interval behind, several expirations are reported at once,
+	// and the lag is measured from the earliest, i.e. from when the loop should first have
+	// noticed the timer.
+	uint64_t lag = now > _next_expiry ? now - _next_expiry : 0;
+
+	_next_expiry += expirations * _interval_ns;
+
+	_lag.record(lag);
+	_lag_average = smooth(_lag_average, lag);
+
+	return true;
+}
+
+void LoopLagMonitor::end_iteration()
+{
+	uint64_t duration = metrics::now() - _iteration_start;
+
+	_iterations.record(duration);
+	_iteration_average = smooth(_iteration_average, duration);
+}
+
+void LoopLagMonitor::reset()
+{
+	_lag.reset();
+	_iterations.reset();
+
+	_lag_average = 0;
+	_iteration_average = 0;
+}
@@ -0,0 +1,337 @@
+/**
+ * src/metrics.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/metrics.h>
+
+#include <algorithm>
+#include <mutex>
+#include <sstream>
+#include <vector>
+#include <time.h>
+
+using namespace sfd::metrics;
+
+namespace {
+	const char *counter_names[] = {
+		"epoll_waits",
+		"epoll_events",
+		"epoll_idle_ns",
+		"epoll_busy_ns",
+		"socket_bytes_in",
+		"socket_bytes_out",
+		"accepts",
+	};
+
+	const char *kind_names[] = {
+		"generic",
+		"epoll",
+		"event",
+		"signal",
+		"regular_file",
+		"socket",
+		"pipe",
+		"inotify",
+		"timer",
+	};
+
+	static_assert(sizeof(counter_names) / sizeof(counter_names[0]) == Counter::COUNT, "counter names out of date");
+	static_assert(sizeof(kind_names) / sizeof(kind_names[0]) == FileDescriptorKind::COUNT, "kind names out of date");
+
+	/**
+	 * Tracks the metrics of every live thread, and the accumulated metrics of threads that
+	 * have exited.
+	 */
+	struct Registry {
+		std::mutex lock;
+		std::vector<ThreadMetrics *> threads;
+		Snapshot retired;
+
+		Registry() {
+			std::fill(retired.counters, retired.counters + Counter::COUNT, 0);
+			std::fill(retired.syscalls, retired.syscalls + FileDescriptorKind::COUNT, 0);
+			std::fill(retired.eagains, retired.eagains + FileDescriptorKind::COUNT, 0);
+		}
+	};
+
+	Registry& registry()
+	{
+		// Deliberately leaked, so that threads exiting during static destruction can still
+		// retire their metrics.
+		static Registry *instance = new Registry();
+		return *instance;
+	}
+
+	void accumulate(Snapshot& snapshot, const ThreadMetrics& metrics)
+	{
+		for (unsigned int i = 0; i < Counter::COUNT; i++) {
+			snapshot.counters[i] += metrics.counters[i].load(std::memory_order_relaxed);
+		}
+
+		for (unsigned int i = 0; i < FileDescriptorKind::COUNT; i++) {
+			snapshot.syscalls[i] += metrics.syscalls[i].load(std::memory_order_relaxed);
+			snapshot.eagains[i] += metrics.eagains[i].load(std::memory_order_relaxed);
+		}
+
+		snapshot.wait_to_dispatch.merge(metrics.wait_to_dispatch);
+		snapshot.handler_time.merge(metrics.handler_time);
+	}
+
+	/**
+	 * Owns a thread's metrics, registering them when the thread first records a metric and
+	 * retiring them when the thread exits.
+	 */
+	struct ThreadMetricsHolder {
+		ThreadMetrics metrics;
+
+		ThreadMetricsHolder() {
+			for (unsigned int i = 0; i < Counter::COUNT; i++) {
+				metrics.counters[i].store(0, std::memory_order_relaxed);
+			}
+
+			for (unsigned int i = 0; i < FileDescriptorKind::COUNT; i++) {
+				metrics.syscalls[i].store(0, std::memory_order_relaxed);
+				metrics.eagains[i].store(0, std::memory_order_relaxed);
+			}
+
+			metrics.last_wake = now();
+
+			Registry& r = registry();
+			std::lock_guard<std::mutex> guard(r.lock);
+			r.threads.push_back(&metrics);
+		}
+
+		~ThreadMetricsHolder() {
+			Registry& r = registry();
+			std::lock_guard<std::mutex> guard(r.lock);
+
+			accumulate(r.retired, metrics);
+			r.threads.erase(std::remove(r.threads.begin(), r.threads.end(), &metrics), r.threads.end());
+		}
+	};
+}
+
+/**
+ * Returns true if the library was built with metrics enabled (SFD_METRICS).
+ */
+bool sfd::metrics::enabled()
+{
+#ifdef SFD_METRICS
+	return true;
+#else
+	return false;
+#endif
+}
+
+/**
+ * Returns the metrics of the calling thread.
+ */
+ThreadMetrics& sfd::metrics::thread_metrics()
+{
+	static thread_local ThreadMetricsHolder holder;
+	return holder.metrics;
+}
+
+/**
+ * Returns the current time on the monotonic clock, in nanoseconds.
+ */
+uint64_t sfd::metrics::now()
+{
+	struct timespec ts;
+	::clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/**
+ * Aggregates the metrics recorded so far by every thread, live or exited.
+ */
+Snapshot sfd::metrics::snapshot()
+{
+	Registry& r = registry();
+	std::lock_guard<std::mutex> guard(r.lock);
+
+	Snapshot result = r.retired;
+	result.timestamp_ns = now();
+	result.threads = (unsigned int)r.threads.size();
+
+	for (const ThreadMetrics *metrics : r.threads) {
+		accumulate(result, *metrics);
+	}
+
+	return result;
+}
+
+const char *sfd::metrics::counter_name(Counter::Counter counter)
+{
+	return counter_names[counter];
+}
+
+const char *sfd::metrics::kind_name(FileDescriptorKind::FileDescriptorKind kind)
+{
+	return kind_names[kind];
+}
+
+/**
+ * Formats the snapshot as "name value" lines, suitable for export.
+ */
+std::string Snapshot::to_string() const
+{
+	std::ostringstream out;
+
+	out << "timestamp_ns " << timestamp_ns << "\n";
+	out << "threads " << threads << "\n";
+
+	for (unsigned int i = 0; i < Counter::COUNT; i++) {
+		out << counter_names[i] << " " << counters[i] << "\n";
+	}
+
+	for (unsigned int i = 0; i < FileDescriptorKind::COUNT; i++) {
+		out << "syscalls." << kind_names[i] << " " << syscalls[i] << "\n";
+		out << "eagains." << kind_names[i] << " " << eagains[i] << "\n";
+	}
+
+	const LatencyHistogram *histograms[] = { &wait_to_dispatch, &handler_time };
+	const char *histogram_names[] = { "wait_to_dispatch_ns", "handler_time_ns" };
+
+	for (unsigned int i = 0; i < 2; i++) {
+		out << histogram_names[i] << ".count " << histograms[i]->count() << "\n";
+		out << histogram_names[i] << ".p50 " << histograms[i]->percentile(50) << "\n";
+		out << histogram_names[i] << ".p99 " << histograms[i]->percentile(99) << "\n";
+		out << histogram_names[i] << ".p999 " << histograms[i]->percentile(99.9) << "\n";
+		out << histogram_names[i] << ".max " << histograms[i]->max() << "\n";
+	}
+
+	return out.str();
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+	reset();
+}
+
+LatencyHistogram::LatencyHistogram(const LatencyHistogram& other)
+{
+	*this = other;
+}
+
+LatencyHistogram& LatencyHistogram::operator=(const LatencyHistogram& other)
+{
+	for (unsigned int i = 0; i < BucketCount; i++) {
+		_buckets[i].store(other._buckets[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+
+	return *this;
+}
+
+/**
+ * Adds the values recorded in another histogram to this histogram.
+ */
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+	for (unsigned int i = 0; i < BucketCount; i++) {
+		uint64_t count = other._buckets[i].load(std::memory_order_relaxed);
+
+		if (count) {
+			_buckets[i].store(_buckets[i].load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+		}
+	}
+}
+
+void LatencyHistogram::reset()
+{
+	for (unsigned int i = 0; i < BucketCount; i++) {
+		_buckets[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+/**
+ * Returns the number of values recorded.
+ */
+uint64_t LatencyHistogram::count() const
+{
+	uint64_t total = 0;
+
+	for (unsigned int i = 0; i < BucketCount; i++) {
+		total += _buckets[i].load(std::memory_order_relaxed);
+	}
+
+	return total;
+}
+
+/**
+ * Returns (an upper bound on) the value below which the given percentage of recorded values fall.
+ * @param p The percentile, from 0 to 100.
+ */
+uint64_t LatencyHistogram::percentile(double p) const
+{
+	uint64_t total = count();
+	if (total == 0) {
+		return 0;
+	}
+
+	uint64_t rank = (uint64_t)(p / 100.0 * (double)total + 0.5);
+	if (rank == 0) {
+		rank = 1;
+	}
+
+	uint64_t seen = 0;
+	for (unsigned int i = 0; i < BucketCount; i++) {
+		seen += _buckets[i].load(std::memory_order_relaxed);
+
+		if (seen >= rank) {
+			return bucket_upper_bound(i);
+		}
+	}
+
+	return max();
+}
+
+/**
+ * Returns (an upper bound on) the largest value recorded.
+ */
+uint64_t LatencyHistogram::max() const
+{
+	for (unsigned int i = BucketCount; i > 0; i--) {
+		if (_buckets[i - 1].load(std::memory_order_relaxed)) {
+			return bucket_upper_bound(i - 1);
+		}
+	}
+
+	return 0;
+}
+
+uint64_t LatencyHistogram::bucket_lower_bound(unsigned int index)
+{
+	if (index < SubBuckets) {
+		return index;
+	}
+
+	unsigned int magnitude = index / SubBuckets;
+	unsigned int sub_bucket = index % SubBuckets;
+
+	return (uint64_t)(SubBuckets + sub_bucket) << (magnitude - 1);
+}
+
+uint64_t LatencyHistogram::bucket_upper_bound(unsigned int index)
+{
+	if (index < SubBuckets) {
+		return index;
+	}
+
+	return bucket_lower_bound(index) + ((uint64_t)1 << (index / SubBuckets - 1)) - 1;
+}
@@ -0,0 +1,311 @@
+/**
+ * src/net/admission-controller.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/net/admission-controller.h>
+#include <sfd/metrics.h>
+
+#include <errno.h>
+
+using namespace sfd;
+using namespace sfd::net;
+
+/**
+ * Creates an admission controller for a listening socket.  The listener is placed into
+ * non-blocking mode.
+ * @param listener The listening socket to accept connections from.
+ * @param monitor The lag monitor of the loop this controller runs in.
+ * @param policy What to do with new connections while the loop is overloaded.
+ * @param thresholds The lag at which the loop becomes, and stops being, overloaded.
+ * @param callback Invoked with each admitted connection.
+ */
+AdmissionController::AdmissionController(Socket& listener, LoopLagMonitor& monitor, AdmissionPolicy::AdmissionPolicy policy,
+		const AdmissionThresholds& thresholds, const AcceptCallback& callback)
+	: _listener(listener),
+		_monitor(monitor),
+		_policy(policy),
+		_thresholds(thresholds),
+		_callback(callback),
+		_next_sibling(0),
+		_epoll(nullptr),
+		_overloaded(false),
+		_paused(false),
+		_paused_since(0),
+		_accepted(0),
+		_rejected(0),
+		_shed(0),
+		_received(0),
+		_pauses(0),
+		_paused_total_ns(0)
+{
+	// Siblings shed connections to this controller by sending it the file descriptors over a
+	// socket pair, which is safe to do from another thread.
+	UnixSocket::pair(SocketType::Datagram, _inbox, _inbox_sender);
+
+	_inbox->non_blocking(true);
+	_inbox_sender->non_blocking(true);
+	_listener.non_blocking(true);
+}
+
+AdmissionController::~AdmissionController()
+{
+	delete _inbox;
+	delete _inbox_sender;
+}
+
+/**
+ * Adds a sibling to shed connections to, under the Shed policy.  Siblings are used in turn.
+ * The sibling must outlive this controller.
+ */
+void AdmissionController::shed_to(AdmissionController& sibling)
+{
+	_siblings.push_back(&sibling);
+}
+
+/**
+ * Registers the listener, the inbox for shed connections and the recovery timer with the given
+ * epoll instance.
+ * @param epoll The epoll instance of the loop this controller runs in.
+ */
+void AdmissionController::attach(Epoll& epoll)
+{
+	_epoll = &epoll;
+
+	_epoll->add(&_listener, EpollEventType::IN);
+	_epoll->add(_inbox, EpollEventType::IN);
+	_epoll->add(&_recheck, EpollEventType::IN);
+
+	_paused = false;
+}
+
+/**
+ * Removes the controller from the given epoll instance.
+ * @param epoll The epoll instance the controller was attached to.
+ */
+void AdmissionController::detach(Epoll& epoll)
+{
+	if (!_paused) {
+		epoll.remove(&_listener);
+	}
+
+	epoll.remove(_inbox);
+
+	_recheck.disarm();
+	epoll.remove(&_recheck);
+
+	_epoll = nullptr;
+}
+
+/**
+ * Handles a readiness event, if it belongs to the listener, the inbox or the recovery timer.
+ * @param event The event returned from Epoll::wait.
+ * @return True if the event was consumed by this controller.
+ */
+bool AdmissionController::handle(const EpollEvent& event)
+{
+	if (event.fd == &_listener) {
+		accept_pending();
+		return true;
+	}
+
+	if (event.fd == _inbox) {
+		receive_shed();
+		return true;
+	}
+
+	if (event.fd == &_recheck) {
+		_recheck.acknowledge();
+
+		if (!evaluate()) {
+			resume();
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * Returns the total time the listener has spent paused, including the current pause.
+ */
+uint64_t AdmissionController::paused_ns() const
+{
+	if (_paused) {
+		return _paused_total_ns + (metrics::now() - _paused_since);
+	}
+
+	return _paused_total_ns;
+}
+
+/**
+ * Updates, and returns, whether the loop is overloaded.  The loop becomes overloaded when
+ * either measure exceeds its high threshold, and recovers only once every measure is back
+ * below its low threshold, so that the controller does not flap around a single threshold.
+ */
+bool AdmissionController::evaluate()
+{
+	uint64_t lag = _monitor.lag();
+	uint64_t iteration = _monitor.iteration_time();
+
+	// Siblings on other threads read the flag when deciding where to shed to.
+	if (!_overloaded) {
+		_overloaded = (_thresholds.lag_high_ns && lag > _thresholds.lag_high_ns)
+			|| (_thresholds.iteration_high_ns && iteration > _thresholds.iteration_high_ns);
+	} else {
+		_overloaded = (_thresholds.lag_low_ns && lag > _thresholds.lag_low_ns)
+			|| (_thresholds.iteration_low_ns && iteration > _thresholds.iteration_low_ns);
+	}
+
+	return _overloaded;
+}
+
+void AdmissionController::accept_pending()
+{
+	if (evaluate() && _policy == AdmissionPolicy::Pause) {
+		pause();
+		return;
+	}
+
+	// Accept a bounded number of connections per event, so that a burst of connections cannot
+	// starve the work already in the loop.  The listener is level-triggered, so the rest are
+	// picked up on the next iteration.
+	for (unsigned int i = 0; i < MaxAcceptsPerEvent; i++) {
+		Socket *socket = _listener.accept();
+		if (!socket) {
+			break;
+		}
+
+		if (!_overloaded) {
+			admit(socket);
+		} else if (_policy == AdmissionPolicy::Shed && shed(socket)) {
+			_shed++;
+		} else {
+			reject(socket);
+		}
+	}
+}
+
+void AdmissionController::admit(Socket *socket)
+{
+	_accepted++;
+	_callback(socket);
+}
+
+/**
+ * Closes a connection with a reset, so that the client fails immediately rather than waiting
+ * for a response, and no TIME_WAIT state is left behind.
+ */
+void AdmissionController::reject(Socket *socket)
+{
+	_rejected++;
+
+	try {
+		socket->linger(true, 0);
+	} catch (const SocketException&) {
+	}
+
+	delete socket;
+}
+
+/**
+ * Passes a connection to the next sibling that can take it.
+ * @return True if a sibling took the connection.
+ */
+bool AdmissionController::shed(Socket *socket)
+{
+	for (size_t attempt = 0; attempt < _siblings.size(); attempt++) {
+		AdmissionController *sibling = _siblings[_next_sibling++ % _siblings.size()];
+
+		if (sibling->_overloaded) {
+			continue;
+		}
+
+		try {
+			char marker = 0;
+			sibling->_inbox_sender->send_with_fds(&marker, sizeof(marker), { socket->fd() });
+		} catch (const SocketException&) {
+			// The sibling's inbox is full, which is as good a sign as any that it is busy too.
+			continue;
+		}
+
+		// The sibling now has its own copy of the connection.
+		delete socket;
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * Takes connections shed by siblings.  A connection that arrives while this loop is itself
+ * overloaded is rejected, rather than passed on again.
+ */
+void AdmissionController::receive_shed()
+{
+	for (;;) {
+		std::vector<FileDescriptor::NativeFD> fds;
+		char marker;
+
+		try {
+			_inbox->recv_with_fds(&marker, sizeof(marker), fds);
+		} catch (const SocketException&) {
+			return;
+		}
+
+		for (FileDescriptor::NativeFD fd : fds) {
+			Socket *socket = Socket::adopt(fd);
+			_received++;
+
+			if (evaluate()) {
+				reject(socket);
+			} else {
+				admit(socket);
+			}
+		}
+	}
+}
+
+/**
+ * Stops watching the listener, and starts checking periodically for the loop to recover.
+ */
+void AdmissionController::pause()
+{
+	if (_paused || !_epoll) {
+		return;
+	}
+
+	_epoll->remove(&_listener);
+	_recheck.arm(_monitor.interval(), _monitor.interval());
+
+	_paused = true;
+	_paused_since = metrics::now();
+	_pauses++;
+}
+
+void AdmissionController::resume()
+{
+	if (!_paused || !_epoll) {
+		return;
+	}
+
+	_recheck.disarm();
+	_epoll->add(&_listener, EpollEventType::IN);
+
+	_paused = false;
+	_paused_total_ns += metrics::now() - _paused_since;
+}
@@ -0,0 +1,155 @@
+/**
+ * src/net/busy-poller.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/net/busy-poller.h>
+#include <sfd/metrics.h>
+
+#include <algorithm>
+#include <sstream>
+#include <sys/socket.h>
+
+using namespace sfd;
+using namespace sfd::net;
+
+/**
+ * Creates a busy poller for the given epoll instance.
+ * @param epoll The epoll instance to wait on.
+ * @param budget_ns How long each wait spins before blocking, or zero to always block.
+ */
+BusyPoller::BusyPoller(Epoll& epoll, uint64_t budget_ns) : _epoll(epoll), _budget_ns(budget_ns)
+{
+	reset();
+}
+
+/**
+ * Adds a socket to the epoll instance, and enables in-kernel busy polling on it.
+ * @param socket The socket to add.
+ * @param events The events to watch for.
+ * @param busy_poll_us How long the kernel may spin on the socket's device queue.
+ * @return True if busy polling was enabled on the socket.  This needs CAP_NET_ADMIN when
+ * busy_poll_us exceeds net.core.busy_read, and a device queue that supports it; the socket is
+ * added either way.
+ */
+bool BusyPoller::add(Socket *socket, EpollEventType::EpollEventType events, unsigned int busy_poll_us)
+{
+	bool enabled = enable(*socket, busy_poll_us);
+
+	_epoll.add(socket, events);
+	return enabled;
+}
+
+/**
+ * Enables in-kernel busy polling on a file descriptor, if it is a socket, for loops that
+ * register their descriptors with epoll themselves.
+ * @param fd The file descriptor.
+ * @param busy_poll_us How long the kernel may spin on the socket's device queue.
+ * @return True if busy polling was enabled.  Descriptors that are not sockets are left alone.
+ */
+bool BusyPoller::enable(FileDescriptor& fd, unsigned int busy_poll_us)
+{
+	int type;
+	socklen_t length = sizeof(type);
+
+	if (::getsockopt(fd.fd(), SOL_SOCKET, SO_TYPE, &type, &length) < 0) {
+		return false;
+	}
+
+	int prefer = 1;
+
+	return ::setsockopt(fd.fd(), SOL_SOCKET, SO_BUSY_POLL, &busy_poll_us, sizeof(busy_poll_us)) == 0 &&
+		::setsockopt(fd.fd(), SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer, sizeof(prefer)) == 0;
+}
+
+/**
+ * Waits for events, spinning for up to the budget before blocking.
+ * @param events A list to populate with events.  This list is NOT cleared.
+ * @param max_events The maximum number of events to return.
+ * @param timeout A timeout for the whole wait in milliseconds, or -1 for infinity.
+ * @return Whether or not the wait proceeded without errors.
+ */
+bool BusyPoller::wait(std::vector<EpollEvent>& events, int max_events, int timeout)
+{
+	size_t before = events.size();
+
+	if (_budget_ns > 0 && timeout != 0) {
+		uint64_t start = metrics::now();
+		uint64_t spin_until = start + _budget_ns;
+
+		if (timeout > 0) {
+			spin_until = std::min(spin_until, start + (uint64_t)timeout * 1000000);
+		}
+
+		uint64_t now = start;
+
+		do {
+			if (!_epoll.wait(events, max_events, 0)) {
+				return false;
+			}
+
+			now = metrics::now();
+
+			if (events.size() > before) {
+				_statistics.useful_spins++;
+				_statistics.spin_wakeups++;
+				_statistics.spin_ns += now - start;
+
+				return true;
+			}
+
+			_statistics.wasted_spins++;
+		} while (now < spin_until);
+
+		_statistics.budget_exhausted++;
+		_statistics.spin_ns += now - start;
+
+		if (timeout > 0) {
+			timeout = std::max(0, timeout - (int)((now - start) / 1000000));
+		}
+	}
+
+	if (!_epoll.wait(events, max_events, timeout)) {
+		return false;
+	}
+
+	if (events.size() > before) {
+		_statistics.blocking_wakeups++;
+	}
+
+	return true;
+}
+
+void BusyPoller::reset()
+{
+	_statistics = BusyPollStatistics { 0, 0, 0, 0, 0, 0 };
+}
+
+std::string BusyPollStatistics::to_string() const
+{
+	std::ostringstream out;
+
+	out << "useful_spins " << useful_spins << "\n";
+	out << "wasted_spins " << wasted_spins << "\n";
+	out << "efficiency " << efficiency() << "\n";
+	out << "spin_wakeups " << spin_wakeups << "\n";
+	out << "blocking_wakeups " << blocking_wakeups << "\n";
+	out << "hit_rate " << hit_rate() << "\n";
+	out << "budget_exhausted " << budget_exhausted << "\n";
+	out << "spin_ns " << spin_ns << "\n";
+
+	return out.str();
+}
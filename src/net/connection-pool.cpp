@@ -0,0 +1,282 @@
+/**
+ * src/net/connection-pool.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/net/connection-pool.h>
+#include <sfd/metrics.h>
+
+#include <algorithm>
+#include <errno.h>
+#include <sys/socket.h>
+
+using namespace sfd;
+using namespace sfd::net;
+
+/**
+ * Constructs a new connection pool.  No connections are opened until the pool is attached.
+ * @param ep The endpoint to connect to.  This must outlive the pool.
+ * @param options Sizing and timing parameters for the pool.
+ */
+ConnectionPool::ConnectionPool(const EndPoint& ep, const ConnectionPoolOptions& options)
+	: _ep(ep),
+		_options(options),
+		_epoll(nullptr),
+		_hits(0),
+		_misses(0),
+		_evictions(0),
+		_connect_failures(0),
+		_retry_at(0),
+		_backoff_ns(0)
+{
+	if (_options.max_idle < _options.min_idle) {
+		throw ConnectionPoolException("Maximum idle connections is less than the minimum");
+	}
+}
+
+ConnectionPool::~ConnectionPool()
+{
+	for (auto& connection : _idle) {
+		delete connection.socket;
+	}
+}
+
+/**
+ * Registers the pool with the given epoll instance, and starts opening connections.
+ * @param epoll The epoll instance that will drive this pool.
+ */
+void ConnectionPool::attach(Epoll& epoll)
+{
+	_epoll = &epoll;
+
+	_connector.attach(epoll);
+	_epoll->add(&_maintenance, EpollEventType::IN);
+	_maintenance.arm(_options.maintenance_interval_ns, _options.maintenance_interval_ns);
+
+	for (auto& connection : _idle) {
+		_epoll->add(connection.socket, EpollEventType::IN | EpollEventType::RDHUP);
+	}
+
+	replenish();
+}
+
+/**
+ * Removes the pool, and its idle connections, from the given epoll instance.  Connection
+ * attempts still in progress are abandoned.
+ * @param epoll The epoll instance the pool was attached to.
+ */
+void ConnectionPool::detach(Epoll& epoll)
+{
+	for (auto& connection : _idle) {
+		epoll.remove(connection.socket);
+	}
+
+	_maintenance.disarm();
+	epoll.remove(&_maintenance);
+
+	_connector.detach(epoll);
+	_epoll = nullptr;
+}
+
+/**
+ * Handles a readiness event, if it belongs to a connection attempt, an idle connection or
+ * the maintenance timer.
+ * @param event The event returned from Epoll::wait.
+ * @return True if the event was consumed by this pool.
+ */
+bool ConnectionPool::handle(const EpollEvent& event)
+{
+	if (_connector.handle(event)) {
+		return true;
+	}
+
+	if (event.fd == &_maintenance) {
+		_maintenance.acknowledge();
+		maintain();
+		return true;
+	}
+
+	for (auto connection = _idle.begin(); connection != _idle.end(); ++connection) {
+		if (connection->socket == event.fd) {
+			// Nothing should arrive on a connection nobody is using, so readiness means the
+			// peer has closed it or the stream is no longer in a known state.
+			evict(connection);
+			replenish();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Takes an established connection from the pool.  The most recently released connection is
+ * handed out first.
+ * @return A connected socket, which the caller owns until it is passed back to release, or
+ * NULL if no healthy connection is idle.  A miss causes the pool to open more connections.
+ */
+Socket *ConnectionPool::acquire()
+{
+	while (!_idle.empty()) {
+		Socket *socket = _idle.back().socket;
+		_idle.pop_back();
+
+		if (_epoll) {
+			_epoll->remove(socket);
+		}
+
+		if (healthy(socket)) {
+			_hits++;
+			replenish();
+
+			return socket;
+		}
+
+		_evictions++;
+		delete socket;
+	}
+
+	_misses++;
+	replenish();
+
+	return NULL;
+}
+
+/**
+ * Returns a connection to the pool.
+ * @param socket A socket previously obtained from acquire.
+ * @param reusable False if the connection must not be used again (for example, if a request
+ * on it failed part-way through), in which case it is closed.
+ */
+void ConnectionPool::release(Socket *socket, bool reusable)
+{
+	if (!reusable || _idle.size() >= _options.max_idle || !healthy(socket)) {
+		delete socket;
+		replenish();
+
+		return;
+	}
+
+	park(socket);
+}
+
+/**
+ * Starts enough connection attempts to bring the pool up to its minimum number of idle
+ * connections.  After a failed attempt, nothing is started until the backoff period has
+ * passed, however often this is called.
+ */
+void ConnectionPool::replenish()
+{
+	if (!_epoll) {
+		return;
+	}
+
+	if (_retry_at && metrics::now() < _retry_at) {
+		return;
+	}
+
+	// An attempt can fail immediately (e.g. ECONNREFUSED on a Unix socket), without ever
+	// becoming pending, so stop at the first failure rather than trying again straight away.
+	uint64_t failures = _connect_failures;
+
+	while (_idle.size() + _connector.pending() < _options.min_idle && _connect_failures == failures) {
+		Socket *socket = new Socket(_ep.family(), SocketType::Stream, ProtocolType::IP);
+
+		_connector.connect(socket, _ep, _options.connect_timeout_ns,
+			[this](Socket *socket, int error) { connected(socket, error); });
+	}
+}
+
+void ConnectionPool::connected(Socket *socket, int error)
+{
+	if (error) {
+		// Failed attempts are retried by a later maintenance tick, rather than straight
+		// away, so that an unreachable endpoint is not hammered with connection attempts.
+		// The delay doubles with each consecutive failure, up to MaxBackoffIntervals ticks.
+		_connect_failures++;
+		delete socket;
+
+		uint64_t max_backoff_ns = _options.maintenance_interval_ns * MaxBackoffIntervals;
+
+		_backoff_ns = _backoff_ns ? std::min(_backoff_ns * 2, max_backoff_ns) : _options.maintenance_interval_ns;
+		_retry_at = metrics::now() + _backoff_ns;
+
+		return;
+	}
+
+	_backoff_ns = 0;
+	_retry_at = 0;
+
+	if (_idle.size() >= _options.max_idle) {
+		delete socket;
+		return;
+	}
+
+	park(socket);
+}
+
+/**
+ * Adds a connection to the back of the idle list, and watches it for activity.
+ */
+void ConnectionPool::park(Socket *socket)
+{
+	_idle.push_back(IdleConnection { socket, metrics::now() });
+
+	if (_epoll) {
+		_epoll->add(socket, EpollEventType::IN | EpollEventType::RDHUP);
+	}
+}
+
+void ConnectionPool::evict(std::deque<IdleConnection>::iterator connection)
+{
+	if (_epoll) {
+		_epoll->remove(connection->socket);
+	}
+
+	delete connection->socket;
+	_idle.erase(connection);
+
+	_evictions++;
+}
+
+/**
+ * Closes connections that have been idle for too long, and tops the pool back up.
+ */
+void ConnectionPool::maintain()
+{
+	if (_options.max_idle_time_ns) {
+		uint64_t now = metrics::now();
+
+		// The idle list is ordered by release time, so the stalest connections are at the front.
+		while (!_idle.empty() && now - _idle.front().since >= _options.max_idle_time_ns) {
+			evict(_idle.begin());
+		}
+	}
+
+	replenish();
+}
+
+/**
+ * Checks, without blocking or consuming anything, that a connection is still open and has
+ * no unexpected data waiting on it.
+ */
+bool ConnectionPool::healthy(Socket *socket)
+{
+	char probe;
+
+	int rc = ::recv(socket->fd(), &probe, sizeof(probe), MSG_PEEK | MSG_DONTWAIT);
+	return rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
@@ -0,0 +1,199 @@
+/**
+ * src/net/connector.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/net/connector.h>
+#include <sfd/metrics.h>
+
+#include <errno.h>
+#include <vector>
+#include <algorithm>
+
+using namespace sfd;
+using namespace sfd::net;
+
+Connector::Connector() : _epoll(nullptr)
+{
+}
+
+/**
+ * Destroys the connector.  Attempts that are still in progress are abandoned, and their
+ * sockets are closed without invoking their callbacks.
+ */
+Connector::~Connector()
+{
+	for (auto& attempt : _attempts) {
+		delete attempt.first;
+	}
+}
+
+/**
+ * Registers the connector's deadline timer, and any attempts still in progress from before a
+ * detach, with the given epoll instance.  Attempts can only be started while the connector is
+ * attached.
+ * @param epoll The epoll instance that will drive this connector.
+ */
+void Connector::attach(Epoll& epoll)
+{
+	_epoll = &epoll;
+	_epoll->add(&_timer, EpollEventType::IN);
+
+	// The registrations are level-triggered, so attempts that finished while detached
+	// complete as soon as the loop next waits.
+	for (auto& attempt : _attempts) {
+		_epoll->add(attempt.first, EpollEventType::OUT);
+	}
+
+	arm_timer();
+}
+
+/**
+ * Removes the connector, and any attempts in progress, from the given epoll instance.  The
+ * attempts are kept, and carry on when the connector is attached again.
+ * @param epoll The epoll instance the connector was attached to.
+ */
+void Connector::detach(Epoll& epoll)
+{
+	for (auto& attempt : _attempts) {
+		epoll.remove(attempt.first);
+	}
+
+	epoll.remove(&_timer);
+	_epoll = nullptr;
+}
+
+/**
+ * Starts a connection attempt.  The callback is invoked from handle (or immediately, if the
+ * attempt finishes straight away) when the attempt succeeds, fails or times out.
+ * @param socket The socket to connect.  The connector owns it until the callback is invoked.
+ * @param ep The endpoint to connect to.
+ * @param timeout_ns How long the attempt may take, in nanoseconds.
+ * @param callback Invoked with the outcome of the attempt.
+ */
+void Connector::connect(Socket *socket, const EndPoint& ep, uint64_t timeout_ns, const ConnectCallback& callback)
+{
+	if (!_epoll) {
+		throw ConnectorException("Connector is not attached");
+	}
+
+	bool connected;
+
+	try {
+		connected = socket->begin_connect(ep);
+	} catch (const SocketException&) {
+		callback(socket, errno ? errno : EINVAL);
+		return;
+	}
+
+	if (connected) {
+		callback(socket, 0);
+		return;
+	}
+
+	_attempts[socket] = Attempt { metrics::now() + timeout_ns, callback };
+	_epoll->add(socket, EpollEventType::OUT);
+
+	arm_timer();
+}
+
+/**
+ * Handles a readiness event, if it belongs to one of the attempts in progress or to the
+ * deadline timer.
+ * @param event The event returned from Epoll::wait.
+ * @return True if the event was consumed by this connector.
+ */
+bool Connector::handle(const EpollEvent& event)
+{
+	if (event.fd == &_timer) {
+		_timer.acknowledge();
+		expire();
+		return true;
+	}
+
+	Socket *socket = static_cast<Socket *>(event.fd);
+	if (_attempts.find(socket) == _attempts.end()) {
+		return false;
+	}
+
+	int error;
+
+	try {
+		error = socket->finish_connect();
+	} catch (const SocketException&) {
+		error = errno;
+	}
+
+	complete(socket, error);
+	return true;
+}
+
+/**
+ * Finishes an attempt, and hands the socket to its callback.
+ */
+void Connector::complete(Socket *socket, int error)
+{
+	auto attempt = _attempts.find(socket);
+
+	ConnectCallback callback = std::move(attempt->second.callback);
+	_attempts.erase(attempt);
+
+	_epoll->remove(socket);
+
+	// The callback may start new attempts, so it is invoked only once the attempt has been
+	// forgotten.
+	callback(socket, error);
+}
+
+/**
+ * Fails every attempt whose deadline has passed.
+ */
+void Connector::expire()
+{
+	uint64_t now = metrics::now();
+	std::vector<Socket *> expired;
+
+	for (auto& attempt : _attempts) {
+		if (attempt.second.deadline <= now) {
+			expired.push_back(attempt.first);
+		}
+	}
+
+	for (Socket *socket : expired) {
+		complete(socket, ETIMEDOUT);
+	}
+
+	arm_timer();
+}
+
+/**
+ * Arms the deadline timer for the earliest deadline of the attempts in progress.
+ */
+void Connector::arm_timer()
+{
+	if (_attempts.empty()) {
+		_timer.disarm();
+		return;
+	}
+
+	uint64_t earliest = UINT64_MAX;
+	for (auto& attempt : _attempts) {
+		earliest = std::min(earliest, attempt.second.deadline);
+	}
+
+	uint64_t now = metrics::now();
+	_timer.arm(earliest > now ? earliest - now : 1);
+}
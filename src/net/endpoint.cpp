@@ -23,6 +23,7 @@
 #include <malloc.h>
 #include <netinet/in.h>
 #include <sys/un.h>
+#include <string.h>
 
 #include <bluetooth/bluetooth.h>
 #include <bluetooth/l2cap.h>
@@ -46,6 +47,11 @@ const EndPoint *EndPoint::from_sockaddr(const struct sockaddr *sa)
 		// Create an IPEndPoint
 		const struct sockaddr_in *sa_in = (const struct sockaddr_in *)sa;
 		return new IPEndPoint(IPAddress(ntohl(sa_in->sin_addr.s_addr)), ntohs(sa_in->sin_port));
+	} else if (sa->sa_family == AF_UNIX) {
+		// Create a UnixEndPoint.  Unnamed sockets (such as the client end of a connection)
+		// have an empty path.
+		const struct sockaddr_un *sa_un = (const struct sockaddr_un *)sa;
+		return new UnixEndPoint(std::string(sa_un->sun_path, strnlen(sa_un->sun_path, sizeof(sa_un->sun_path))));
 	} else if (sa->sa_family == AF_BLUETOOTH) {
 		// TODO: We need to determine which bluetooth protocol we're using
 		const struct sockaddr_l2 *sa_l2 = (const struct sockaddr_l2 *)sa;
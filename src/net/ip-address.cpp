@@ -0,0 +1,138 @@
+/**
+ * src/net/ip-address.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/net/ip-address.h>
+
+#include <array>
+#include <cstring>
+
+using namespace sfd::net;
+
+namespace {
+	/**
+	 * The decimal text of an octet, padded to four bytes so that it can be copied with a
+	 * single unaligned store.
+	 */
+	struct OctetText {
+		char digits[3];
+		uint8_t length;
+	};
+
+	constexpr std::array<OctetText, 256> make_octet_table()
+	{
+		std::array<OctetText, 256> table {};
+
+		for (unsigned int i = 0; i < 256; i++) {
+			OctetText& entry = table[i];
+
+			if (i >= 100) {
+				entry.digits[0] = '0' + i / 100;
+				entry.digits[1] = '0' + (i / 10) % 10;
+				entry.digits[2] = '0' + i % 10;
+				entry.length = 3;
+			} else if (i >= 10) {
+				entry.digits[0] = '0' + i / 10;
+				entry.digits[1] = '0' + i % 10;
+				entry.length = 2;
+			} else {
+				entry.digits[0] = '0' + i;
+				entry.length = 1;
+			}
+		}
+
+		return table;
+	}
+
+	constexpr std::array<OctetText, 256> octet_table = make_octet_table();
+}
+
+/**
+ * Writes the dotted-decimal form of this address into the given buffer.  No terminator is
+ * written, and no memory is allocated.
+ * @param buffer The buffer to write into, which must hold at least MaxStringLength bytes.
+ * @return The number of characters written.
+ */
+size_t IPAddress::format_to(char *buffer) const
+{
+	char *p = buffer;
+
+	// The first three octets are each followed by a dot, which overwrites the padding byte
+	// of the copied entry, so a whole entry can be stored without bounds checks.
+	for (int shift = 24; shift > 0; shift -= 8) {
+		const OctetText& entry = octet_table[(_address >> shift) & 0xff];
+
+		memcpy(p, &entry, sizeof(entry));
+		p += entry.length;
+		*p++ = '.';
+	}
+
+	const OctetText& last = octet_table[_address & 0xff];
+	memcpy(p, last.digits, last.length);
+	p += last.length;
+
+	return p - buffer;
+}
+
+/**
+ * Parses an address in strict dotted-decimal form: exactly four decimal octets, each in the
+ * range 0-255 and without leading zeros.  This is the form accepted by inet_pton.
+ * @param text The text to parse.
+ * @param address Receives the parsed address.  Unchanged if the text is not valid.
+ * @return True if the text was a valid address.
+ */
+bool IPAddress::parse(std::string_view text, IPAddress& address)
+{
+	if (text.size() < 7 || text.size() > MaxStringLength) {
+		return false;
+	}
+
+	const char *p = text.data();
+	const char *end = p + text.size();
+	uint32_t value = 0;
+
+	for (int octet = 0; octet < 4; octet++) {
+		if (octet > 0) {
+			if (p == end || *p != '.') {
+				return false;
+			}
+
+			p++;
+		}
+
+		const char *start = p;
+		unsigned int part = 0;
+
+		while (p < end && p - start < 4 && (unsigned char)(*p - '0') < 10) {
+			part = part * 10 + (*p - '0');
+			p++;
+		}
+
+		if (p == start || p - start > 3 || part > 255 || (p - start > 1 && *start == '0')) {
+			return false;
+		}
+
+		value = (value << 8) | part;
+	}
+
+	if (p != end) {
+		return false;
+	}
+
+	address._address = value;
+	return true;
+}
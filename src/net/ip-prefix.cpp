@@ -0,0 +1,173 @@
+/**
+ * src/net/ip-prefix.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/net/ip-prefix.h>
+
+using namespace sfd::net;
+
+namespace {
+	/**
+	 * Parses a prefix length of one to three decimal digits, without leading zeros.
+	 */
+	bool parse_length(std::string_view text, unsigned int max, unsigned int& length)
+	{
+		if (text.empty() || text.size() > 3 || (text.size() > 1 && text[0] == '0')) {
+			return false;
+		}
+
+		unsigned int value = 0;
+		for (char c : text) {
+			if ((unsigned char)(c - '0') >= 10) {
+				return false;
+			}
+
+			value = value * 10 + (c - '0');
+		}
+
+		if (value > max) {
+			return false;
+		}
+
+		length = value;
+		return true;
+	}
+
+	size_t format_length(char *buffer, unsigned int length)
+	{
+		char *p = buffer;
+
+		*p++ = '/';
+		if (length >= 100) *p++ = '0' + length / 100;
+		if (length >= 10) *p++ = '0' + (length / 10) % 10;
+		*p++ = '0' + length % 10;
+
+		return p - buffer;
+	}
+}
+
+/**
+ * Constructs a prefix, clearing any host bits of the given address.
+ * @param address An address within the network.
+ * @param length The number of leading bits that identify the network (0-32).
+ */
+IPPrefix::IPPrefix(const IPAddress& address, unsigned int length) : _address(address), _length(length)
+{
+	if (length > AddressBits) {
+		throw IPPrefixException("Invalid IPv4 prefix length");
+	}
+
+	_address = IPAddress(length ? address.address() & (0xffffffffu << (AddressBits - length)) : 0);
+}
+
+/**
+ * Writes the prefix in CIDR notation (e.g. "10.0.0.0/8") into the given buffer.  No
+ * terminator is written, and no memory is allocated.
+ * @param buffer The buffer to write into, which must hold at least MaxStringLength bytes.
+ * @return The number of characters written.
+ */
+size_t IPPrefix::format_to(char *buffer) const
+{
+	size_t length = _address.format_to(buffer);
+	return length + format_length(buffer + length, _length);
+}
+
+/**
+ * Parses a prefix in CIDR notation.  An address without a length is treated as a host (/32)
+ * prefix, and host bits are cleared.
+ * @param text The text to parse.
+ * @param prefix Receives the parsed prefix.  Unchanged if the text is not valid.
+ * @return True if the text was a valid prefix.
+ */
+bool IPPrefix::parse(std::string_view text, IPPrefix& prefix)
+{
+	size_t slash = text.find('/');
+	unsigned int length = AddressBits;
+	IPAddress address = IPAddress::any();
+
+	if (!IPAddress::parse(text.substr(0, slash), address)) {
+		return false;
+	}
+
+	if (slash != std::string_view::npos && !parse_length(text.substr(slash + 1), AddressBits, length)) {
+		return false;
+	}
+
+	prefix = IPPrefix(address, length);
+	return true;
+}
+
+/**
+ * Constructs a prefix, clearing any host bits of the given address.
+ * @param address An address within the network.
+ * @param length The number of leading bits that identify the network (0-128).
+ */
+IPv6Prefix::IPv6Prefix(const IPv6Address& address, unsigned int length) : _address(address), _length(length)
+{
+	if (length > AddressBits) {
+		throw IPPrefixException("Invalid IPv6 prefix length");
+	}
+
+	IPv6Address::AddressStorageType storage = address.address();
+
+	for (unsigned int i = 0; i < storage.size(); i++) {
+		if (length >= (i + 1) * 8) {
+			continue;
+		}
+
+		storage[i] &= (length > i * 8) ? (uint8_t)(0xff << (8 - (length - i * 8))) : 0;
+	}
+
+	_address = IPv6Address(storage);
+}
+
+/**
+ * Writes the prefix in CIDR notation (e.g. "2001:db8::/32") into the given buffer.  No
+ * terminator is written, and no memory is allocated.
+ * @param buffer The buffer to write into, which must hold at least MaxStringLength bytes.
+ * @return The number of characters written.
+ */
+size_t IPv6Prefix::format_to(char *buffer) const
+{
+	size_t length = _address.format_to(buffer);
+	return length + format_length(buffer + length, _length);
+}
+
+/**
+ * Parses a prefix in CIDR notation.  An address without a length is treated as a host (/128)
+ * prefix, and host bits are cleared.
+ * @param text The text to parse.
+ * @param prefix Receives the parsed prefix.  Unchanged if the text is not valid.
+ * @return True if the text was a valid prefix.
+ */
+bool IPv6Prefix::parse(std::string_view text, IPv6Prefix& prefix)
+{
+	size_t slash = text.find('/');
+	unsigned int length = AddressBits;
+	IPv6Address address = IPv6Address::any();
+
+	if (!IPv6Address::parse(text.substr(0, slash), address)) {
+		return false;
+	}
+
+	if (slash != std::string_view::npos && !parse_length(text.substr(slash + 1), AddressBits, length)) {
+		return false;
+	}
+
+	prefix = IPv6Prefix(address, length);
+	return true;
+}
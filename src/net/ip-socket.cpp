@@ -32,5 +32,78 @@ IPSocket::IPSocket(SocketType::SocketType type, ProtocolType::ProtocolType proto
 
 void IPSocket::multicast_loopback(bool enable)
 {
-	set_option(IPPROTO_IP, IP_MULTICAST_LOOP, enable);
+	set_option<int>(IPPROTO_IP, IP_MULTICAST_LOOP, enable ? 1 : 0);
+}
+
+/**
+ * Joins a multicast group, so that datagrams sent to the group are delivered to this socket.
+ * @param group The multicast group to join.
+ * @param interface The address of the local interface to join the group on, or any to let
+ * the kernel choose one from the routing table.
+ */
+void IPSocket::join_group(const IPAddress& group, const IPAddress& interface)
+{
+	struct ip_mreq request;
+	request.imr_multiaddr.s_addr = htonl(group.address());
+	request.imr_interface.s_addr = htonl(interface.address());
+
+	try {
+		set_option_raw(IPPROTO_IP, IP_ADD_MEMBERSHIP, &request, sizeof(request));
+	} catch (const SocketException& ex) {
+		throw SocketException("Unable to join multicast group " + group.to_string(), ex);
+	}
+}
+
+/**
+ * Leaves a multicast group previously joined with join_group.
+ */
+void IPSocket::leave_group(const IPAddress& group, const IPAddress& interface)
+{
+	struct ip_mreq request;
+	request.imr_multiaddr.s_addr = htonl(group.address());
+	request.imr_interface.s_addr = htonl(interface.address());
+
+	try {
+		set_option_raw(IPPROTO_IP, IP_DROP_MEMBERSHIP, &request, sizeof(request));
+	} catch (const SocketException& ex) {
+		throw SocketException("Unable to leave multicast group " + group.to_string(), ex);
+	}
+}
+
+/**
+ * Joins a source-specific multicast group, so that only datagrams sent to the group by the
+ * given source are delivered to this socket.
+ * @param group The multicast group to join.
+ * @param source The address of the sender to accept datagrams from.
+ * @param interface The address of the local interface to join the group on, or any.
+ */
+void IPSocket::join_source_group(const IPAddress& group, const IPAddress& source, const IPAddress& interface)
+{
+	struct ip_mreq_source request;
+	request.imr_multiaddr.s_addr = htonl(group.address());
+	request.imr_sourceaddr.s_addr = htonl(source.address());
+	request.imr_interface.s_addr = htonl(interface.address());
+
+	try {
+		set_option_raw(IPPROTO_IP, IP_ADD_SOURCE_MEMBERSHIP, &request, sizeof(request));
+	} catch (const SocketException& ex) {
+		throw SocketException("Unable to join multicast group " + group.to_string() + " from " + source.to_string(), ex);
+	}
+}
+
+/**
+ * Leaves a source-specific multicast group previously joined with join_source_group.
+ */
+void IPSocket::leave_source_group(const IPAddress& group, const IPAddress& source, const IPAddress& interface)
+{
+	struct ip_mreq_source request;
+	request.imr_multiaddr.s_addr = htonl(group.address());
+	request.imr_sourceaddr.s_addr = htonl(source.address());
+	request.imr_interface.s_addr = htonl(interface.address());
+
+	try {
+		set_option_raw(IPPROTO_IP, IP_DROP_SOURCE_MEMBERSHIP, &request, sizeof(request));
+	} catch (const SocketException& ex) {
+		throw SocketException("Unable to leave multicast group " + group.to_string() + " from " + source.to_string(), ex);
+	}
 }
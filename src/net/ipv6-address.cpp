@@ -0,0 +1,272 @@
+/**
+ * src/net/ipv6-address.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/net/ipv6-address.h>
+
+#include <cstring>
+
+using namespace sfd::net;
+
+namespace {
+	const char hex_digits[] = "0123456789abcdef";
+
+	constexpr std::array<uint8_t, 256> make_hex_value_table()
+	{
+		std::array<uint8_t, 256> table {};
+
+		for (unsigned int i = 0; i < 256; i++) {
+			if (i >= '0' && i <= '9') {
+				table[i] = i - '0';
+			} else if (i >= 'a' && i <= 'f') {
+				table[i] = i - 'a' + 10;
+			} else if (i >= 'A' && i <= 'F') {
+				table[i] = i - 'A' + 10;
+			} else {
+				table[i] = 0xff;
+			}
+		}
+
+		return table;
+	}
+
+	constexpr std::array<uint8_t, 256> hex_value_table = make_hex_value_table();
+
+	inline char *format_group(char *p, uint16_t value)
+	{
+		if (value >= 0x1000) *p++ = hex_digits[value >> 12];
+		if (value >= 0x100) *p++ = hex_digits[(value >> 8) & 0xf];
+		if (value >= 0x10) *p++ = hex_digits[(value >> 4) & 0xf];
+		*p++ = hex_digits[value & 0xf];
+
+		return p;
+	}
+}
+
+/**
+ * Returns true if this is an IPv4-mapped address (::ffff:a.b.c.d).
+ */
+bool IPv6Address::is_v4_mapped() const
+{
+	static const uint8_t prefix[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff };
+	return memcmp(_address.data(), prefix, sizeof(prefix)) == 0;
+}
+
+/**
+ * Returns the IPv4 address held in the low 32 bits of this address.  This is only meaningful
+ * if the address is IPv4-mapped.
+ */
+IPAddress IPv6Address::to_v4() const
+{
+	return IPAddress::from_octets(_address[12], _address[13], _address[14], _address[15]);
+}
+
+/**
+ * Constructs an address from its eight 16-bit groups, most significant first.
+ */
+IPv6Address IPv6Address::from_groups(uint16_t a, uint16_t b, uint16_t c, uint16_t d, uint16_t e, uint16_t f, uint16_t g, uint16_t h)
+{
+	uint16_t groups[8] = { a, b, c, d, e, f, g, h };
+	AddressStorageType address;
+
+	for (int i = 0; i < 8; i++) {
+		address[i * 2] = groups[i] >> 8;
+		address[i * 2 + 1] = groups[i] & 0xff;
+	}
+
+	return IPv6Address(address);
+}
+
+/**
+ * Constructs the IPv4-mapped address (::ffff:a.b.c.d) for the given IPv4 address.
+ */
+IPv6Address IPv6Address::from_v4(const IPAddress& address)
+{
+	AddressStorageType storage {};
+
+	storage[10] = 0xff;
+	storage[11] = 0xff;
+	address.to_octets(storage[12], storage[13], storage[14], storage[15]);
+
+	return IPv6Address(storage);
+}
+
+/**
+ * Writes the canonical (RFC 5952) form of this address into the given buffer: lower-case hex
+ * groups without leading zeros, with the longest run of two or more zero groups compressed to
+ * "::", and with IPv4-mapped addresses in mixed notation.  No terminator is written, and no
+ * memory is allocated.
+ * @param buffer The buffer to write into, which must hold at least MaxStringLength bytes.
+ * @return The number of characters written.
+ */
+size_t IPv6Address::format_to(char *buffer) const
+{
+	char *p = buffer;
+
+	if (is_v4_mapped()) {
+		memcpy(p, "::ffff:", 7);
+		return 7 + to_v4().format_to(p + 7);
+	}
+
+	uint16_t groups[8];
+	for (int i = 0; i < 8; i++) {
+		groups[i] = group(i);
+	}
+
+	// Find the longest run of zero groups, preferring the first if there is a tie.  A single
+	// zero group is never compressed.
+	int best_start = -1, best_length = 1;
+	for (int i = 0; i < 8;) {
+		if (groups[i] != 0) {
+			i++;
+			continue;
+		}
+
+		int j = i;
+		while (j < 8 && groups[j] == 0) {
+			j++;
+		}
+
+		if (j - i > best_length) {
+			best_start = i;
+			best_length = j - i;
+		}
+
+		i = j;
+	}
+
+	for (int i = 0; i < 8; i++) {
+		if (i == best_start) {
+			*p++ = ':';
+			*p++ = ':';
+			i += best_length - 1;
+			continue;
+		}
+
+		if (i > 0 && i != best_start + best_length) {
+			*p++ = ':';
+		}
+
+		p = format_group(p, groups[i]);
+	}
+
+	return p - buffer;
+}
+
+/**
+ * Parses an address in strict textual form: colon-separated groups of one to four hex digits,
+ * with at most one "::" standing for one or more zero groups, and optionally ending in a
+ * dotted-decimal IPv4 address in place of the last two groups.  Zone identifiers ("%eth0")
+ * are not accepted.
+ * @param text The text to parse.
+ * @param address Receives the parsed address.  Unchanged if the text is not valid.
+ * @return True if the text was a valid address.
+ */
+bool IPv6Address::parse(std::string_view text, IPv6Address& address)
+{
+	if (text.size() < 2 || text.size() > MaxStringLength) {
+		return false;
+	}
+
+	const char *begin = text.data();
+	const char *p = begin;
+	const char *end = begin + text.size();
+
+	uint16_t groups[8];
+	int count = 0, gap = -1;
+
+	if (*p == ':') {
+		if (p[1] != ':') {
+			return false;
+		}
+
+		gap = 0;
+		p += 2;
+	}
+
+	while (p < end) {
+		const char *start = p;
+		unsigned int value = 0;
+
+		while (p < end && p - start < 4 && hex_value_table[(unsigned char)*p] != 0xff) {
+			value = (value << 4) | hex_value_table[(unsigned char)*p];
+			p++;
+		}
+
+		if (p < end && *p == '.') {
+			// An embedded IPv4 address occupies the last two groups.
+			IPAddress v4 = IPAddress::any();
+			if (count > 6 || !IPAddress::parse(std::string_view(start, end - start), v4)) {
+				return false;
+			}
+
+			groups[count++] = v4.address() >> 16;
+			groups[count++] = v4.address() & 0xffff;
+			p = end;
+			break;
+		}
+
+		if (p == start || count == 8) {
+			return false;
+		}
+
+		groups[count++] = value;
+
+		if (p == end) {
+			break;
+		}
+
+		if (*p++ != ':') {
+			return false;
+		}
+
+		if (p < end && *p == ':') {
+			if (gap >= 0) {
+				return false;
+			}
+
+			gap = count;
+			p++;
+		} else if (p == end) {
+			return false;
+		}
+	}
+
+	AddressStorageType storage {};
+
+	if (gap < 0) {
+		if (count != 8) {
+			return false;
+		}
+
+		gap = count;
+	} else if (count == 8) {
+		return false;
+	}
+
+	// Groups before the gap are placed at the start of the address, and those after it at
+	// the end, leaving the compressed zero groups in between.
+	for (int i = 0; i < count; i++) {
+		int index = (i < gap) ? i : 8 - count + i;
+
+		storage[index * 2] = groups[i] >> 8;
+		storage[index * 2 + 1] = groups[i] & 0xff;
+	}
+
+	address._address = storage;
+	return true;
+}
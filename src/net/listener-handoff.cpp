@@ -0,0 +1,294 @@
+/**
+ * src/net/listener-handoff.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/net/listener-handoff.h>
+#include <sfd/metrics.h>
+
+#include <string.h>
+#include <unistd.h>
+
+using namespace sfd;
+using namespace sfd::net;
+
+namespace {
+	const uint32_t HandoffMagic = 0x48444653;	// "SFDH"
+	const uint16_t HandoffVersion = 1;
+	const size_t MaxHandoffMessage = 65536;
+
+	enum HandoffMessageType {
+		REQUEST = 1,
+		OFFER = 2,
+		LISTENER = 3,
+		ACK = 4
+	};
+
+	/**
+	 * Prefixes every message of the handoff protocol.  Each message is a single datagram on a
+	 * SOCK_SEQPACKET socket, and a LISTENER message carries exactly one file descriptor.
+	 */
+	struct HandoffHeader {
+		uint32_t magic;
+		uint16_t version;
+		uint16_t type;
+		uint32_t count;
+		uint32_t name_length;
+		uint32_t metadata_length;
+	};
+
+	HandoffHeader make_header(HandoffMessageType type)
+	{
+		HandoffHeader header;
+		bzero(&header, sizeof(header));
+
+		header.magic = HandoffMagic;
+		header.version = HandoffVersion;
+		header.type = type;
+
+		return header;
+	}
+
+	void send_header(UnixSocket& socket, HandoffMessageType type, uint32_t count = 0)
+	{
+		HandoffHeader header = make_header(type);
+		header.count = count;
+
+		socket.send_with_fds(&header, sizeof(header), std::vector<FileDescriptor::NativeFD>());
+	}
+
+	bool valid_header(const HandoffHeader& header, size_t length, HandoffMessageType type)
+	{
+		return length >= sizeof(header) && header.magic == HandoffMagic && header.version == HandoffVersion && header.type == type;
+	}
+
+	/**
+	 * Limits the next blocking send or receive on the connection to whatever remains before
+	 * the deadline.
+	 */
+	void bound(UnixSocket& connection, uint64_t deadline)
+	{
+		uint64_t now = metrics::now();
+		if (now >= deadline) {
+			throw ListenerHandoffException("Handoff timed out");
+		}
+
+		unsigned int remaining_ms = (unsigned int)((deadline - now + 999999) / 1000000);
+		connection.receive_timeout(remaining_ms);
+		connection.send_timeout(remaining_ms);
+	}
+}
+
+/**
+ * Creates the handoff endpoint.  Any stale socket file at the endpoint's path is replaced.
+ * @param ep The Unix endpoint that a replacement process will connect to.
+ * @param timeout_ms How long a replacement may take to complete the handshake once it has
+ * connected, before the handoff is abandoned.
+ */
+ListenerHandoffServer::ListenerHandoffServer(const UnixEndPoint& ep, unsigned int timeout_ms)
+	: _path(ep.path()), _socket(SocketType::SeqPacket), _timeout_ms(timeout_ms), _handed_off(false)
+{
+	::unlink(_path.c_str());
+
+	_socket.bind(ep);
+	_socket.listen(4);
+
+	// A spurious readiness event must not leave serve blocked in accept.
+	_socket.non_blocking(true);
+}
+
+ListenerHandoffServer::~ListenerHandoffServer()
+{
+	// After a handoff, the path belongs to the replacement process.
+	if (!_handed_off) {
+		::unlink(_path.c_str());
+	}
+}
+
+/**
+ * Adds a listening socket to the set handed to a replacement process.
+ * @param name A name identifying the listener to the replacement process.
+ * @param listener The listening socket.
+ * @param metadata Optional opaque data to pass along with the listener (e.g. its configuration).
+ */
+void ListenerHandoffServer::offer(const std::string& name, Socket& listener, const std::string& metadata)
+{
+	if (name.size() + metadata.size() + sizeof(HandoffHeader) > MaxHandoffMessage) {
+		throw ListenerHandoffException("Listener name and metadata too large to hand off");
+	}
+
+	_offers.push_back({ name, metadata, &listener });
+}
+
+/**
+ * Handles a readiness event, if it belongs to the handoff endpoint, by serving the pending
+ * handoff request.  Check handed_off() afterwards.
+ * @param event The event returned from Epoll::wait.
+ * @return True if the event was consumed by the handoff endpoint.
+ */
+bool ListenerHandoffServer::handle(const EpollEvent& event)
+{
+	if (event.fd != &_socket) {
+		return false;
+	}
+
+	serve();
+	return true;
+}
+
+/**
+ * Accepts a handoff request, and hands the offered listeners to the requesting process.  This
+ * never blocks for longer than the handoff timeout.
+ * @return True if the listeners were handed off and acknowledged.  If the handoff fails or
+ * times out part way through, this process still owns its listeners and should carry on
+ * serving.
+ */
+bool ListenerHandoffServer::serve()
+{
+	UnixSocket *connection = _socket.accept();
+	if (!connection) {
+		return false;
+	}
+
+	try {
+		handoff(*connection);
+	} catch (const Exception&) {
+		delete connection;
+		return false;
+	}
+
+	delete connection;
+
+	_handed_off = true;
+	return true;
+}
+
+void ListenerHandoffServer::handoff(UnixSocket& connection)
+{
+	std::vector<char> buffer(MaxHandoffMessage);
+	std::vector<FileDescriptor::NativeFD> fds;
+	uint64_t deadline = metrics::now() + (uint64_t)_timeout_ms * 1000000;
+
+	// Wait for the request.
+	bound(connection, deadline);
+	size_t length = connection.recv_with_fds(buffer.data(), buffer.size(), fds);
+	for (FileDescriptor::NativeFD unexpected : fds) {
+		::close(unexpected);
+	}
+
+	if (!valid_header(*(const HandoffHeader *)buffer.data(), length, REQUEST)) {
+		throw ListenerHandoffException("Invalid handoff request");
+	}
+
+	// Announce how many listeners follow, and then send each one with its descriptor.
+	bound(connection, deadline);
+	send_header(connection, OFFER, (uint32_t)_offers.size());
+
+	for (const Offer& offer : _offers) {
+		HandoffHeader header = make_header(LISTENER);
+		header.name_length = (uint32_t)offer.name.size();
+		header.metadata_length = (uint32_t)offer.metadata.size();
+
+		memcpy(buffer.data(), &header, sizeof(header));
+		memcpy(buffer.data() + sizeof(header), offer.name.data(), offer.name.size());
+		memcpy(buffer.data() + sizeof(header) + offer.name.size(), offer.metadata.data(), offer.metadata.size());
+
+		bound(connection, deadline);
+		connection.send_with_fds(buffer.data(), sizeof(header) + offer.name.size() + offer.metadata.size(),
+			std::vector<FileDescriptor::NativeFD>(1, offer.listener->fd()));
+	}
+
+	// Only once the replacement has taken every listener is the handoff complete.
+	fds.clear();
+	bound(connection, deadline);
+	length = connection.recv_with_fds(buffer.data(), buffer.size(), fds);
+	for (FileDescriptor::NativeFD unexpected : fds) {
+		::close(unexpected);
+	}
+
+	if (!valid_header(*(const HandoffHeader *)buffer.data(), length, ACK)) {
+		throw ListenerHandoffException("Handoff was not acknowledged");
+	}
+}
+
+/**
+ * Constructs a client for the handoff endpoint of a running process.
+ * @param ep The Unix endpoint the running process is offering its listeners on.
+ */
+ListenerHandoffClient::ListenerHandoffClient(const UnixEndPoint& ep) : _endpoint(ep.path())
+{
+}
+
+/**
+ * Requests the listening sockets of the running process.  When this returns, the running
+ * process has been told that the handoff is complete, and will stop accepting connections.
+ * @return The listeners, which are owned by the caller.
+ */
+std::vector<HandoffListener> ListenerHandoffClient::request()
+{
+	std::vector<HandoffListener> listeners;
+	std::vector<char> buffer(MaxHandoffMessage);
+	std::vector<FileDescriptor::NativeFD> fds;
+
+	try {
+		UnixSocket connection(SocketType::SeqPacket);
+		connection.connect(_endpoint);
+
+		send_header(connection, REQUEST);
+
+		size_t length = connection.recv_with_fds(buffer.data(), buffer.size(), fds);
+		if (!valid_header(*(const HandoffHeader *)buffer.data(), length, OFFER) || !fds.empty()) {
+			throw ListenerHandoffException("Invalid handoff offer");
+		}
+
+		uint32_t count = ((const HandoffHeader *)buffer.data())->count;
+
+		for (uint32_t i = 0; i < count; i++) {
+			fds.clear();
+			length = connection.recv_with_fds(buffer.data(), buffer.size(), fds);
+
+			const HandoffHeader *header = (const HandoffHeader *)buffer.data();
+			if (!valid_header(*header, length, LISTENER) || fds.size() != 1 ||
+					sizeof(*header) + header->name_length + header->metadata_length > length) {
+				throw ListenerHandoffException("Invalid handoff listener");
+			}
+
+			const char *name = buffer.data() + sizeof(*header);
+
+			HandoffListener listener;
+			listener.name = std::string(name, header->name_length);
+			listener.metadata = std::string(name + header->name_length, header->metadata_length);
+			listener.socket = Socket::adopt(fds[0]);
+			fds.clear();
+
+			listeners.push_back(listener);
+		}
+
+		send_header(connection, ACK);
+	} catch (const Exception& ex) {
+		for (FileDescriptor::NativeFD fd : fds) {
+			::close(fd);
+		}
+
+		for (HandoffListener& listener : listeners) {
+			delete listener.socket;
+		}
+
+		throw ListenerHandoffException("Listener handoff failed: " + ex.message());
+	}
+
+	return listeners;
+}
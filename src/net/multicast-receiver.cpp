@@ -0,0 +1,381 @@
+/**
+ * src/net/multicast-receiver.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/net/multicast-receiver.h>
+#include <sfd/net/ip-endpoint.h>
+#include <sfd/metrics.h>
+
+#include <errno.h>
+#include <string.h>
+#include <sstream>
+
+using namespace sfd;
+using namespace sfd::net;
+
+/**
+ * Creates a new multicast receiver, with no groups.
+ * @param handler Invoked with every datagram received.
+ * @param batch_size The most datagrams to receive in one recvmmsg call.
+ * @param max_datagram The largest datagram expected.  Longer datagrams are truncated.
+ */
+MulticastReceiver::MulticastReceiver(const PacketHandler& handler, unsigned int batch_size, size_t max_datagram)
+	: _handler(handler),
+		_batch_size(batch_size),
+		_max_datagram(max_datagram),
+		_buffers(batch_size * max_datagram),
+		_control(batch_size * CMSG_SPACE(sizeof(uint32_t))),
+		_iovecs(batch_size),
+		_messages(batch_size),
+		_rate_since(0),
+		_receive_calls(0),
+		_received(0)
+{
+}
+
+MulticastReceiver::~MulticastReceiver()
+{
+	for (Group *group : _groups) {
+		delete group;
+	}
+}
+
+/**
+ * Joins a multicast group, and starts receiving from it.
+ * @param group The multicast group to join.
+ * @param port The UDP port the group's datagrams are sent to.
+ * @param interface The address of the local interface to join the group on, or any.
+ * @param parser Extracts sequence numbers from the group's datagrams, or empty to skip gap
+ * detection for this group.
+ * @return An identifier for the group.
+ */
+MulticastReceiver::GroupID MulticastReceiver::add_group(const IPAddress& group, int port, const IPAddress& interface, const SequenceParser& parser)
+{
+	Group *new_group = new Group(group, parser);
+
+	try {
+		GroupID id = add(new_group, port);
+		new_group->socket.join_group(group, interface);
+
+		return id;
+	} catch (const SocketException& ex) {
+		_groups.pop_back();
+		delete new_group;
+
+		throw MulticastReceiverException("Unable to add multicast group " + group.to_string() + ": " + ex.message());
+	}
+}
+
+/**
+ * Joins a source-specific multicast group, and starts receiving from it.
+ * @param group The multicast group to join.
+ * @param source The address of the sender to accept datagrams from.
+ * @param port The UDP port the group's datagrams are sent to.
+ * @param interface The address of the local interface to join the group on, or any.
+ * @param parser Extracts sequence numbers from the group's datagrams, or empty.
+ * @return An identifier for the group.
+ */
+MulticastReceiver::GroupID MulticastReceiver::add_source_group(const IPAddress& group, const IPAddress& source, int port,
+	const IPAddress& interface, const SequenceParser& parser)
+{
+	Group *new_group = new Group(group, parser);
+
+	try {
+		GroupID id = add(new_group, port);
+		new_group->socket.join_source_group(group, source, interface);
+
+		return id;
+	} catch (const SocketException& ex) {
+		_groups.pop_back();
+		delete new_group;
+
+		throw MulticastReceiverException("Unable to add multicast group " + group.to_string() + ": " + ex.message());
+	}
+}
+
+/**
+ * Binds a group's socket, and adds it to the receiver.
+ */
+MulticastReceiver::GroupID MulticastReceiver::add(Group *group, int port)
+{
+	_groups.push_back(group);
+
+	group->socket.reuse_address(true);
+	group->socket.non_blocking(true);
+
+	// Ask for the socket's drop counter with every datagram, to tell losses in the kernel (a
+	// full receive buffer) apart from losses upstream.
+	int enable = 1;
+	if (::setsockopt(group->socket.fd(), SOL_SOCKET, SO_RXQ_OVFL, &enable, sizeof(enable)) < 0) {
+		throw SocketException("Unable to enable drop counter");
+	}
+
+	// Binding to the group address, rather than the wildcard, keeps datagrams for other groups
+	// on the same port out of this socket.
+	group->socket.bind(IPEndPoint(group->address, port));
+
+	return (GroupID)(_groups.size() - 1);
+}
+
+/**
+ * Registers every group's socket, and the rate timer, with the given epoll instance.  Groups
+ * must be added before the receiver is attached.
+ * @param epoll The epoll instance that will drive this receiver.
+ */
+void MulticastReceiver::attach(Epoll& epoll)
+{
+	for (Group *group : _groups) {
+		epoll.add(&group->socket, EpollEventType::IN);
+	}
+
+	epoll.add(&_rate_timer, EpollEventType::IN);
+
+	_rate_since = metrics::now();
+	_rate_timer.arm(1000000000ull, 1000000000ull);
+}
+
+/**
+ * Removes the receiver from the given epoll instance.
+ * @param epoll The epoll instance the receiver was attached to.
+ */
+void MulticastReceiver::detach(Epoll& epoll)
+{
+	for (Group *group : _groups) {
+		epoll.remove(&group->socket);
+	}
+
+	_rate_timer.disarm();
+	epoll.remove(&_rate_timer);
+}
+
+/**
+ * Handles a readiness event, if it belongs to one of the groups or to the rate timer.
+ * @param event The event returned from Epoll::wait.
+ * @return True if the event was consumed by this receiver.
+ */
+bool MulticastReceiver::handle(const EpollEvent& event)
+{
+	if (event.fd == &_rate_timer) {
+		_rate_timer.acknowledge();
+		update_rates();
+
+		return true;
+	}
+
+	for (GroupID id = 0; id < _groups.size(); id++) {
+		if (event.fd == &_groups[id]->socket) {
+			drain(id);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Receives the datagrams waiting on a group's socket, a batch at a time.  A bounded number of
+ * batches is taken, so that one busy group cannot starve the others; the sockets are
+ * level-triggered, so the rest are received on the next iteration of the loop.
+ * @param id The group to receive from.
+ * @return The number of datagrams received.
+ */
+unsigned int MulticastReceiver::drain(GroupID id)
+{
+	Group& group = *_groups.at(id);
+	unsigned int total = 0;
+	size_t control_size = CMSG_SPACE(sizeof(uint32_t));
+
+	for (unsigned int batch = 0; batch < MaxBatchesPerEvent; batch++) {
+		for (unsigned int i = 0; i < _batch_size; i++) {
+			_iovecs[i].iov_base = &_buffers[i * _max_datagram];
+			_iovecs[i].iov_len = _max_datagram;
+
+			struct msghdr& header = _messages[i].msg_hdr;
+			bzero(&header, sizeof(header));
+			header.msg_iov = &_iovecs[i];
+			header.msg_iovlen = 1;
+			header.msg_control = &_control[i * control_size];
+			header.msg_controllen = control_size;
+		}
+
+		int count = ::recvmmsg(group.socket.fd(), _messages.data(), _batch_size, MSG_DONTWAIT, NULL);
+		SFD_METRIC_SYSCALL(SOCKET, count);
+		_receive_calls++;
+
+		if (count <= 0) {
+			break;
+		}
+
+		for (int i = 0; i < count; i++) {
+			struct msghdr& header = _messages[i].msg_hdr;
+
+			for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&header); cmsg != NULL; cmsg = CMSG_NXTHDR(&header, cmsg)) {
+				if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+					uint32_t drops;
+					memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+
+					// The counter is cumulative for the socket, and wraps.
+					group.statistics.kernel_drops += (uint32_t)(drops - group.drop_counter);
+					group.drop_counter = drops;
+				}
+			}
+
+			// A datagram that did not fit into the buffer has lost its tail, so neither its
+			// sequence number nor its payload can be trusted.
+			if (header.msg_flags & MSG_TRUNC) {
+				group.statistics.truncated++;
+				continue;
+			}
+
+			account(group, _iovecs[i].iov_base, _messages[i].msg_len);
+			_handler(id, _iovecs[i].iov_base, _messages[i].msg_len);
+		}
+
+		total += count;
+		_received += count;
+
+		if ((unsigned int)count < _batch_size) {
+			break;
+		}
+	}
+
+	return total;
+}
+
+/**
+ * Updates a group's statistics for a received datagram, and checks its sequence number.
+ */
+void MulticastReceiver::account(Group& group, const void *data, size_t length)
+{
+	MulticastGroupStatistics& statistics = group.statistics;
+
+	statistics.packets++;
+	statistics.bytes += length;
+
+	uint64_t sequence;
+	if (!group.parser || !group.parser(data, length, sequence)) {
+		return;
+	}
+
+	// Sequence numbers are compared using serial number arithmetic (as in RFC 1982), so that
+	// the distance between two of them is measured modulo the width of the sequence.
+	unsigned int width = group.parser.width();
+	uint64_t mask = (width >= 8) ? ~0ull : (1ull << (width * 8)) - 1;
+
+	sequence &= mask;
+
+	if (group.sequenced) {
+		uint64_t forward = (sequence - statistics.last_sequence) & mask;
+		uint64_t backward = (statistics.last_sequence - sequence) & mask;
+
+		if (forward == 0 || backward <= MulticastGroupStatistics::ReorderWindow) {
+			statistics.reordered++;
+			return;
+		}
+
+		if (forward > mask / 2) {
+			statistics.resets++;
+		} else if (forward > 1) {
+			statistics.gaps++;
+			statistics.lost += forward - 1;
+		}
+	}
+
+	group.sequenced = true;
+	statistics.last_sequence = sequence;
+}
+
+void MulticastReceiver::update_rates()
+{
+	uint64_t now = metrics::now();
+	double seconds = (double)(now - _rate_since) / 1e9;
+
+	if (seconds <= 0) {
+		return;
+	}
+
+	for (Group *group : _groups) {
+		MulticastGroupStatistics& statistics = group->statistics;
+
+		statistics.packets_per_sec = (double)(statistics.packets - group->rate_packets) / seconds;
+		statistics.bytes_per_sec = (double)(statistics.bytes - group->rate_bytes) / seconds;
+
+		group->rate_packets = statistics.packets;
+		group->rate_bytes = statistics.bytes;
+	}
+
+	_rate_since = now;
+}
+
+/**
+ * Returns a sequence parser for the common case of an unsigned, big-endian sequence number at a
+ * fixed offset in the datagram.
+ * @param offset The offset of the sequence number, in bytes.
+ * @param width The width of the sequence number, in bytes (at most 8).
+ */
+SequenceParser MulticastReceiver::big_endian_sequence(size_t offset, size_t width)
+{
+	if (width == 0 || width > 8) {
+		throw MulticastReceiverException("Sequence numbers must be between one and eight bytes wide");
+	}
+
+	return SequenceParser([offset, width](const void *data, size_t length, uint64_t& sequence) {
+		if (length < offset + width) {
+			return false;
+		}
+
+		const uint8_t *bytes = (const uint8_t *)data + offset;
+
+		sequence = 0;
+		for (size_t i = 0; i < width; i++) {
+			sequence = (sequence << 8) | bytes[i];
+		}
+
+		return true;
+	}, width);
+}
+
+MulticastReceiver::Group::Group(const IPAddress& address, const SequenceParser& parser)
+	: address(address),
+		socket(SocketType::Datagram, ProtocolType::UDP),
+		parser(parser),
+		statistics { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0.0, 0.0 },
+		sequenced(false),
+		rate_packets(0),
+		rate_bytes(0),
+		drop_counter(0)
+{
+}
+
+std::string MulticastGroupStatistics::to_string() const
+{
+	std::ostringstream out;
+
+	out << "packets " << packets << "\n";
+	out << "bytes " << bytes << "\n";
+	out << "gaps " << gaps << "\n";
+	out << "lost " << lost << "\n";
+	out << "reordered " << reordered << "\n";
+	out << "resets " << resets << "\n";
+	out << "truncated " << truncated << "\n";
+	out << "kernel_drops " << kernel_drops << "\n";
+	out << "last_sequence " << last_sequence << "\n";
+	out << "packets_per_sec " << packets_per_sec << "\n";
+	out << "bytes_per_sec " << bytes_per_sec << "\n";
+
+	return out.str();
+}
@@ -0,0 +1,96 @@
+/**
+ * src/net/prefix-table.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/net/prefix-table.h>
+
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <sched.h>
+
+using namespace sfd::net;
+
+/**
+ * Constructs a reader registry, registering the process for expedited memory barriers if the
+ * kernel supports them.
+ */
+ReaderRegistry::ReaderRegistry() : _epoch(1)
+{
+	for (Slot& slot : _slots) {
+		slot.epoch.store(0, std::memory_order_relaxed);
+		slot.claimed.store(false, std::memory_order_relaxed);
+	}
+
+	_asymmetric = ::syscall(SYS_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0;
+}
+
+/**
+ * Claims a free slot for a reader thread.
+ * @return The claimed slot, which must be passed to release when the reader is finished.
+ */
+ReaderRegistry::SlotID ReaderRegistry::claim()
+{
+	for (SlotID id = 0; id < MaxReaders; id++) {
+		bool expected = false;
+
+		if (_slots[id].claimed.compare_exchange_strong(expected, true)) {
+			return id;
+		}
+	}
+
+	throw PrefixTableException("No free reader slots");
+}
+
+/**
+ * Releases a slot claimed by claim.
+ */
+void ReaderRegistry::release(SlotID slot)
+{
+	_slots[slot].epoch.store(0, std::memory_order_relaxed);
+	_slots[slot].claimed.store(false, std::memory_order_release);
+}
+
+/**
+ * Waits until every reader that entered before this call has left.  The caller must have
+ * already unpublished whatever it intends to free.
+ */
+void ReaderRegistry::synchronize()
+{
+	uint64_t target = _epoch.fetch_add(1) + 1;
+
+	// Readers only issue a compiler barrier on entry, so force a full barrier on every thread
+	// of the process to make their slot stores visible before the slots are scanned.
+	if (_asymmetric) {
+		if (::syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0) != 0) {
+			throw PrefixTableException("Unable to issue memory barrier");
+		}
+	} else {
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+	}
+
+	for (Slot& slot : _slots) {
+		for (;;) {
+			uint64_t epoch = slot.epoch.load(std::memory_order_acquire);
+			if (epoch == 0 || epoch >= target) {
+				break;
+			}
+
+			::sched_yield();
+		}
+	}
+}
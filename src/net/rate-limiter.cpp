@@ -0,0 +1,526 @@
+/**
+ * src/net/rate-limiter.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/net/rate-limiter.h>
+#include <sfd/metrics.h>
+
+#include <algorithm>
+#include <errno.h>
+
+using namespace sfd;
+using namespace sfd::net;
+
+/**
+ * Creates a token bucket, initially full.
+ * @param rate_bytes_per_sec The rate at which tokens accumulate.
+ * @param burst_bytes The most tokens the bucket can hold, i.e. the largest burst it allows.
+ * Must not be zero, as a bucket that can hold no tokens can never allow anything through.
+ */
+TokenBucket::TokenBucket(uint64_t rate_bytes_per_sec, uint64_t burst_bytes)
+	: _rate(rate_bytes_per_sec), _burst(burst_bytes), _tokens((double)burst_bytes), _last_refill(metrics::now())
+{
+	if (burst_bytes == 0) {
+		throw RateLimiterException("Burst size must not be zero");
+	}
+}
+
+/**
+ * Changes the rate and burst size.  Tokens accumulated at the old rate are kept, up to the new
+ * burst size.
+ */
+void TokenBucket::configure(uint64_t rate_bytes_per_sec, uint64_t burst_bytes)
+{
+	if (burst_bytes == 0) {
+		throw RateLimiterException("Burst size must not be zero");
+	}
+
+	refill(metrics::now());
+
+	_rate = rate_bytes_per_sec;
+	_burst = burst_bytes;
+	_tokens = std::min(_tokens, (double)_burst);
+}
+
+/**
+ * Adds the tokens that have accumulated since the last refill.
+ * @param now The current time, from metrics::now.
+ */
+void TokenBucket::refill(uint64_t now)
+{
+	if (now > _last_refill) {
+		_tokens = std::min((double)_burst, _tokens + (double)(now - _last_refill) * _rate / 1e9);
+	}
+
+	_last_refill = now;
+}
+
+/**
+ * Returns how long, in nanoseconds, until the bucket holds the given number of tokens.
+ */
+uint64_t TokenBucket::delay_for(size_t bytes) const
+{
+	if (available(bytes)) {
+		return 0;
+	}
+
+	if (_rate == 0) {
+		return UINT64_MAX;
+	}
+
+	return (uint64_t)(((double)bytes - _tokens) * 1e9 / _rate) + 1;
+}
+
+/**
+ * Creates a rate limiter, with a root class that limits all of its traffic.
+ * @param rate_bytes_per_sec The rate of the root class.
+ * @param burst_bytes The burst size of the root class.
+ */
+RateLimiter::RateLimiter(uint64_t rate_bytes_per_sec, uint64_t burst_bytes) : _epoll(nullptr)
+{
+	_classes.push_back(TrafficClass(Root, rate_bytes_per_sec, burst_bytes));
+}
+
+/**
+ * Adds a traffic class beneath an existing class.
+ * @param parent The class whose limit also applies to the new class.
+ * @param rate_bytes_per_sec The rate of the new class.
+ * @param burst_bytes The burst size of the new class.  Writes are sent in chunks of at most
+ * the smallest burst size along the class's path to the root.
+ * @return The identifier of the new class.
+ */
+RateLimiter::ClassID RateLimiter::add_class(ClassID parent, uint64_t rate_bytes_per_sec, uint64_t burst_bytes)
+{
+	if (parent >= _classes.size()) {
+		throw RateLimiterException("Parent traffic class does not exist");
+	}
+
+	_classes.push_back(TrafficClass(parent, rate_bytes_per_sec, burst_bytes));
+	return (ClassID)(_classes.size() - 1);
+}
+
+/**
+ * Changes the rate and burst size of a class, taking effect immediately.
+ */
+void RateLimiter::configure(ClassID id, uint64_t rate_bytes_per_sec, uint64_t burst_bytes)
+{
+	_classes.at(id).bucket.configure(rate_bytes_per_sec, burst_bytes);
+
+	// Blocked writers may be able to go sooner (or later) than the timer was set for.
+	arm_timer();
+}
+
+/**
+ * Registers the limiter's release timer with the given epoll instance.
+ * @param epoll The epoll instance that will drive this limiter.
+ */
+void RateLimiter::attach(Epoll& epoll)
+{
+	_epoll = &epoll;
+	_epoll->add(&_timer, EpollEventType::IN);
+
+	arm_timer();
+}
+
+/**
+ * Removes the limiter from the given epoll instance.  Blocked writers stay blocked until the
+ * limiter is attached again.
+ * @param epoll The epoll instance the limiter was attached to.
+ */
+void RateLimiter::detach(Epoll& epoll)
+{
+	_timer.disarm();
+	epoll.remove(&_timer);
+
+	_epoll = nullptr;
+}
+
+/**
+ * Handles a readiness event, if it belongs to the release timer.
+ * @param event The event returned from Epoll::wait.
+ * @return True if the event was consumed by this limiter.
+ */
+bool RateLimiter::handle(const EpollEvent& event)
+{
+	if (event.fd != &_timer) {
+		return false;
+	}
+
+	_timer.acknowledge();
+	release();
+
+	return true;
+}
+
+/**
+ * Returns how much of a write may be sent now: the whole chunk, if every class along the path
+ * to the root has enough tokens for it, or nothing.
+ */
+size_t RateLimiter::allowance(ClassID id, size_t wanted)
+{
+	uint64_t now = metrics::now();
+	size_t chunk = wanted;
+
+	for (ClassID c = id;; c = _classes[c].parent) {
+		TokenBucket& bucket = _classes[c].bucket;
+
+		bucket.refill(now);
+		chunk = std::min(chunk, (size_t)bucket.burst());
+
+		if (c == Root) {
+			break;
+		}
+	}
+
+	for (ClassID c = id;; c = _classes[c].parent) {
+		if (!_classes[c].bucket.available(chunk)) {
+			return 0;
+		}
+
+		if (c == Root) {
+			break;
+		}
+	}
+
+	return chunk;
+}
+
+void RateLimiter::spend(ClassID id, size_t bytes)
+{
+	for (ClassID c = id;; c = _classes[c].parent) {
+		_classes[c].bucket.consume(bytes);
+
+		if (c == Root) {
+			break;
+		}
+	}
+}
+
+/**
+ * Returns how long until a write in the given class can next be sent.
+ */
+uint64_t RateLimiter::delay_for(ClassID id, size_t wanted)
+{
+	size_t chunk = wanted;
+
+	for (ClassID c = id;; c = _classes[c].parent) {
+		chunk = std::min(chunk, (size_t)_classes[c].bucket.burst());
+
+		if (c == Root) {
+			break;
+		}
+	}
+
+	uint64_t delay = 0;
+
+	for (ClassID c = id;; c = _classes[c].parent) {
+		delay = std::max(delay, _classes[c].bucket.delay_for(chunk));
+
+		if (c == Root) {
+			break;
+		}
+	}
+
+	return delay;
+}
+
+/**
+ * Returns true if a blocked writer (other than the given one) is waiting for tokens in a class
+ * that a write by the given writer would also spend from.  Such a write must queue behind the
+ * blocked writer, rather than take the tokens it is waiting for.
+ */
+bool RateLimiter::contended(const PacedWriter *writer)
+{
+	if (_blocked.empty()) {
+		return false;
+	}
+
+	uint64_t now = metrics::now();
+
+	for (const PacedWriter *blocked : _blocked) {
+		if (blocked == writer) {
+			continue;
+		}
+
+		size_t chunk = blocked->queued();
+
+		for (ClassID c = blocked->_id;; c = _classes[c].parent) {
+			chunk = std::min(chunk, (size_t)_classes[c].bucket.burst());
+
+			if (c == Root) {
+				break;
+			}
+		}
+
+		for (ClassID c = blocked->_id;; c = _classes[c].parent) {
+			TokenBucket& bucket = _classes[c].bucket;
+			bucket.refill(now);
+
+			// The blocked writer is waiting on this class; check whether the writer's own
+			// path goes through it.
+			if (!bucket.available(chunk)) {
+				for (ClassID d = writer->_id;; d = _classes[d].parent) {
+					if (d == c) {
+						return true;
+					}
+
+					if (d == Root) {
+						break;
+					}
+				}
+			}
+
+			if (c == Root) {
+				break;
+			}
+		}
+	}
+
+	return false;
+}
+
+void RateLimiter::block(PacedWriter *writer)
+{
+	if (writer->_blocked) {
+		return;
+	}
+
+	writer->_blocked = true;
+	_blocked.push_back(writer);
+
+	arm_timer();
+}
+
+void RateLimiter::unblock(PacedWriter *writer)
+{
+	if (!writer->_blocked) {
+		return;
+	}
+
+	writer->_blocked = false;
+	_blocked.remove(writer);
+}
+
+/**
+ * Gives each blocked writer, in the order they blocked, a chance to spend the tokens that have
+ * accumulated.
+ */
+void RateLimiter::release()
+{
+	std::list<PacedWriter *> blocked;
+	blocked.swap(_blocked);
+
+	for (PacedWriter *writer : blocked) {
+		writer->_blocked = false;
+	}
+
+	for (PacedWriter *writer : blocked) {
+		writer->pump();
+	}
+
+	arm_timer();
+}
+
+/**
+ * Arms the release timer for the earliest time a blocked writer can proceed.
+ */
+void RateLimiter::arm_timer()
+{
+	if (!_epoll) {
+		return;
+	}
+
+	uint64_t earliest = UINT64_MAX;
+	uint64_t earliest_contended = UINT64_MAX;
+
+	// A writer queued behind another cannot go before it, however soon its own tokens are
+	// ready, so it only sets the timer if every blocked writer is waiting on another.
+	for (PacedWriter *writer : _blocked) {
+		uint64_t delay = delay_for(writer->_id, writer->queued());
+
+		if (contended(writer)) {
+			earliest_contended = std::min(earliest_contended, delay);
+		} else {
+			earliest = std::min(earliest, delay);
+		}
+	}
+
+	if (earliest == UINT64_MAX) {
+		earliest = earliest_contended;
+	}
+
+	if (earliest == UINT64_MAX) {
+		_timer.disarm();
+	} else {
+		_timer.arm(std::max(earliest, (uint64_t)1));
+	}
+}
+
+/**
+ * Creates a writer for the given file descriptor, in a class of the given limiter.  The file
+ * descriptor is placed into non-blocking mode.
+ */
+PacedWriter::PacedWriter(RateLimiter& limiter, RateLimiter::ClassID id, FileDescriptor& fd)
+	: _limiter(limiter), _id(id), _fd(fd), _queue_offset(0), _written(0), _blocked(false), _failed(false)
+{
+	if (id >= limiter._classes.size()) {
+		throw RateLimiterException("Traffic class does not exist");
+	}
+
+	_fd.non_blocking(true);
+}
+
+PacedWriter::~PacedWriter()
+{
+	_limiter.unblock(this);
+}
+
+/**
+ * Registers the file descriptor with the given epoll instance, so that the writer resumes
+ * when the kernel's buffer drains.
+ * @param epoll The epoll instance that will drive this writer.
+ */
+void PacedWriter::attach(Epoll& epoll)
+{
+	epoll.add(&_fd, EpollEventType::OUT | EpollEventType::ET);
+}
+
+void PacedWriter::detach(Epoll& epoll)
+{
+	epoll.remove(&_fd);
+}
+
+/**
+ * Handles a readiness event, if it belongs to the writer's file descriptor.
+ * @param event The event returned from Epoll::wait.
+ * @return True if the event was consumed by this writer.
+ */
+bool PacedWriter::handle(const EpollEvent& event)
+{
+	if (event.fd != &_fd) {
+		return false;
+	}
+
+	pump();
+	return true;
+}
+
+/**
+ * Writes data within the class's limits.  Whatever cannot be sent straight away is queued, and
+ * sent as tokens become available and the file descriptor becomes writable.  If the file
+ * descriptor fails, the queue is discarded and further writes are ignored (see failed).
+ * @param data The data to write.
+ * @param length The number of bytes to write.
+ */
+void PacedWriter::write(const void *data, size_t length)
+{
+	if (_failed) {
+		return;
+	}
+
+	const char *bytes = (const char *)data;
+	size_t sent = 0;
+	bool throttled = false;
+
+	// Nothing is queued ahead of this write, so it can go straight out if there are tokens,
+	// unless another writer is already waiting for them.
+	if (queued() == 0) {
+		if (_limiter.contended(this)) {
+			throttled = true;
+		} else {
+			sent = send(bytes, length, throttled);
+		}
+	}
+
+	if (sent < length && !_failed) {
+		_queue.insert(_queue.end(), bytes + sent, bytes + length);
+
+		// Only block once the remainder is queued, so that the limiter sets its timer for
+		// the data that is actually waiting.
+		if (throttled) {
+			_limiter.block(this);
+		}
+	}
+}
+
+/**
+ * Sends as much of the queue as the tokens and the file descriptor allow.
+ */
+void PacedWriter::pump()
+{
+	if (_failed || queued() == 0) {
+		return;
+	}
+
+	if (_limiter.contended(this)) {
+		_limiter.block(this);
+		return;
+	}
+
+	bool throttled = false;
+	_queue_offset += send(_queue.data() + _queue_offset, queued(), throttled);
+
+	if (_failed || _queue_offset == _queue.size()) {
+		_queue.clear();
+		_queue_offset = 0;
+		return;
+	}
+
+	if (_queue_offset > _queue.size() / 2) {
+		_queue.erase(_queue.begin(), _queue.begin() + _queue_offset);
+		_queue_offset = 0;
+	}
+
+	if (throttled) {
+		_limiter.block(this);
+	}
+}
+
+/**
+ * Writes as much of the given data as possible.  If the file descriptor would block, the
+ * writer waits for it to become writable.
+ * @param throttled Set if the writer ran out of tokens, in which case the caller must block it
+ * on the limiter once the unsent data is queued.
+ * @return The number of bytes written.
+ */
+size_t PacedWriter::send(const char *data, size_t length, bool& throttled)
+{
+	size_t sent = 0;
+
+	while (sent < length) {
+		size_t chunk = _limiter.allowance(_id, length - sent);
+		if (chunk == 0) {
+			throttled = true;
+			break;
+		}
+
+		int rc = _fd.write_inline(data + sent, chunk);
+		if (rc < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+				_failed = true;
+			}
+
+			break;
+		}
+
+		_limiter.spend(_id, rc);
+		_written += rc;
+		sent += rc;
+	}
+
+	return sent;
+}
@@ -0,0 +1,429 @@
+/**
+ * src/net/socket-tuning.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/net/socket.h>
+#include <sfd/net/socket-tuning.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/time.h>
+#include <string>
+
+using namespace sfd;
+using namespace sfd::net;
+
+SocketTuning SocketTuning::low_latency_rpc()
+{
+	SocketTuning tuning;
+
+	tuning.no_delay = true;
+	tuning.quick_ack = true;
+	tuning.not_sent_low_water = 16384;
+	tuning.user_timeout_ms = 10000;
+
+	return tuning;
+}
+
+SocketTuning SocketTuning::bulk_transfer()
+{
+	SocketTuning tuning;
+
+	tuning.no_delay = false;
+	tuning.send_buffer_size = 4 << 20;
+	tuning.receive_buffer_size = 4 << 20;
+	tuning.priority = 0;
+	tuning.user_timeout_ms = 60000;
+
+	return tuning;
+}
+
+bool Socket::is_ip() const
+{
+	return _family == AddressFamily::IPv4 || _family == AddressFamily::IPv6;
+}
+
+bool Socket::is_tcp() const
+{
+	return is_ip() && _type == SocketType::Stream && (_protocol == ProtocolType::IP || _protocol == ProtocolType::TCP);
+}
+
+bool Socket::no_delay() const
+{
+	return get_option<int>(IPPROTO_TCP, TCP_NODELAY) != 0;
+}
+
+/**
+ * Disables (or re-enables) Nagle's algorithm, so that small writes are sent straight away
+ * rather than being held back while earlier data is unacknowledged.
+ */
+void Socket::no_delay(bool enable)
+{
+	try {
+		set_option<int>(IPPROTO_TCP, TCP_NODELAY, enable ? 1 : 0);
+	} catch (const SocketException& ex) {
+		throw SocketException("Unable to set no delay socket option.", ex);
+	}
+}
+
+bool Socket::quick_ack() const
+{
+	return get_option<int>(IPPROTO_TCP, TCP_QUICKACK) != 0;
+}
+
+/**
+ * Sends ACKs immediately rather than delaying them.  The kernel may drop back into delayed ACK
+ * mode by itself, so latency-sensitive receivers should re-apply this after each read.
+ */
+void Socket::quick_ack(bool enable)
+{
+	try {
+		set_option<int>(IPPROTO_TCP, TCP_QUICKACK, enable ? 1 : 0);
+	} catch (const SocketException& ex) {
+		throw SocketException("Unable to set quick ack socket option.", ex);
+	}
+}
+
+bool Socket::cork() const
+{
+	return get_option<int>(IPPROTO_TCP, TCP_CORK) != 0;
+}
+
+/**
+ * Holds back partial segments while corked, so that a response built from several writes
+ * leaves in as few packets as possible.  Uncorking sends whatever is pending.
+ */
+void Socket::cork(bool enable)
+{
+	try {
+		set_option<int>(IPPROTO_TCP, TCP_CORK, enable ? 1 : 0);
+	} catch (const SocketException& ex) {
+		throw SocketException("Unable to set cork socket option.", ex);
+	}
+}
+
+unsigned int Socket::not_sent_low_water() const
+{
+	return get_option<unsigned int>(IPPROTO_TCP, TCP_NOTSENT_LOWAT);
+}
+
+/**
+ * Limits how much unsent data may be queued in the kernel before the socket stops reporting
+ * itself as writable.
+ * @param bytes The limit, in bytes.
+ */
+void Socket::not_sent_low_water(unsigned int bytes)
+{
+	try {
+		set_option<unsigned int>(IPPROTO_TCP, TCP_NOTSENT_LOWAT, bytes);
+	} catch (const SocketException& ex) {
+		throw SocketException("Unable to set not-sent low water socket option.", ex);
+	}
+}
+
+unsigned int Socket::user_timeout() const
+{
+	return get_option<unsigned int>(IPPROTO_TCP, TCP_USER_TIMEOUT);
+}
+
+/**
+ * Sets how long transmitted data may remain unacknowledged before the connection is closed.
+ * @param milliseconds The timeout, or zero for the system default.
+ */
+void Socket::user_timeout(unsigned int milliseconds)
+{
+	try {
+		set_option<unsigned int>(IPPROTO_TCP, TCP_USER_TIMEOUT, milliseconds);
+	} catch (const SocketException& ex) {
+		throw SocketException("Unable to set user timeout socket option.", ex);
+	}
+}
+
+/**
+ * Returns the size of the send buffer.  The kernel reports double the size that was set, to
+ * account for its own bookkeeping overhead.
+ */
+int Socket::send_buffer_size() const
+{
+	return get_option<int>(SOL_SOCKET, SO_SNDBUF);
+}
+
+void Socket::send_buffer_size(int bytes)
+{
+	try {
+		set_option<int>(SOL_SOCKET, SO_SNDBUF, bytes);
+	} catch (const SocketException& ex) {
+		throw SocketException("Unable to set send buffer size socket option.", ex);
+	}
+}
+
+/**
+ * Returns the size of the receive buffer.  The kernel reports double the size that was set, to
+ * account for its own bookkeeping overhead.
+ */
+int Socket::receive_buffer_size() const
+{
+	return get_option<int>(SOL_SOCKET, SO_RCVBUF);
+}
+
+void Socket::receive_buffer_size(int bytes)
+{
+	try {
+		set_option<int>(SOL_SOCKET, SO_RCVBUF, bytes);
+	} catch (const SocketException& ex) {
+		throw SocketException("Unable to set receive buffer size socket option.", ex);
+	}
+}
+
+int Socket::priority() const
+{
+	return get_option<int>(SOL_SOCKET, SO_PRIORITY);
+}
+
+/**
+ * Sets the priority of packets sent on this socket, which selects the device queue they are
+ * placed on.  Priorities outside 0 to 6 need CAP_NET_ADMIN.
+ */
+void Socket::priority(int priority)
+{
+	try {
+		set_option<int>(SOL_SOCKET, SO_PRIORITY, priority);
+	} catch (const SocketException& ex) {
+		throw SocketException("Unable to set priority socket option.", ex);
+	}
+}
+
+uint8_t Socket::type_of_service() const
+{
+	if (_family == AddressFamily::IPv6) {
+		return (uint8_t)get_option<int>(IPPROTO_IPV6, IPV6_TCLASS);
+	}
+
+	return (uint8_t)get_option<int>(IPPROTO_IP, IP_TOS);
+}
+
+/**
+ * Sets the TOS byte (IPv4) or traffic class (IPv6) of packets sent on this socket, i.e. the
+ * DSCP code point in the upper six bits and the ECN bits below it.
+ */
+void Socket::type_of_service(uint8_t tos)
+{
+	try {
+		if (_family == AddressFamily::IPv6) {
+			set_option<int>(IPPROTO_IPV6, IPV6_TCLASS, tos);
+		} else {
+			set_option<int>(IPPROTO_IP, IP_TOS, tos);
+		}
+	} catch (const SocketException& ex) {
+		throw SocketException("Unable to set type of service socket option.", ex);
+	}
+}
+
+unsigned int Socket::busy_poll() const
+{
+	return get_option<unsigned int>(SOL_SOCKET, SO_BUSY_POLL);
+}
+
+/**
+ * Sets how long a blocking receive (or a poll including this socket) spins on the device queue
+ * before sleeping.  Raising this above net.core.busy_read needs CAP_NET_ADMIN.
+ * @param microseconds The spin budget, or zero to disable busy polling.
+ */
+void Socket::busy_poll(unsigned int microseconds)
+{
+	try {
+		set_option<unsigned int>(SOL_SOCKET, SO_BUSY_POLL, microseconds);
+	} catch (const SocketException& ex) {
+		throw SocketException("Unable to set busy poll socket option.", ex);
+	}
+}
+
+bool Socket::prefer_busy_poll() const
+{
+	return get_option<int>(SOL_SOCKET, SO_PREFER_BUSY_POLL) != 0;
+}
+
+/**
+ * Asks the kernel to leave the socket's device queue to be drained by busy polling, rather
+ * than by interrupts, while the application is polling it often enough.
+ */
+void Socket::prefer_busy_poll(bool enable)
+{
+	try {
+		set_option<int>(SOL_SOCKET, SO_PREFER_BUSY_POLL, enable ? 1 : 0);
+	} catch (const SocketException& ex) {
+		throw SocketException("Unable to set prefer busy poll socket option.", ex);
+	}
+}
+
+/**
+ * Returns the CPU that last processed packets for this socket in the kernel, so that the
+ * connection can be handed to a thread on the same CPU.
+ */
+int Socket::incoming_cpu() const
+{
+	return get_option<int>(SOL_SOCKET, SO_INCOMING_CPU);
+}
+
+/**
+ * Asks for this socket's packets to be processed on the given CPU.  This only has an effect on
+ * a listening socket in a SO_REUSEPORT group, where it steers new connections.
+ */
+void Socket::incoming_cpu(int cpu)
+{
+	try {
+		set_option<int>(SOL_SOCKET, SO_INCOMING_CPU, cpu);
+	} catch (const SocketException& ex) {
+		throw SocketException("Unable to set incoming CPU socket option.", ex);
+	}
+}
+
+/**
+ * Controls what happens to unsent data when the socket is closed.  With linger enabled and a
+ * timeout of zero, closing the socket discards any unsent data and resets the connection.
+ * @param enable Whether close should wait for unsent data to be delivered.
+ * @param seconds How long close may wait.
+ */
+void Socket::linger(bool enable, int seconds)
+{
+	struct ::linger value;
+	value.l_onoff = enable ? 1 : 0;
+	value.l_linger = seconds;
+
+	try {
+		set_option_raw(SOL_SOCKET, SO_LINGER, &value, sizeof(value));
+	} catch (const SocketException& ex) {
+		throw SocketException("Unable to set linger socket option.", ex);
+	}
+}
+
+namespace {
+	struct timeval milliseconds_to_timeval(unsigned int milliseconds)
+	{
+		struct timeval value;
+		value.tv_sec = milliseconds / 1000;
+		value.tv_usec = (milliseconds % 1000) * 1000;
+
+		return value;
+	}
+
+	unsigned int timeval_to_milliseconds(const struct timeval& value)
+	{
+		return (unsigned int)(value.tv_sec * 1000 + value.tv_usec / 1000);
+	}
+}
+
+unsigned int Socket::receive_timeout() const
+{
+	return timeval_to_milliseconds(get_option<struct timeval>(SOL_SOCKET, SO_RCVTIMEO));
+}
+
+/**
+ * Bounds how long a blocking receive on this socket may wait.  A receive that times out fails
+ * with EAGAIN.
+ * @param milliseconds The timeout, or zero to wait indefinitely.
+ */
+void Socket::receive_timeout(unsigned int milliseconds)
+{
+	try {
+		set_option<struct timeval>(SOL_SOCKET, SO_RCVTIMEO, milliseconds_to_timeval(milliseconds));
+	} catch (const SocketException& ex) {
+		throw SocketException("Unable to set receive timeout socket option.", ex);
+	}
+}
+
+unsigned int Socket::send_timeout() const
+{
+	return timeval_to_milliseconds(get_option<struct timeval>(SOL_SOCKET, SO_SNDTIMEO));
+}
+
+/**
+ * Bounds how long a blocking send on this socket may wait for buffer space.
+ * @param milliseconds The timeout, or zero to wait indefinitely.
+ */
+void Socket::send_timeout(unsigned int milliseconds)
+{
+	try {
+		set_option<struct timeval>(SOL_SOCKET, SO_SNDTIMEO, milliseconds_to_timeval(milliseconds));
+	} catch (const SocketException& ex) {
+		throw SocketException("Unable to set send timeout socket option.", ex);
+	}
+}
+
+uint64_t Socket::max_pacing_rate() const
+{
+	return get_option<uint64_t>(SOL_SOCKET, SO_MAX_PACING_RATE);
+}
+
+/**
+ * Caps the rate at which the kernel sends on this socket.  TCP paces itself; other protocols
+ * are paced by the fq queueing discipline, if the device uses it.  For limits shared by several
+ * sockets, or traffic the kernel does not pace, use a RateLimiter.
+ * @param bytes_per_sec The maximum rate, or UINT64_MAX for no limit.
+ */
+void Socket::max_pacing_rate(uint64_t bytes_per_sec)
+{
+	try {
+		set_option<uint64_t>(SOL_SOCKET, SO_MAX_PACING_RATE, bytes_per_sec);
+	} catch (const SocketException& ex) {
+		throw SocketException("Unable to set max pacing rate socket option.", ex);
+	}
+}
+
+/**
+ * Applies a set of socket options.  Every applicable option is attempted, even if an earlier
+ * one fails, and the failures are then reported together.
+ * @param tuning The options to apply.  See SocketTuning::low_latency_rpc and
+ * SocketTuning::bulk_transfer for vetted sets.
+ */
+void Socket::tune(const SocketTuning& tuning)
+{
+	std::string failed;
+
+	auto attempt = [&](const char *name, auto apply) {
+		try {
+			apply();
+		} catch (const SocketException&) {
+			failed += failed.empty() ? name : std::string(", ") + name;
+		}
+	};
+
+	if (is_tcp()) {
+		if (tuning.no_delay) attempt("TCP_NODELAY", [&] { no_delay(*tuning.no_delay); });
+		if (tuning.quick_ack) attempt("TCP_QUICKACK", [&] { quick_ack(*tuning.quick_ack); });
+		if (tuning.cork) attempt("TCP_CORK", [&] { cork(*tuning.cork); });
+		if (tuning.not_sent_low_water) attempt("TCP_NOTSENT_LOWAT", [&] { not_sent_low_water(*tuning.not_sent_low_water); });
+		if (tuning.user_timeout_ms) attempt("TCP_USER_TIMEOUT", [&] { user_timeout(*tuning.user_timeout_ms); });
+	}
+
+	if (tuning.send_buffer_size) attempt("SO_SNDBUF", [&] { send_buffer_size(*tuning.send_buffer_size); });
+	if (tuning.receive_buffer_size) attempt("SO_RCVBUF", [&] { receive_buffer_size(*tuning.receive_buffer_size); });
+	if (tuning.priority) attempt("SO_PRIORITY", [&] { priority(*tuning.priority); });
+	if (tuning.busy_poll_us) attempt("SO_BUSY_POLL", [&] { busy_poll(*tuning.busy_poll_us); });
+	if (tuning.prefer_busy_poll) attempt("SO_PREFER_BUSY_POLL", [&] { prefer_busy_poll(*tuning.prefer_busy_poll); });
+	if (tuning.max_pacing_rate) attempt("SO_MAX_PACING_RATE", [&] { max_pacing_rate(*tuning.max_pacing_rate); });
+	if (tuning.incoming_cpu) attempt("SO_INCOMING_CPU", [&] { incoming_cpu(*tuning.incoming_cpu); });
+
+	if (is_ip() && tuning.type_of_service) {
+		attempt("IP_TOS", [&] { type_of_service(*tuning.type_of_service); });
+	}
+
+	if (!failed.empty()) {
+		throw SocketException("Unable to apply socket options: " + failed);
+	}
+}
@@ -17,9 +17,15 @@
  * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 #include <sfd/net/socket.h>
+#include <sfd/net/ip-endpoint.h>
 #include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
 #include <net/if.h>
+#include <linux/sockios.h>
+#include <linux/tcp.h>
 #include <string.h>
+#include <errno.h>
 
 using namespace sfd;
 using namespace sfd::net;
@@ -35,7 +41,9 @@ Socket::Socket(AddressFamily::AddressFamily family, SocketType::SocketType type,
 		_family(family),
 		_type(type),
 		_protocol(protocol),
-		_remote_endpoint(NULL)
+		_remote_endpoint(NULL),
+		_bytes_sent(0),
+		_bytes_received(0)
 {
 	// Ensure that the created file-descriptor is valid.
 	if (!valid()) {
@@ -58,7 +66,9 @@ Socket::Socket(FileDescriptor::NativeFD fd, AddressFamily::AddressFamily family,
 		_family(family),
 		_type(type),
 		_protocol(protocol),
-		_remote_endpoint(rep)
+		_remote_endpoint(rep),
+		_bytes_sent(0),
+		_bytes_received(0)
 {
 	if (!valid()) {
 		throw SocketException("Error whilst creating socket");
@@ -104,6 +114,25 @@ void Socket::listen(int max_pending)
 	}
 }
 
+/**
+ * Starts a TCP socket listening for connections, with the given connection establishment
+ * options applied first.
+ * @param max_pending The maximum number of pending connections in the accept queue.
+ * @param options Fast Open and deferred accept settings for the listener.
+ */
+void Socket::listen(int max_pending, const ListenOptions& options)
+{
+	if (options.fast_open_queue > 0) {
+		set_option<int>(IPPROTO_TCP, TCP_FASTOPEN, options.fast_open_queue);
+	}
+
+	if (options.defer_accept_seconds > 0) {
+		set_option<int>(IPPROTO_TCP, TCP_DEFER_ACCEPT, (int)options.defer_accept_seconds);
+	}
+
+	listen(max_pending);
+}
+
 /**
  * Accepts a new connection pending on this socket, in the form of a new
  * socket object representing the client connection.
@@ -114,20 +143,65 @@ Socket* Socket::accept()
 	// Allocate an arbitrary amount of storage for the remote socaddr.
 	struct sockaddr *sa = (struct sockaddr *)malloc(256);
 	socklen_t sa_len = 256;
+	bzero(sa, sa_len);
 
 	// Accept the new socket.
 	int new_fd = ::accept(fd(), sa, &sa_len);
+	SFD_METRIC_SYSCALL(SOCKET, new_fd);
+	SFD_TRACE_EVENT(ACCEPT, fd(), new_fd);
+
 	if (new_fd < 0) {
 		free(sa);
 		return NULL;
 	}
 
-	// Create the associated remote endpoint.
+	SFD_METRIC_ADD(ACCEPTS, 1);
+
+	// Create the associated remote endpoint.  Not every family has an endpoint
+	// representation (e.g. unnamed Unix sockets), in which case there is no remote endpoint.
 	const EndPoint *rep = EndPoint::from_sockaddr(sa);
 	free(sa);
 
 	// Return a new Socket object that represents the accepted connection.
-	return new Socket(new_fd, rep->family(), _type, _protocol, rep);
+	return new Socket(new_fd, _family, _type, _protocol, rep);
+}
+
+/**
+ * Takes ownership of a pre-existing native socket, e.g. one inherited from another process.  The
+ * family, type and protocol are queried from the socket itself.
+ * @param fd The native file-descriptor of the socket.
+ * @return A new socket object managing the given file-descriptor.
+ */
+Socket* Socket::adopt(FileDescriptor::NativeFD fd)
+{
+	int family, type, protocol;
+	socklen_t len = sizeof(int);
+
+	if (::getsockopt(fd, SOL_SOCKET, SO_DOMAIN, &family, &len) < 0) {
+		throw SocketException("Unable to adopt socket");
+	}
+
+	len = sizeof(int);
+	if (::getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len) < 0) {
+		throw SocketException("Unable to adopt socket");
+	}
+
+	len = sizeof(int);
+	if (::getsockopt(fd, SOL_SOCKET, SO_PROTOCOL, &protocol, &len) < 0) {
+		throw SocketException("Unable to adopt socket");
+	}
+
+	// Connected sockets have a remote endpoint, but listening sockets do not.
+	struct sockaddr_storage ss;
+	socklen_t ss_len = sizeof(ss);
+	const EndPoint *rep = NULL;
+	bzero(&ss, sizeof(ss));
+
+	if (::getpeername(fd, (struct sockaddr *)&ss, &ss_len) == 0) {
+		rep = EndPoint::from_sockaddr((struct sockaddr *)&ss);
+	}
+
+	return new Socket(fd, (AddressFamily::AddressFamily)family, (SocketType::SocketType)type, (ProtocolType::ProtocolType)protocol, rep);
 }
 
 /**
@@ -149,6 +223,8 @@ void Socket::connect(const EndPoint& ep)
 
 	// Connect, and release the sockaddr memory.
 	int rc = ::connect(fd(), sa, sa_len);
+	SFD_METRIC_SYSCALL(SOCKET, rc);
+	SFD_TRACE_EVENT(CONNECT, fd(), rc);
 	ep.free_sockaddr(sa);
 
 	// Check for any errors during the bind.
@@ -157,6 +233,97 @@ void Socket::connect(const EndPoint& ep)
 	}
 }
 
+/**
+ * Starts connecting to the given remote endpoint, without waiting for the connection to be
+ * established.  The socket is placed into non-blocking mode.  If the connection is in
+ * progress, the socket becomes writable when the attempt finishes, at which point
+ * finish_connect reports the outcome.
+ * @param ep The endpoint describing where to connect.
+ * @return True if the connection was established immediately, or false if it is in progress.
+ */
+bool Socket::begin_connect(const EndPoint& ep)
+{
+	if (ep.family() != _family)
+		throw SocketException("Endpoint not of the correct family");
+
+	socklen_t sa_len;
+	struct sockaddr *sa = ep.create_sockaddr(sa_len);
+	if (!sa) {
+		throw SocketException("Unable to create sockaddr from endpoint");
+	}
+
+	non_blocking(true);
+
+	int rc = ::connect(fd(), sa, sa_len);
+	SFD_METRIC_SYSCALL(SOCKET, rc);
+	SFD_TRACE_EVENT(CONNECT, fd(), rc);
+	ep.free_sockaddr(sa);
+
+	if (rc == 0) {
+		return true;
+	}
+
+	if (errno == EINPROGRESS) {
+		return false;
+	}
+
+	throw SocketException("Unable to connect");
+}
+
+/**
+ * Reports the outcome of a connection attempt started with begin_connect, once the socket has
+ * become writable (SO_ERROR).
+ * @return Zero if the connection was established, or the errno value describing why it failed.
+ */
+int Socket::finish_connect()
+{
+	return get_option<int>(SOL_SOCKET, SO_ERROR);
+}
+
+/**
+ * Connects to the given remote endpoint, and sends the first piece of data.  Where TCP Fast
+ * Open is available, the data is carried in the SYN, saving a round trip on connections to
+ * servers that have previously issued this host a cookie.  Otherwise (no cookie yet, Fast Open
+ * disabled by the system, or a non-TCP socket), this falls back to a plain connect and send.
+ * @param ep The endpoint describing where to connect.
+ * @param data The data to send.
+ * @param length The number of bytes to send.
+ * @return The number of bytes sent.  As with send_to, this may be less than length.
+ */
+size_t Socket::connect_with_data(const EndPoint& ep, const void *data, size_t length)
+{
+	if (ep.family() != _family)
+		throw SocketException("Endpoint not of the correct family");
+
+	socklen_t sa_len;
+	struct sockaddr *sa = ep.create_sockaddr(sa_len);
+	if (!sa) {
+		throw SocketException("Unable to create sockaddr from endpoint");
+	}
+
+	ssize_t rc = ::sendto(fd(), data, length, MSG_FASTOPEN, sa, sa_len);
+	SFD_METRIC_SYSCALL(SOCKET, rc);
+	SFD_TRACE_EVENT(CONNECT, fd(), rc);
+	ep.free_sockaddr(sa);
+
+	if (rc < 0 && (errno == EOPNOTSUPP || errno == EPIPE)) {
+		// Fast Open is not available for this socket, so establish the connection the
+		// ordinary way.
+		connect(ep);
+
+		rc = ::send(fd(), data, length, MSG_NOSIGNAL);
+		SFD_METRIC_SYSCALL(SOCKET, rc);
+	}
+
+	account_sent(rc);
+
+	if (rc < 0) {
+		throw SocketException("Unable to connect");
+	}
+
+	return (size_t)rc;
+}
+
 void Socket::shutdown(ShutdownModes::ShutdownModes mode)
 {
 	int how;
@@ -194,6 +361,8 @@ size_t Socket::send_to(const void* message, size_t length, const EndPoint& rep)
 	}
 	
 	ssize_t rc = ::sendto(fd(), message, length, 0, sa, sa_len);
+	SFD_METRIC_SYSCALL(SOCKET, rc);
+	account_sent(rc);
 	rep.free_sockaddr(sa);
 	
 	if (rc < 0) {
@@ -203,32 +372,81 @@ size_t Socket::send_to(const void* message, size_t length, const EndPoint& rep)
 	return (size_t)rc;
 }
 
+/**
+ * Receives a datagram, and the endpoint it was sent from.
+ * @param buffer The buffer to receive the datagram into.
+ * @param length The size of the buffer.
+ * @param rep Populated with the sender's endpoint, or nullptr if it is not needed.  Only
+ * IPEndPoint is supported, as the other endpoint types cannot be reassigned.
+ * @return The length of the datagram.
+ */
 size_t Socket::recv_from(void* buffer, size_t length, EndPoint* rep)
 {
-	socklen_t sa_len;
-	struct sockaddr *sa;
+	struct sockaddr_storage ss;
+	socklen_t ss_len = sizeof(ss);
+	bzero(&ss, sizeof(ss));
+
+	ssize_t rc = ::recvfrom(fd(), buffer, length, 0, rep ? (struct sockaddr *)&ss : NULL, rep ? &ss_len : NULL);
+	SFD_METRIC_SYSCALL(SOCKET, rc);
+	account_received(rc);
 	
-	if (rep != nullptr) {
-		sa = rep->create_sockaddr(sa_len);
-		if (!sa) {
-			throw SocketException("Unable to create sockaddr from endpoint");
+	if (rc < 0) {
+		throw SocketException("Unable to receive message");
+	}
+
+	if (rep == nullptr) {
+		return (size_t)rc;
+	}
+
+	// Assign through the concrete type, as assigning to the EndPoint base would only copy the
+	// family.
+	const EndPoint *received = EndPoint::from_sockaddr((struct sockaddr *)&ss);
+	bool assigned = false;
+
+	if (IPEndPoint *ip = dynamic_cast<IPEndPoint *>(rep)) {
+		if (const IPEndPoint *received_ip = dynamic_cast<const IPEndPoint *>(received)) {
+			*ip = *received_ip;
+			assigned = true;
 		}
 	}
 
-	ssize_t rc = ::recvfrom(fd(), buffer, length, 0, sa, &sa_len);
+	delete received;
+
+	if (!assigned) {
+		throw SocketException("Unable to represent sender endpoint");
+	}
 	
+	return (size_t)rc;
+}
+
+/**
+ * Receives a datagram on an IPv4 socket, and the endpoint it was sent from, without allocating.
+ * @param buffer The buffer to receive the datagram into.
+ * @param length The size of the buffer.
+ * @param rep Populated with the sender's endpoint.
+ * @return The length of the datagram.
+ */
+size_t Socket::recv_from(void* buffer, size_t length, IPEndPoint& rep)
+{
+	struct sockaddr_in sa;
+	socklen_t sa_len = sizeof(sa);
+
+	ssize_t rc = ::recvfrom(fd(), buffer, length, 0, (struct sockaddr *)&sa, &sa_len);
+	SFD_METRIC_SYSCALL(SOCKET, rc);
+	account_received(rc);
+
 	if (rc < 0) {
 		throw SocketException("Unable to receive message");
 	}
 
-	if (rep != nullptr) {
-		*rep = *rep->from_sockaddr(sa);
+	if (sa.sin_family != AF_INET) {
+		throw SocketException("Sender is not an IPv4 endpoint");
 	}
-	
+
+	rep = IPEndPoint(IPAddress(ntohl(sa.sin_addr.s_addr)), ntohs(sa.sin_port));
 	return (size_t)rc;
 }
 
-
 void Socket::set_option_raw(int level, int setting, const void *value, size_t value_size)
 {
 	if (::setsockopt(fd(), level, setting, value, (socklen_t)value_size) < 0) {
@@ -251,13 +469,13 @@ void Socket::get_option_raw(int level, int setting, void* value, size_t* value_s
 
 bool Socket::debug() const
 {
-	return get_option<bool>(SOL_SOCKET, SO_DEBUG);
+	return get_option<int>(SOL_SOCKET, SO_DEBUG) != 0;
 }
 
 void Socket::debug(bool enable)
 {
 	try {
-		set_option<bool>(SOL_SOCKET, SO_DEBUG, enable);
+		set_option<int>(SOL_SOCKET, SO_DEBUG, enable ? 1 : 0);
 	} catch (const SocketException& ex) {
 		throw SocketException("Unable to set debug socket option", ex);
 	}
@@ -265,13 +483,13 @@ void Socket::debug(bool enable)
 
 bool Socket::reuse_address() const
 {
-	return get_option<bool>(SOL_SOCKET, SO_REUSEADDR);
+	return get_option<int>(SOL_SOCKET, SO_REUSEADDR) != 0;
 }
 
 void Socket::reuse_address(bool enable)
 {
 	try {
-		set_option<bool>(SOL_SOCKET, SO_REUSEADDR, enable);
+		set_option<int>(SOL_SOCKET, SO_REUSEADDR, enable ? 1 : 0);
 	} catch (const SocketException& ex) {
 		throw SocketException("Unable to set reuse address socket option.", ex);
 	}
@@ -279,13 +497,13 @@ void Socket::reuse_address(bool enable)
 
 bool Socket::broadcast() const
 {
-		return get_option<bool>(SOL_SOCKET, SO_BROADCAST);
+	return get_option<int>(SOL_SOCKET, SO_BROADCAST) != 0;
 }
 
 void Socket::broadcast(bool enable)
 {
 	try {
-		set_option<bool>(SOL_SOCKET, SO_BROADCAST, enable);
+		set_option<int>(SOL_SOCKET, SO_BROADCAST, enable ? 1 : 0);
 	} catch (const SocketException& ex) {
 		throw SocketException("Unable to set broadcast socket option.", ex);
 	}
@@ -301,4 +519,92 @@ void Socket::bind_to_device(const std::string& device_name) {
 	} catch (const SocketException& ex) {
 		throw SocketException("Unable to bind socket to device.", ex);
 	}
-}
\ No newline at end of file
+}
+
+/**
+ * Enables or disables TCP Fast Open for an ordinary connect (TCP_FASTOPEN_CONNECT).  With this
+ * enabled, connect returns without waiting for the handshake, and the first write on the socket
+ * is carried in the SYN.  Must be set before connecting.
+ */
+void Socket::fast_open_connect(bool enable)
+{
+	set_option<int>(IPPROTO_TCP, TCP_FASTOPEN_CONNECT, enable ? 1 : 0);
+}
+
+/**
+ * Returns true if this connection was established with TCP Fast Open, and the data carried in
+ * the SYN was accepted by the server.  Valid on both the client and the accepted server socket.
+ */
+bool Socket::fast_open_accepted() const
+{
+	struct tcp_info info;
+	size_t info_size = sizeof(info);
+
+	bzero(&info, sizeof(info));
+	get_option_raw(IPPROTO_TCP, TCP_INFO, &info, &info_size);
+
+	return (info.tcpi_options & TCPI_OPT_SYN_DATA) != 0;
+}
+
+/**
+ * Retrieves TCP_INFO for a TCP socket.
+ * @return The connection's current TCP state and statistics.
+ */
+TcpInfo Socket::tcp_info() const
+{
+	struct tcp_info native;
+	size_t native_size = sizeof(native);
+	bzero(&native, sizeof(native));
+
+	// Older kernels return a shorter structure, leaving the newer fields zero.
+	try {
+		get_option_raw(IPPROTO_TCP, TCP_INFO, &native, &native_size);
+	} catch (const SocketException& ex) {
+		throw SocketException("Unable to retrieve TCP_INFO", ex);
+	}
+
+	TcpInfo info;
+	info.state = native.tcpi_state;
+	info.rtt_us = native.tcpi_rtt;
+	info.rtt_variance_us = native.tcpi_rttvar;
+	info.congestion_window = native.tcpi_snd_cwnd;
+	info.send_mss = native.tcpi_snd_mss;
+	info.unacked = native.tcpi_unacked;
+	info.lost = native.tcpi_lost;
+	info.total_retransmits = native.tcpi_total_retrans;
+	info.delivery_rate = native.tcpi_delivery_rate;
+	info.bytes_acked = native.tcpi_bytes_acked;
+	info.bytes_received = native.tcpi_bytes_received;
+	info.busy_time_us = native.tcpi_busy_time;
+	info.rwnd_limited_us = native.tcpi_rwnd_limited;
+	info.sndbuf_limited_us = native.tcpi_sndbuf_limited;
+
+	return info;
+}
+
+/**
+ * Returns the number of bytes in the send queue (SIOCOUTQ).  For TCP, this is the data
+ * that has not yet been acknowledged by the peer.
+ */
+size_t Socket::send_queue() const
+{
+	int count;
+	if (::ioctl(fd(), SIOCOUTQ, &count) < 0) {
+		throw SocketException("Unable to query send queue");
+	}
+
+	return (size_t)count;
+}
+
+/**
+ * Returns the number of bytes in the receive queue (SIOCINQ) that have not yet been read.
+ */
+size_t Socket::receive_queue() const
+{
+	int count;
+	if (::ioctl(fd(), SIOCINQ, &count) < 0) {
+		throw SocketException("Unable to query receive queue");
+	}
+
+	return (size_t)count;
+}
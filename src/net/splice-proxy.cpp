@@ -0,0 +1,162 @@
+/**
+ * src/net/splice-proxy.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/net/splice-proxy.h>
+
+#include <errno.h>
+
+using namespace sfd;
+using namespace sfd::net;
+
+/**
+ * Constructs a new splice proxy between two connected sockets.  Both sockets are placed
+ * into non-blocking mode.
+ * @param a The first socket.
+ * @param b The second socket.
+ * @param pipe_capacity The capacity of each intermediate pipe, or zero for the system default.
+ */
+SpliceProxy::SpliceProxy(Socket& a, Socket& b, size_t pipe_capacity)
+	: _a(a), _b(b), _a_to_b(a, b), _b_to_a(b, a)
+{
+	if (pipe_capacity) {
+		_a_to_b.pipe.capacity(pipe_capacity);
+		_b_to_a.pipe.capacity(pipe_capacity);
+	}
+
+	_capacity = _a_to_b.pipe.capacity();
+
+	_a.non_blocking(true);
+	_b.non_blocking(true);
+}
+
+/**
+ * Registers both sockets with the given epoll instance.  The sockets are registered
+ * edge-triggered, so the proxy must be pumped whenever either of them becomes ready.
+ * @param epoll The epoll instance that will drive this proxy.
+ */
+void SpliceProxy::attach(Epoll& epoll)
+{
+	EpollEventType::EpollEventType events = EpollEventType::IN | EpollEventType::OUT | EpollEventType::RDHUP | EpollEventType::ET;
+
+	epoll.add(&_a, events);
+	epoll.add(&_b, events);
+}
+
+/**
+ * Removes both sockets from the given epoll instance.
+ * @param epoll The epoll instance the proxy was attached to.
+ */
+void SpliceProxy::detach(Epoll& epoll)
+{
+	epoll.remove(&_a);
+	epoll.remove(&_b);
+}
+
+/**
+ * Handles a readiness event, if it belongs to one of the proxied sockets.
+ * @param event The event returned from Epoll::wait.
+ * @return True if the event was consumed by this proxy.
+ */
+bool SpliceProxy::handle(const EpollEvent& event)
+{
+	if (event.fd != &_a && event.fd != &_b) {
+		return false;
+	}
+
+	// Readiness on either socket can unblock both directions (one socket being readable
+	// feeds one direction, and the same socket being writable drains the other).
+	pump();
+	return true;
+}
+
+/**
+ * Moves as much data as possible in both directions, until every socket would block.
+ */
+void SpliceProxy::pump()
+{
+	bool progress;
+
+	do {
+		progress = _a_to_b.pump(_capacity);
+		progress |= _b_to_a.pump(_capacity);
+	} while (progress);
+}
+
+SpliceProxy::Direction::Direction(Socket& source, Socket& destination)
+	: source(source), destination(destination), pipe(true),
+		buffered(0), bytes(0), source_closed(false), destination_shut(false)
+{
+}
+
+/**
+ * Performs one round of splicing in this direction.
+ * @param capacity The capacity of the intermediate pipe.
+ * @return True if any bytes were moved, or the state of the direction changed.
+ */
+bool SpliceProxy::Direction::pump(size_t capacity)
+{
+	bool progress = false;
+
+	// Fill the pipe from the source socket.
+	if (!source_closed && buffered < capacity) {
+		int rc = pipe.splice_in(source, capacity - buffered, SpliceFlags::MOVE | SpliceFlags::NON_BLOCK);
+
+		if (rc > 0) {
+			buffered += rc;
+			progress = true;
+		} else if (rc == 0 || (errno != EAGAIN && errno != EINTR)) {
+			// End-of-stream (or a fatal error) on the source: forward whatever is
+			// still buffered, and then propagate the half-close.
+			source_closed = true;
+			progress = true;
+		}
+	}
+
+	// Drain the pipe into the destination socket.
+	if (buffered > 0) {
+		int rc = pipe.splice_out(destination, buffered, SpliceFlags::MOVE | SpliceFlags::NON_BLOCK);
+
+		if (rc > 0) {
+			buffered -= rc;
+			bytes += rc;
+			progress = true;
+		} else if (rc < 0 && errno != EAGAIN && errno != EINTR) {
+			// The destination has gone away, so there is nowhere for this direction's
+			// data to go.  Drop it, and stop reading from the source.
+			buffered = 0;
+			source_closed = true;
+			progress = true;
+
+			try {
+				source.shutdown(ShutdownModes::Read);
+			} catch (const SocketException&) {
+			}
+		}
+	}
+
+	if (source_closed && buffered == 0 && !destination_shut) {
+		destination_shut = true;
+
+		try {
+			destination.shutdown(ShutdownModes::Write);
+		} catch (const SocketException&) {
+		}
+	}
+
+	return progress;
+}
@@ -0,0 +1,235 @@
+/**
+ * src/net/tcp-info-sampler.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/net/tcp-info-sampler.h>
+
+#include <sstream>
+
+using namespace sfd;
+using namespace sfd::net;
+
+/**
+ * Constructs a new sampler, with no connections.
+ * @param interval_ns The time between samples, in nanoseconds.
+ */
+TcpInfoSampler::TcpInfoSampler(uint64_t interval_ns) : _interval_ns(interval_ns)
+{
+	if (!_interval_ns) {
+		throw TcpInfoSamplerException("Sampling interval must be non-zero");
+	}
+
+	reset();
+}
+
+/**
+ * Changes the sampling rate.  This takes effect immediately if the sampler is attached.
+ * @param interval_ns The time between samples, in nanoseconds.
+ */
+void TcpInfoSampler::interval(uint64_t interval_ns)
+{
+	if (!interval_ns) {
+		throw TcpInfoSamplerException("Sampling interval must be non-zero");
+	}
+
+	_interval_ns = interval_ns;
+	_timer.arm(_interval_ns, _interval_ns);
+}
+
+/**
+ * Adds a connected TCP socket to the set of sampled connections.  The socket must be
+ * removed before it is destroyed.
+ * @param socket The socket to sample.
+ */
+void TcpInfoSampler::add(Socket& socket)
+{
+	Connection& connection = _connections[&socket];
+	connection.sampled = false;
+}
+
+/**
+ * Removes a socket from the set of sampled connections.
+ * @param socket The socket to stop sampling.
+ */
+void TcpInfoSampler::remove(Socket& socket)
+{
+	_connections.erase(&socket);
+}
+
+/**
+ * Registers the sampling timer with the given epoll instance, and starts it.
+ * @param epoll The epoll instance that will drive this sampler.
+ */
+void TcpInfoSampler::attach(Epoll& epoll)
+{
+	epoll.add(&_timer, EpollEventType::IN);
+	_timer.arm(_interval_ns, _interval_ns);
+}
+
+/**
+ * Stops the sampling timer, and removes it from the given epoll instance.
+ * @param epoll The epoll instance the sampler was attached to.
+ */
+void TcpInfoSampler::detach(Epoll& epoll)
+{
+	_timer.disarm();
+	epoll.remove(&_timer);
+}
+
+/**
+ * Handles a readiness event, if it belongs to the sampling timer, by taking a sample.
+ * @param event The event returned from Epoll::wait.
+ * @return True if the event was consumed by this sampler.
+ */
+bool TcpInfoSampler::handle(const EpollEvent& event)
+{
+	if (event.fd != &_timer) {
+		return false;
+	}
+
+	// Samples missed because the loop was busy are not made up, since they would all observe
+	// the same state.
+	if (_timer.acknowledge() > 0) {
+		sample();
+	}
+
+	return true;
+}
+
+/**
+ * Samples every connection immediately, and adds the results to the aggregate.
+ */
+void TcpInfoSampler::sample()
+{
+	for (auto& entry : _connections) {
+		Socket& socket = *entry.first;
+		Connection& connection = entry.second;
+
+		TcpInfo info;
+		size_t send_queue, receive_queue;
+
+		try {
+			info = socket.tcp_info();
+			send_queue = socket.send_queue();
+			receive_queue = socket.receive_queue();
+		} catch (const SocketException&) {
+			_health.failed_samples++;
+			continue;
+		}
+
+		_health.samples++;
+		_health.rtt_us.record(info.rtt_us);
+		_health.rtt_variance_us.record(info.rtt_variance_us);
+		_health.congestion_window.record(info.congestion_window);
+		_health.delivery_rate.record(info.delivery_rate);
+		_health.send_queue.record(send_queue);
+		_health.receive_queue.record(receive_queue);
+
+		// The first sample of a connection only establishes the baseline for the cumulative
+		// counters, so that time spent before it was added is not attributed to this period.
+		if (connection.sampled) {
+			const TcpInfo& last = connection.last;
+
+			if (info.total_retransmits > last.total_retransmits) {
+				_health.retransmits += info.total_retransmits - last.total_retransmits;
+			}
+
+			if (info.busy_time_us > last.busy_time_us) {
+				_health.busy_time_us += info.busy_time_us - last.busy_time_us;
+			}
+
+			if (info.rwnd_limited_us > last.rwnd_limited_us) {
+				_health.rwnd_limited_us += info.rwnd_limited_us - last.rwnd_limited_us;
+			}
+
+			if (info.sndbuf_limited_us > last.sndbuf_limited_us) {
+				_health.sndbuf_limited_us += info.sndbuf_limited_us - last.sndbuf_limited_us;
+			}
+		}
+
+		connection.last = info;
+		connection.sampled = true;
+	}
+
+	_health.timestamp_ns = metrics::now();
+	_health.connections = _connections.size();
+}
+
+/**
+ * Returns the most recent sample of the given connection, or NULL if it has not been sampled.
+ * @param socket The sampled socket.
+ */
+const TcpInfo *TcpInfoSampler::latest(const Socket& socket) const
+{
+	auto connection = _connections.find(const_cast<Socket *>(&socket));
+	if (connection == _connections.end() || !connection->second.sampled) {
+		return NULL;
+	}
+
+	return &connection->second.last;
+}
+
+/**
+ * Clears the aggregate.  The per-connection baselines are kept, so the next sample still
+ * contributes to the cumulative totals.
+ */
+void TcpInfoSampler::reset()
+{
+	_health.timestamp_ns = metrics::now();
+	_health.connections = _connections.size();
+	_health.samples = 0;
+	_health.failed_samples = 0;
+
+	_health.rtt_us.reset();
+	_health.rtt_variance_us.reset();
+	_health.congestion_window.reset();
+	_health.delivery_rate.reset();
+	_health.send_queue.reset();
+	_health.receive_queue.reset();
+
+	_health.retransmits = 0;
+	_health.busy_time_us = 0;
+	_health.rwnd_limited_us = 0;
+	_health.sndbuf_limited_us = 0;
+}
+
+std::string TcpHealth::to_string() const
+{
+	std::ostringstream out;
+
+	out << "timestamp_ns " << timestamp_ns << "\n";
+	out << "connections " << connections << "\n";
+	out << "samples " << samples << "\n";
+	out << "failed_samples " << failed_samples << "\n";
+	out << "retransmits " << retransmits << "\n";
+	out << "busy_time_us " << busy_time_us << "\n";
+	out << "rwnd_limited_us " << rwnd_limited_us << "\n";
+	out << "sndbuf_limited_us " << sndbuf_limited_us << "\n";
+
+	const metrics::LatencyHistogram *histograms[] = { &rtt_us, &rtt_variance_us, &congestion_window, &delivery_rate, &send_queue, &receive_queue };
+	const char *histogram_names[] = { "rtt_us", "rtt_variance_us", "congestion_window", "delivery_rate", "send_queue", "receive_queue" };
+
+	for (unsigned int i = 0; i < 6; i++) {
+		out << histogram_names[i] << ".count " << histograms[i]->count() << "\n";
+		out << histogram_names[i] << ".p50 " << histograms[i]->percentile(50) << "\n";
+		out << histogram_names[i] << ".p99 " << histograms[i]->percentile(99) << "\n";
+		out << histogram_names[i] << ".p999 " << histograms[i]->percentile(99.9) << "\n";
+		out << histogram_names[i] << ".max " << histograms[i]->max() << "\n";
+	}
+
+	return out.str();
+}
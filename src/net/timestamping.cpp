@@ -0,0 +1,238 @@
+/**
+ * src/net/timestamping.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/net/socket.h>
+#include <sfd/net/timestamping.h>
+
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <net/if.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <linux/sockios.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+using namespace sfd;
+using namespace sfd::net;
+
+static uint64_t timespec_to_ns(const struct timespec& ts)
+{
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/**
+ * Parses the SCM_TIMESTAMPING control message of a received message, if there is one.
+ */
+static void parse_timestamps(struct msghdr& msg, PacketTimestamps& timestamps)
+{
+	timestamps.software_ns = 0;
+	timestamps.hardware_ns = 0;
+
+	for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPING) {
+			struct scm_timestamping ts;
+			memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+
+			// Index 0 holds the software timestamp, and index 2 the raw hardware timestamp.
+			timestamps.software_ns = timespec_to_ns(ts.ts[0]);
+			timestamps.hardware_ns = timespec_to_ns(ts.ts[2]);
+		}
+	}
+}
+
+/**
+ * Enables kernel timestamping of the packets sent and received on this socket (SO_TIMESTAMPING).
+ * Receive timestamps are returned by recv_timestamped, and transmit timestamps by recv_tx_timestamp.
+ * @param flags Which timestamps to generate.  Software timestamps work on any interface,
+ * including loopback.
+ */
+void Socket::enable_timestamping(TimestampingFlags::TimestampingFlags flags)
+{
+	int native_flags = 0;
+
+	if (flags & TimestampingFlags::SOFTWARE_RX) {
+		native_flags |= SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+	}
+
+	if (flags & TimestampingFlags::SOFTWARE_TX) {
+		native_flags |= SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+	}
+
+	if (flags & TimestampingFlags::HARDWARE_RX) {
+		native_flags |= SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+	}
+
+	if (flags & TimestampingFlags::HARDWARE_TX) {
+		native_flags |= SOF_TIMESTAMPING_TX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+	}
+
+	if (flags & (TimestampingFlags::SOFTWARE_TX | TimestampingFlags::HARDWARE_TX)) {
+		// Tag each transmit timestamp with the send it belongs to, and don't loop the packet
+		// payload back onto the error queue with it.
+		native_flags |= SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+	}
+
+	try {
+		set_option(SOL_SOCKET, SO_TIMESTAMPING, native_flags);
+	} catch (const SocketException& ex) {
+		throw SocketException("Unable to enable timestamping", ex);
+	}
+}
+
+/**
+ * Enables hardware timestamping of all packets on a network interface (SIOCSHWTSTAMP).  This
+ * requires CAP_NET_ADMIN, and a device that supports it.
+ * @param device_name The name of the network interface.
+ * @param transmit Whether to timestamp transmitted packets, as well as received packets.
+ * @return True if hardware timestamping was enabled, or false if it is not available.
+ */
+bool Socket::enable_device_timestamping(const std::string& device_name, bool transmit)
+{
+	struct hwtstamp_config config;
+	bzero(&config, sizeof(config));
+	config.tx_type = transmit ? HWTSTAMP_TX_ON : HWTSTAMP_TX_OFF;
+	config.rx_filter = HWTSTAMP_FILTER_ALL;
+
+	struct ifreq ifr;
+	bzero(&ifr, sizeof(ifr));
+	strncpy(ifr.ifr_name, device_name.c_str(), sizeof(ifr.ifr_name) - 1);
+	ifr.ifr_data = (char *)&config;
+
+	return ::ioctl(fd(), SIOCSHWTSTAMP, &ifr) == 0;
+}
+
+/**
+ * Receives a message, along with the kernel's timestamps of its arrival.  Timestamping must
+ * have been enabled with enable_timestamping.
+ * @param buffer The buffer to receive the message into.
+ * @param length The size of the buffer.
+ * @param timestamps Populated with the timestamps of the message.  Timestamps that were not
+ * generated are zero.
+ * @return The number of bytes received.
+ */
+size_t Socket::recv_timestamped(void* buffer, size_t length, PacketTimestamps& timestamps)
+{
+	char control[CMSG_SPACE(sizeof(struct scm_timestamping))];
+
+	struct iovec iov;
+	iov.iov_base = buffer;
+	iov.iov_len = length;
+
+	struct msghdr msg;
+	bzero(&msg, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	ssize_t rc = ::recvmsg(fd(), &msg, 0);
+	SFD_METRIC_SYSCALL(SOCKET, rc);
+	account_received(rc);
+
+	if (rc < 0) {
+		throw SocketException("Unable to receive message");
+	}
+
+	parse_timestamps(msg, timestamps);
+	return (size_t)rc;
+}
+
+/**
+ * Reads one transmit timestamp from the socket's error queue.  This never blocks.  The error
+ * queue makes the socket readable (EPOLLERR) when a timestamp is waiting.
+ * @param timestamp Populated with the transmit timestamp.
+ * @return True if a timestamp was read, or false if the error queue held no timestamps.
+ */
+bool Socket::recv_tx_timestamp(TxTimestamp& timestamp)
+{
+	char control[CMSG_SPACE(sizeof(struct scm_timestamping)) + CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in6))];
+
+	for (;;) {
+		struct msghdr msg;
+		bzero(&msg, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		ssize_t rc = ::recvmsg(fd(), &msg, MSG_ERRQUEUE | MSG_DONTWAIT);
+		SFD_METRIC_SYSCALL(SOCKET, rc);
+
+		if (rc < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				return false;
+			}
+
+			throw SocketException("Unable to read error queue");
+		}
+
+		bool is_timestamp = false;
+
+		for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if ((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+					(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)) {
+				struct sock_extended_err err;
+				memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+
+				if (err.ee_errno == ENOMSG && err.ee_origin == SO_EE_ORIGIN_TIMESTAMPING) {
+					is_timestamp = true;
+					timestamp.id = err.ee_data;
+					timestamp.type = (TxTimestampType::TxTimestampType)err.ee_info;
+				}
+			}
+		}
+
+		// Skip anything else on the error queue (e.g. ICMP errors), so that they do not hide
+		// the timestamps behind them.
+		if (is_timestamp) {
+			parse_timestamps(msg, timestamp.timestamps);
+			return true;
+		}
+	}
+}
+
+/**
+ * Records the kernel-to-user latency of a received packet, measured from its software
+ * receive timestamp to now.
+ * @param timestamps The timestamps of the packet.
+ * @return True if the latency was recorded, or false if the packet had no software timestamp.
+ */
+bool KernelLatency::record(const PacketTimestamps& timestamps)
+{
+	if (!timestamps.software_ns) {
+		return false;
+	}
+
+	uint64_t now = realtime_now();
+	_histogram.record(now > timestamps.software_ns ? now - timestamps.software_ns : 0);
+
+	return true;
+}
+
+/**
+ * Returns the current time on the clock used for software timestamps (CLOCK_REALTIME), in
+ * nanoseconds since the epoch.
+ */
+uint64_t KernelLatency::realtime_now()
+{
+	struct timespec ts;
+	::clock_gettime(CLOCK_REALTIME, &ts);
+
+	return timespec_to_ns(ts);
+}
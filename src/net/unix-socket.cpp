@@ -0,0 +1,179 @@
+/**
+ * src/net/unix-socket.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/net/socket.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+using namespace sfd;
+using namespace sfd::net;
+
+UnixSocket::UnixSocket(SocketType::SocketType type)
+	: Socket(AddressFamily::Unix, type, ProtocolType::None)
+{
+
+}
+
+UnixSocket::UnixSocket(FileDescriptor::NativeFD fd, SocketType::SocketType type)
+	: Socket(fd, AddressFamily::Unix, type, ProtocolType::None, NULL)
+{
+
+}
+
+/**
+ * Accepts a new connection pending on this socket.
+ * @return A new Unix socket representing the client connection, or NULL on error.
+ */
+UnixSocket* UnixSocket::accept()
+{
+	int new_fd = ::accept4(fd(), NULL, NULL, SOCK_CLOEXEC);
+	if (new_fd < 0) {
+		return NULL;
+	}
+
+	return new UnixSocket(new_fd, (SocketType::SocketType)get_option<int>(SOL_SOCKET, SO_TYPE));
+}
+
+/**
+ * Creates a pair of connected, unnamed Unix sockets.
+ * @param type The type of the sockets.
+ * @param first Populated with the first socket of the pair.
+ * @param second Populated with the second socket of the pair.
+ */
+void UnixSocket::pair(SocketType::SocketType type, UnixSocket *& first, UnixSocket *& second)
+{
+	int fds[2];
+
+	if (::socketpair(AF_UNIX, (int)type | SOCK_CLOEXEC, 0, fds) < 0) {
+		throw SocketException("Unable to create socket pair");
+	}
+
+	first = new UnixSocket(fds[0], type);
+	second = new UnixSocket(fds[1], type);
+}
+
+/**
+ * Sends a message, along with copies of the given file descriptors (SCM_RIGHTS).  The
+ * receiving process gets new file descriptors referring to the same open files.
+ * @param message The message to send.  This must be at least one byte long.
+ * @param length The length of the message.
+ * @param fds The native file descriptors to pass.
+ * @return The number of bytes of the message sent.
+ */
+size_t UnixSocket::send_with_fds(const void* message, size_t length, const std::vector<FileDescriptor::NativeFD>& fds)
+{
+	if (fds.size() > MaxFDsPerMessage) {
+		throw SocketException("Too many file descriptors in one message");
+	}
+
+	char control[CMSG_SPACE(sizeof(int) * MaxFDsPerMessage)];
+	bzero(control, sizeof(control));
+
+	struct iovec iov;
+	iov.iov_base = (void *)message;
+	iov.iov_len = length;
+
+	struct msghdr msg;
+	bzero(&msg, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	if (!fds.empty()) {
+		msg.msg_control = control;
+		msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+
+		struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+		memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+	}
+
+	ssize_t rc = ::sendmsg(fd(), &msg, MSG_NOSIGNAL);
+	SFD_METRIC_SYSCALL(SOCKET, rc);
+	account_sent(rc);
+
+	if (rc < 0) {
+		throw SocketException("Unable to send message");
+	}
+
+	return (size_t)rc;
+}
+
+/**
+ * Receives a message, along with any file descriptors passed with it.  Received file
+ * descriptors are owned by the caller, and are marked close-on-exec.
+ * @param buffer The buffer to receive the message into.
+ * @param length The size of the buffer.
+ * @param fds A list to populate with received native file descriptors.  This list is NOT cleared.
+ * @return The number of bytes of the message received, or zero if the peer has closed the connection.
+ */
+size_t UnixSocket::recv_with_fds(void* buffer, size_t length, std::vector<FileDescriptor::NativeFD>& fds)
+{
+	char control[CMSG_SPACE(sizeof(int) * MaxFDsPerMessage)];
+
+	struct iovec iov;
+	iov.iov_base = buffer;
+	iov.iov_len = length;
+
+	struct msghdr msg;
+	bzero(&msg, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	ssize_t rc = ::recvmsg(fd(), &msg, MSG_CMSG_CLOEXEC);
+	SFD_METRIC_SYSCALL(SOCKET, rc);
+	account_received(rc);
+
+	if (rc < 0) {
+		throw SocketException("Unable to receive message");
+	}
+
+	size_t first_received = fds.size();
+
+	for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+			continue;
+		}
+
+		size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		const int *received = (const int *)CMSG_DATA(cmsg);
+
+		for (size_t i = 0; i < count; i++) {
+			fds.push_back(received[i]);
+		}
+	}
+
+	if (msg.msg_flags & MSG_CTRUNC) {
+		// Some descriptors were discarded by the kernel, so the message cannot be trusted.
+		for (size_t i = first_received; i < fds.size(); i++) {
+			::close(fds[i]);
+		}
+
+		fds.resize(first_received);
+		throw SocketException("File descriptors truncated whilst receiving message");
+	}
+
+	return (size_t)rc;
+}
@@ -0,0 +1,234 @@
+/**
+ * src/parallel-file-reader.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/parallel-file-reader.h>
+#include <sfd/metrics.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace sfd;
+
+/**
+ * Constructs a parallel reader for the given file, and starts the worker threads.
+ * @param file The file to read.  Its file offset is not used or changed.
+ * @param chunk_size The size of each chunk delivered to the consumer.
+ * @param workers The number of threads issuing reads.
+ * @param window The maximum number of chunks fetched ahead of the consumer.
+ */
+ParallelFileReader::ParallelFileReader(RegularFile& file, size_t chunk_size, unsigned int workers, unsigned int window)
+	: _file(file),
+		_file_size(file.size()),
+		_chunk_size(chunk_size),
+		_next_fetch(0),
+		_next_deliver(0),
+		_released(0),
+		_holding(false),
+		_stop(false),
+		_error(false),
+		_bytes_read(0),
+		_worker_stall(0),
+		_consumer_stall(0)
+{
+	if (chunk_size == 0 || workers == 0 || window == 0) {
+		throw ParallelFileReaderException("Invalid parallel reader configuration");
+	}
+
+	_total_chunks = (_file_size + _chunk_size - 1) / _chunk_size;
+
+	// There is no point in keeping more chunks in flight than the file has.
+	if (window > _total_chunks) {
+		window = _total_chunks ? _total_chunks : 1;
+	}
+
+	_slots.resize(window);
+	for (Slot& slot : _slots) {
+		slot.buffer.resize(_chunk_size);
+		slot.size = 0;
+		slot.ready = false;
+	}
+
+	::posix_fadvise(_file.fd(), 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	_start_time = now();
+
+	for (unsigned int i = 0; i < workers; i++) {
+		_workers.push_back(std::thread(&ParallelFileReader::worker, this));
+	}
+}
+
+/**
+ * Stops the worker threads, and waits for any outstanding reads to finish.
+ */
+ParallelFileReader::~ParallelFileReader()
+{
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+		_stop = true;
+	}
+
+	_slot_freed.notify_all();
+
+	for (std::thread& worker : _workers) {
+		worker.join();
+	}
+}
+
+/**
+ * Retrieves the next chunk of the file, in file order, waiting for it to be read if necessary.
+ * Retrieving a chunk releases the previously retrieved chunk back to the prefetch window.
+ * @param chunk Populated with the next chunk.
+ * @return True if a chunk was retrieved, or false at end-of-file.
+ */
+bool ParallelFileReader::next(FileChunk& chunk)
+{
+	std::unique_lock<std::mutex> guard(_lock);
+
+	if (_holding) {
+		_slots[(_next_deliver - 1) % _slots.size()].ready = false;
+		_released++;
+		_holding = false;
+
+		_slot_freed.notify_all();
+	}
+
+	if (_next_deliver == _total_chunks) {
+		return false;
+	}
+
+	Slot& slot = _slots[_next_deliver % _slots.size()];
+
+	if (!slot.ready && !_error) {
+		uint64_t stall_start = now();
+		_chunk_ready.wait(guard, [&] { return slot.ready || _error; });
+		_consumer_stall += now() - stall_start;
+	}
+
+	if (_error) {
+		throw ParallelFileReaderException("Error whilst reading file");
+	}
+
+	chunk.offset = _next_deliver * _chunk_size;
+	chunk.data = slot.buffer.data();
+	chunk.size = slot.size;
+
+	_next_deliver++;
+	_holding = true;
+
+	return true;
+}
+
+/**
+ * Returns a snapshot of the reader's progress.
+ */
+ParallelReadStatistics ParallelFileReader::statistics() const
+{
+	std::lock_guard<std::mutex> guard(_lock);
+
+	ParallelReadStatistics stats;
+	stats.bytes_read = _bytes_read;
+	stats.chunks_delivered = _next_deliver;
+	stats.elapsed_ns = now() - _start_time;
+	stats.worker_stall_ns = _worker_stall;
+	stats.consumer_stall_ns = _consumer_stall;
+
+	return stats;
+}
+
+void ParallelFileReader::worker()
+{
+	std::unique_lock<std::mutex> guard(_lock);
+
+	for (;;) {
+		// Wait until the next chunk falls inside the prefetch window, i.e. until the
+		// consumer has released the chunk that last occupied its slot.
+		if (!_stop && _next_fetch < _total_chunks && _next_fetch >= _released + _slots.size()) {
+			uint64_t stall_start = now();
+			_slot_freed.wait(guard, [&] { return _stop || _next_fetch >= _total_chunks || _next_fetch < _released + _slots.size(); });
+			_worker_stall += now() - stall_start;
+		}
+
+		if (_stop || _error || _next_fetch >= _total_chunks) {
+			return;
+		}
+
+		uint64_t index = _next_fetch++;
+		Slot& slot = _slots[index % _slots.size()];
+
+		guard.unlock();
+		bool ok = read_chunk(index, slot);
+		guard.lock();
+
+		if (ok) {
+			slot.ready = true;
+			_bytes_read += slot.size;
+		} else {
+			_error = true;
+		}
+
+		_chunk_ready.notify_all();
+	}
+}
+
+/**
+ * Reads one chunk into its slot.
+ * @return True if the chunk was read successfully.
+ */
+bool ParallelFileReader::read_chunk(uint64_t index, Slot& slot)
+{
+	uint64_t offset = index * _chunk_size;
+	size_t length = _chunk_size;
+
+	if (offset + length > _file_size) {
+		length = _file_size - offset;
+	}
+
+	size_t done = 0;
+	while (done < length) {
+		ssize_t rc = ::pread(_file.fd(), slot.buffer.data() + done, length - done, (off_t)(offset + done));
+		SFD_METRIC_SYSCALL(REGULAR_FILE, rc);
+
+		if (rc < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			return false;
+		}
+
+		if (rc == 0) {
+			// The file was truncated underneath us.
+			break;
+		}
+
+		done += rc;
+	}
+
+	slot.size = done;
+	return true;
+}
+
+uint64_t ParallelFileReader::now() const
+{
+	struct timespec ts;
+	::clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
@@ -0,0 +1,187 @@
+/**
+ * src/pipe.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/pipe.h>
+#include <sfd/metrics.h>
+
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+using namespace sfd;
+
+/**
+ * Creates a new managed pipe.
+ * @param non_blocking Whether or not both ends of the pipe should be placed into non-blocking mode.
+ */
+Pipe::Pipe(bool non_blocking) : Pipe(create_pipe(non_blocking))
+{
+	if (!_read_end.valid() || !_write_end.valid()) {
+		throw PipeException("Error whilst creating pipe");
+	}
+}
+
+/**
+ * Constructs the managed pipe from a pair of native file-descriptors.
+ * @param fds The read end and the write end of the pipe, respectively.
+ */
+Pipe::Pipe(const std::pair<FileDescriptor::NativeFD, FileDescriptor::NativeFD>& fds)
+	: _read_end(fds.first), _write_end(fds.second)
+{
+}
+
+std::pair<FileDescriptor::NativeFD, FileDescriptor::NativeFD> Pipe::create_pipe(bool non_blocking)
+{
+	int fds[2];
+
+	if (::pipe2(fds, O_CLOEXEC | (non_blocking ? O_NONBLOCK : 0)) < 0) {
+		return std::make_pair(-1, -1);
+	}
+
+	return std::make_pair(fds[0], fds[1]);
+}
+
+/**
+ * Returns the number of bytes the pipe can hold before writes to it block.
+ */
+size_t Pipe::capacity() const
+{
+	int size = ::fcntl(_write_end.fd(), F_GETPIPE_SZ);
+	if (size < 0) {
+		throw PipeException("Unable to query pipe capacity");
+	}
+
+	return (size_t)size;
+}
+
+/**
+ * Adjusts the capacity of the pipe.  The kernel rounds the requested size up to a
+ * power-of-two number of pages, and will refuse to grow an unprivileged pipe beyond
+ * /proc/sys/fs/pipe-max-size.
+ * @param size The requested capacity of the pipe, in bytes.
+ */
+void Pipe::capacity(size_t size)
+{
+	if (::fcntl(_write_end.fd(), F_SETPIPE_SZ, (int)size) < 0) {
+		throw PipeException("Unable to set pipe capacity");
+	}
+}
+
+/**
+ * Returns the number of bytes currently waiting to be read from the pipe.
+ */
+size_t Pipe::available() const
+{
+	int count;
+	if (::ioctl(_read_end.fd(), FIONREAD, &count) < 0) {
+		throw PipeException("Unable to query pipe contents");
+	}
+
+	return (size_t)count;
+}
+
+/**
+ * Moves data from the given file descriptor into the pipe, without copying it through userspace.
+ * @param source The file descriptor to read data from.
+ * @param length The maximum number of bytes to move.
+ * @param flags Flags controlling the splice operation.
+ * @return The number of bytes moved, zero at end-of-file, or -1 on error (with errno set).
+ */
+int Pipe::splice_in(FileDescriptor& source, size_t length, SpliceFlags::SpliceFlags flags)
+{
+	int rc = ::splice(source.fd(), NULL, _write_end.fd(), NULL, length, sfd_flags_to_native_flags(flags));
+	SFD_METRIC_SYSCALL(PIPE, rc);
+
+	return rc;
+}
+
+/**
+ * Moves data out of the pipe into the given file descriptor, without copying it through userspace.
+ * Unlike send, splice has no MSG_NOSIGNAL, so SIGPIPE is blocked for the duration of the call,
+ * and a closed destination is reported as EPIPE rather than by killing the process.
+ * @param destination The file descriptor to write data to.
+ * @param length The maximum number of bytes to move.
+ * @param flags Flags controlling the splice operation.
+ * @return The number of bytes moved, or -1 on error (with errno set).
+ */
+int Pipe::splice_out(FileDescriptor& destination, size_t length, SpliceFlags::SpliceFlags flags)
+{
+	sigset_t sigpipe, previous;
+	sigemptyset(&sigpipe);
+	sigaddset(&sigpipe, SIGPIPE);
+
+	pthread_sigmask(SIG_BLOCK, &sigpipe, &previous);
+
+	int rc = ::splice(_read_end.fd(), NULL, destination.fd(), NULL, length, sfd_flags_to_native_flags(flags));
+	SFD_METRIC_SYSCALL(PIPE, rc);
+
+	// If SIGPIPE was already blocked by the caller, leave any pending signal for the caller to
+	// deal with.  Otherwise, it could not have been pending before the call, so one raised by
+	// this splice is discarded before it is unblocked.
+	if (rc < 0 && errno == EPIPE && !sigismember(&previous, SIGPIPE)) {
+		struct timespec no_wait = { 0, 0 };
+
+		while (::sigtimedwait(&sigpipe, NULL, &no_wait) < 0 && errno == EINTR) {
+		}
+
+		errno = EPIPE;
+	}
+
+	int saved_errno = errno;
+	pthread_sigmask(SIG_SETMASK, &previous, NULL);
+	errno = saved_errno;
+
+	return rc;
+}
+
+/**
+ * Duplicates data from this pipe into another pipe, without consuming it from this pipe and
+ * without copying it through userspace.
+ * @param destination The pipe to duplicate data into.
+ * @param length The maximum number of bytes to duplicate.
+ * @param flags Flags controlling the tee operation.
+ * @return The number of bytes duplicated, or -1 on error (with errno set).
+ */
+int Pipe::tee(Pipe& destination, size_t length, SpliceFlags::SpliceFlags flags)
+{
+	int rc = ::tee(_read_end.fd(), destination._write_end.fd(), length, sfd_flags_to_native_flags(flags));
+	SFD_METRIC_SYSCALL(PIPE, rc);
+
+	return rc;
+}
+
+unsigned int Pipe::sfd_flags_to_native_flags(SpliceFlags::SpliceFlags flags)
+{
+	unsigned int native_flags = 0;
+
+	if (flags & SpliceFlags::MOVE) {
+		native_flags |= SPLICE_F_MOVE;
+	}
+
+	if (flags & SpliceFlags::NON_BLOCK) {
+		native_flags |= SPLICE_F_NONBLOCK;
+	}
+
+	if (flags & SpliceFlags::MORE) {
+		native_flags |= SPLICE_F_MORE;
+	}
+
+	return native_flags;
+}
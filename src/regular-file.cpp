@@ -17,8 +17,15 @@
  * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 #include <sfd/regular-file.h>
+#include <sfd/metrics.h>
 
 #include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+#include <vector>
 
 using namespace sfd;
 
@@ -26,7 +33,7 @@ using namespace sfd;
  * Constructs a new managed regular file.
  */
 RegularFile::RegularFile(const std::string& filename, FileOpenMode::FileOpenMode mode) 
-	: FileDescriptor(::open(filename.c_str(), sfd_mode_to_native_mode(mode)))
+	: FileDescriptor(::open(filename.c_str(), sfd_mode_to_native_mode(mode), 0666))
 {
 	if (!valid()) {
 		throw RegularFileException("Error whilst opening file");
@@ -73,3 +80,204 @@ int RegularFile::sfd_mode_to_native_mode(FileOpenMode::FileOpenMode mode)
 	
 	return native_mode;
 }
+
+/**
+ * Returns the current size of the file, in bytes.
+ */
+uint64_t RegularFile::size() const
+{
+	struct stat st;
+
+	if (::fstat(fd(), &st) < 0) {
+		throw RegularFileException("Unable to determine file size");
+	}
+
+	return (uint64_t)st.st_size;
+}
+
+/**
+ * Copies the entire contents of this file into the destination file.  See copy_range_to.
+ * @param destination The file to copy into.  This must have been opened for writing.
+ * @param progress An optional callback to report progress through.
+ * @return The number of bytes copied, and how they were copied.
+ */
+FileCopyResult RegularFile::copy_to(RegularFile& destination, const FileCopyProgress& progress)
+{
+	return copy_range_to(destination, 0, 0, size(), progress);
+}
+
+/**
+ * Copies a range of this file into the destination file, without moving the data through
+ * userspace where possible.  The copy first tries to share the extents with a reflink
+ * (FICLONE/FICLONERANGE, on e.g. XFS or btrfs), then falls back to an in-kernel copy with
+ * copy_file_range, and finally to a buffered read/write loop.  The file offsets of neither
+ * file are changed.
+ * @param destination The file to copy into.  This must have been opened for writing.
+ * @param source_offset The offset in this file to start copying from.
+ * @param destination_offset The offset in the destination file to copy to.
+ * @param length The number of bytes to copy.
+ * @param progress An optional callback to report progress through.
+ * @return The number of bytes copied (which is less than length if this file ends first), and
+ * how they were copied.
+ */
+FileCopyResult RegularFile::copy_range_to(RegularFile& destination, uint64_t source_offset, uint64_t destination_offset, uint64_t length, const FileCopyProgress& progress)
+{
+	FileCopyResult result = { 0, FileCopyMethod::REFLINK };
+
+	if (length == 0) {
+		return result;
+	}
+
+	// A reflink shares the extents rather than copying them, so it is near-free.  Cloning the
+	// whole file also replaces the destination's contents, which is only what the caller
+	// asked for if the range covers the whole of this file, and the destination is empty.
+	uint64_t source_size = size();
+	bool whole_file = source_offset == 0 && destination_offset == 0 && length >= source_size && destination.size() == 0;
+
+	if (reflink_range_to(destination, source_offset, destination_offset, length, whole_file)) {
+		result.bytes_copied = whole_file ? source_size : length;
+
+		if (progress) {
+			progress(result.bytes_copied, length);
+		}
+
+		return result;
+	}
+
+	result.method = FileCopyMethod::COPY_FILE_RANGE;
+	if (copy_file_range_to(destination, source_offset, destination_offset, length, result.bytes_copied, progress)) {
+		return result;
+	}
+
+	// Continue from wherever the in-kernel copy got to.
+	result.method = FileCopyMethod::BUFFERED;
+	buffered_copy_to(destination, source_offset, destination_offset, length, result.bytes_copied, progress);
+
+	return result;
+}
+
+/**
+ * Attempts to reflink a range of this file into the destination file.
+ * @return True if the range was reflinked, or false if the filesystem cannot reflink it.
+ */
+bool RegularFile::reflink_range_to(RegularFile& destination, uint64_t source_offset, uint64_t destination_offset, uint64_t length, bool whole_file)
+{
+	if (whole_file) {
+		return ::ioctl(destination.fd(), FICLONE, fd()) == 0;
+	}
+
+	struct file_clone_range range;
+	range.src_fd = fd();
+	range.src_offset = source_offset;
+	range.src_length = length;
+	range.dest_offset = destination_offset;
+
+	// This fails with EINVAL if the range is not block-aligned, and with EOPNOTSUPP or EXDEV
+	// if the files are not on the same reflink-capable filesystem.
+	return ::ioctl(destination.fd(), FICLONERANGE, &range) == 0;
+}
+
+/**
+ * Copies a range of this file into the destination file with copy_file_range, advancing the
+ * offsets as it goes.
+ * @return True if the copy completed, or false if the remainder needs to be copied some other way.
+ */
+bool RegularFile::copy_file_range_to(RegularFile& destination, uint64_t& source_offset, uint64_t& destination_offset, uint64_t length, uint64_t& copied, const FileCopyProgress& progress)
+{
+	// Copy in large pieces, so that progress can be reported on long copies.
+	const uint64_t piece_size = 64 * 1024 * 1024;
+
+	while (copied < length) {
+		loff_t in_offset = (loff_t)source_offset;
+		loff_t out_offset = (loff_t)destination_offset;
+
+		uint64_t piece = length - copied;
+		if (piece > piece_size) {
+			piece = piece_size;
+		}
+
+		ssize_t rc = ::copy_file_range(fd(), &in_offset, destination.fd(), &out_offset, piece, 0);
+		SFD_METRIC_SYSCALL(REGULAR_FILE, rc);
+
+		if (rc < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			// Cross-filesystem copies on older kernels, and filesystems that do not
+			// support the operation, are copied the slow way.
+			if (errno == EXDEV || errno == ENOSYS || errno == EOPNOTSUPP || errno == EINVAL) {
+				return false;
+			}
+
+			throw RegularFileException("Error whilst copying file");
+		}
+
+		if (rc == 0) {
+			// This file ended before the range did.
+			return true;
+		}
+
+		source_offset += rc;
+		destination_offset += rc;
+		copied += rc;
+
+		if (progress) {
+			progress(copied, length);
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Copies a range of this file into the destination file through a large userspace buffer.
+ */
+void RegularFile::buffered_copy_to(RegularFile& destination, uint64_t source_offset, uint64_t destination_offset, uint64_t length, uint64_t& copied, const FileCopyProgress& progress)
+{
+	std::vector<char> buffer(4 * 1024 * 1024);
+
+	while (copied < length) {
+		uint64_t piece = length - copied;
+		if (piece > buffer.size()) {
+			piece = buffer.size();
+		}
+
+		ssize_t nr_read = ::pread(fd(), buffer.data(), piece, (off_t)source_offset);
+		SFD_METRIC_SYSCALL(REGULAR_FILE, nr_read);
+		if (nr_read < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			throw RegularFileException("Error whilst reading file");
+		}
+
+		if (nr_read == 0) {
+			return;
+		}
+
+		ssize_t nr_written = 0;
+		while (nr_written < nr_read) {
+			ssize_t rc = ::pwrite(destination.fd(), buffer.data() + nr_written, nr_read - nr_written, (off_t)(destination_offset + nr_written));
+			SFD_METRIC_SYSCALL(REGULAR_FILE, rc);
+			if (rc < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+
+				throw RegularFileException("Error whilst writing file");
+			}
+
+			nr_written += rc;
+		}
+
+		source_offset += nr_read;
+		destination_offset += nr_read;
+		copied += nr_read;
+
+		if (progress) {
+			progress(copied, length);
+		}
+	}
+}
@@ -0,0 +1,89 @@
+/**
+ * src/shared-memory.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/shared-memory.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace sfd;
+
+/**
+ * Creates a new shared memory object, and maps it.
+ * @param name A name for the object, which is only used for debugging (e.g. in /proc/self/fd).
+ * @param size The size of the object, in bytes.
+ */
+SharedMemory::SharedMemory(const std::string& name, size_t size)
+	: FileDescriptor(::memfd_create(name.c_str(), MFD_CLOEXEC)), _address(nullptr), _size(size)
+{
+	if (!valid()) {
+		throw SharedMemoryException("Error whilst creating shared memory object");
+	}
+
+	if (::ftruncate(fd(), (off_t)size) < 0) {
+		throw SharedMemoryException("Unable to size shared memory object");
+	}
+
+	map();
+}
+
+/**
+ * Takes ownership of a shared memory object's file descriptor, and maps it.
+ */
+SharedMemory::SharedMemory(FileDescriptor::NativeFD fd) : FileDescriptor(fd), _address(nullptr), _size(0)
+{
+	if (!valid()) {
+		throw SharedMemoryException("Invalid shared memory object");
+	}
+
+	struct stat st;
+	if (::fstat(fd, &st) < 0) {
+		throw SharedMemoryException("Unable to determine size of shared memory object");
+	}
+
+	_size = (size_t)st.st_size;
+	map();
+}
+
+SharedMemory::~SharedMemory()
+{
+	if (_address) {
+		::munmap(_address, _size);
+	}
+}
+
+/**
+ * Maps a shared memory object received from another process.
+ * @param fd The native file descriptor of the object.  Ownership passes to the new object.
+ * @return A new shared memory object.
+ */
+SharedMemory* SharedMemory::adopt(FileDescriptor::NativeFD fd)
+{
+	return new SharedMemory(fd);
+}
+
+void SharedMemory::map()
+{
+	void *address = ::mmap(NULL, _size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd(), 0);
+	if (address == MAP_FAILED) {
+		throw SharedMemoryException("Unable to map shared memory object");
+	}
+
+	_address = address;
+}
@@ -57,6 +57,21 @@ void Signal::signals_to_sigset(sigset_t* raw_sigset, const SignalSet& signals)
 	}
 }
 
+/**
+ * Acknowledges one pending signal, by reading it from the signalfd.
+ * @return The number of the signal, or zero if no signal was pending.
+ */
+int Signal::acknowledge()
+{
+	struct signalfd_siginfo info;
+
+	if (read(&info, sizeof(info)) != sizeof(info)) {
+		return 0;
+	}
+
+	return (int)info.ssi_signo;
+}
+
 Signal::~Signal()
 {
 
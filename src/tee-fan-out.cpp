@@ -0,0 +1,368 @@
+/**
+ * src/tee-fan-out.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/tee-fan-out.h>
+
+#include <errno.h>
+#include <vector>
+
+using namespace sfd;
+
+/**
+ * Constructs a new fan-out stage for the given source.  Sinks are added with add_sink.
+ * @param source The file descriptor to replicate.  This is placed into non-blocking mode.
+ * @param chunk_size The maximum number of bytes to take from the source at a time.
+ */
+TeeFanOut::TeeFanOut(FileDescriptor& source, size_t chunk_size)
+	: _source(source),
+		_chunk_size(chunk_size),
+		_source_closed(false),
+		_source_spliceable(true),
+		_input(true),
+		_discard("/dev/null", FileOpenMode::WRITE),
+		_epoll(nullptr),
+		_received(0)
+{
+	if (_chunk_size == 0) {
+		throw TeeFanOutException("Chunk size must not be zero");
+	}
+
+	// Make sure a whole chunk fits into the input pipe, so that it can always be consumed in
+	// one go after it has been duplicated to every sink.
+	if (_input.capacity() < _chunk_size) {
+		_input.capacity(_chunk_size);
+	}
+
+	_source.non_blocking(true);
+}
+
+TeeFanOut::~TeeFanOut()
+{
+	for (Sink *sink : _sinks) {
+		delete sink;
+	}
+}
+
+/**
+ * Adds a sink to the fan-out stage.  The sink is placed into non-blocking mode, and if the
+ * stage is attached to an epoll instance, it is registered there too.
+ * @param sink The file descriptor to deliver a copy of the stream to.
+ * @param policy What to do when the sink cannot keep up with the source.
+ * @param pipe_capacity The capacity of the sink's pipe, or zero for a default of
+ * DefaultSinkChunks chunks.  This is the amount of data the sink can fall behind by before its
+ * policy is applied, and must be at least two chunks, so that a sink with a partial chunk still
+ * buffered can take the next one.
+ * @return An identifier for the sink, for use with the per-sink accessors.
+ */
+TeeFanOut::SinkID TeeFanOut::add_sink(FileDescriptor& sink, FanOutPolicy::FanOutPolicy policy, size_t pipe_capacity)
+{
+	if (pipe_capacity == 0) {
+		pipe_capacity = DefaultSinkChunks * _chunk_size;
+	} else if (pipe_capacity < 2 * _chunk_size) {
+		throw TeeFanOutException("Sink pipe capacity must be at least two chunks");
+	}
+
+	Sink *new_sink = new Sink(sink, policy);
+
+	try {
+		if (new_sink->pipe.capacity() < pipe_capacity) {
+			new_sink->pipe.capacity(pipe_capacity);
+		}
+	} catch (...) {
+		delete new_sink;
+		throw;
+	}
+
+	new_sink->capacity = new_sink->pipe.capacity();
+	sink.non_blocking(true);
+
+	_sinks.push_back(new_sink);
+
+	if (_epoll) {
+		watch(*new_sink);
+	}
+
+	return (SinkID)(_sinks.size() - 1);
+}
+
+/**
+ * Registers the source and the sinks with the given epoll instance, edge-triggered.  Sinks
+ * added later are registered as they are added.
+ * @param epoll The epoll instance that will drive this fan-out stage.
+ */
+void TeeFanOut::attach(Epoll& epoll)
+{
+	_epoll = &epoll;
+	_epoll->add(&_source, EpollEventType::IN | EpollEventType::RDHUP | EpollEventType::ET);
+
+	for (Sink *sink : _sinks) {
+		watch(*sink);
+	}
+}
+
+/**
+ * Removes the source and the sinks from the given epoll instance.
+ * @param epoll The epoll instance the fan-out stage was attached to.
+ */
+void TeeFanOut::detach(Epoll& epoll)
+{
+	epoll.remove(&_source);
+
+	for (Sink *sink : _sinks) {
+		try {
+			epoll.remove(&sink->fd);
+		} catch (const EpollException&) {
+		}
+	}
+
+	_epoll = nullptr;
+}
+
+/**
+ * Registers a sink with the epoll instance the stage is attached to, so that it is drained
+ * when it becomes writable.
+ */
+void TeeFanOut::watch(Sink& sink)
+{
+	try {
+		_epoll->add(&sink.fd, EpollEventType::OUT | EpollEventType::ET);
+	} catch (const EpollException&) {
+		// Regular files (such as a capture file) cannot be polled, but they are also always
+		// writable, so they never need to wake the fan-out stage.
+	}
+}
+
+/**
+ * Handles a readiness event, if it belongs to the source or to one of the sinks.
+ * @param event The event returned from Epoll::wait.
+ * @return True if the event was consumed by this fan-out stage.
+ */
+bool TeeFanOut::handle(const EpollEvent& event)
+{
+	bool ours = (event.fd == &_source);
+
+	for (Sink *sink : _sinks) {
+		ours |= (event.fd == &sink->fd);
+	}
+
+	if (ours) {
+		pump();
+	}
+
+	return ours;
+}
+
+/**
+ * Moves as much data as possible from the source to the sinks, until the source and every
+ * sink would block.
+ */
+void TeeFanOut::pump()
+{
+	bool progress;
+
+	do {
+		progress = false;
+
+		// Drain the sinks first, so that they have as much room as possible for the next
+		// chunk from the source.
+		for (Sink *sink : _sinks) {
+			if (sink->connected && sink->buffered > 0) {
+				progress |= drain(*sink);
+			}
+		}
+
+		if (!_source_closed) {
+			progress |= fill();
+		}
+	} while (progress);
+}
+
+/**
+ * Returns true once the source has reached end-of-stream, and every connected sink has been
+ * sent everything that was buffered for it.
+ */
+bool TeeFanOut::finished() const
+{
+	if (!_source_closed) {
+		return false;
+	}
+
+	for (const Sink *sink : _sinks) {
+		if (sink->connected && sink->buffered > 0) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Takes one chunk from the source, and distributes it to the sinks.
+ * @return True if any data was taken, or the source was closed.
+ */
+bool TeeFanOut::fill()
+{
+	int rc;
+
+	if (_source_spliceable) {
+		rc = _input.splice_in(_source, _chunk_size, SpliceFlags::MOVE | SpliceFlags::NON_BLOCK);
+
+		if (rc < 0 && errno == EINVAL) {
+			// The source does not support splicing (e.g. some character devices), so
+			// fall back to copying chunks into the input pipe.
+			_source_spliceable = false;
+		}
+	}
+
+	if (!_source_spliceable) {
+		// The copy buffer is only needed once splicing has been found not to work.
+		if (_copy_buffer.size() != _chunk_size) {
+			_copy_buffer.resize(_chunk_size);
+		}
+
+		rc = _source.read(_copy_buffer.data(), _copy_buffer.size());
+		if (rc > 0 && _input.write_end().write(_copy_buffer.data(), rc) != rc) {
+			throw TeeFanOutException("Unable to write chunk into input pipe");
+		}
+	}
+
+	if (rc < 0) {
+		if (errno == EAGAIN || errno == EINTR) {
+			return false;
+		}
+
+		_source_closed = true;
+		return true;
+	}
+
+	if (rc == 0) {
+		_source_closed = true;
+		return true;
+	}
+
+	_received += rc;
+	distribute((size_t)rc);
+
+	return true;
+}
+
+/**
+ * Duplicates the contents of the input pipe into each sink's pipe, and then consumes it.
+ * @param length The number of bytes in the input pipe.
+ */
+void TeeFanOut::distribute(size_t length)
+{
+	for (Sink *sink : _sinks) {
+		if (!sink->connected) {
+			continue;
+		}
+
+		if (sink->capacity - sink->buffered < length) {
+			overflow(*sink, length);
+			continue;
+		}
+
+		int rc = _input.tee(sink->pipe, length, SpliceFlags::NON_BLOCK);
+		if (rc < 0) {
+			rc = 0;
+		}
+
+		sink->buffered += rc;
+
+		// The pipe capacity is measured in page-sized buffers rather than in bytes, so a chunk
+		// made of many small buffers may only partially fit, even if there were enough bytes free.
+		if ((size_t)rc < length) {
+			overflow(*sink, length - rc);
+		}
+	}
+
+	// Every sink has its own reference to the data now, so release it from the input pipe.
+	while (length > 0) {
+		int rc = _input.splice_out(_discard, length, SpliceFlags::MOVE);
+		if (rc <= 0) {
+			throw TeeFanOutException("Unable to consume input pipe");
+		}
+
+		length -= rc;
+	}
+}
+
+/**
+ * Moves buffered data from a sink's pipe into the sink.
+ * @param sink The sink to write to.
+ * @return True if any data was written, or the sink was disconnected.
+ */
+bool TeeFanOut::drain(Sink& sink)
+{
+	// A sink whose reader has gone away fails with EPIPE (splice_out keeps SIGPIPE from
+	// killing the process), and is disconnected.
+	int rc = sink.pipe.splice_out(sink.fd, sink.buffered, SpliceFlags::MOVE | SpliceFlags::NON_BLOCK);
+
+	if (rc > 0) {
+		sink.buffered -= rc;
+		sink.delivered += rc;
+		return true;
+	}
+
+	if (rc < 0 && (errno == EAGAIN || errno == EINTR)) {
+		return false;
+	}
+
+	disconnect(sink);
+	return true;
+}
+
+/**
+ * Applies a sink's policy when it cannot accept any more data.
+ * @param sink The sink that has fallen behind.
+ * @param length The number of bytes that could not be given to the sink.
+ */
+void TeeFanOut::overflow(Sink& sink, size_t length)
+{
+	sink.dropped += length;
+
+	if (sink.policy == FanOutPolicy::Disconnect) {
+		disconnect(sink);
+	}
+}
+
+/**
+ * Stops delivering data to a sink, and releases whatever was buffered for it.
+ * @param sink The sink to disconnect.
+ */
+void TeeFanOut::disconnect(Sink& sink)
+{
+	while (sink.buffered > 0) {
+		int rc = sink.pipe.splice_out(_discard, sink.buffered, SpliceFlags::MOVE);
+		if (rc <= 0) {
+			break;
+		}
+
+		sink.buffered -= rc;
+		sink.dropped += rc;
+	}
+
+	sink.dropped += sink.buffered;
+	sink.buffered = 0;
+	sink.connected = false;
+}
+
+TeeFanOut::Sink::Sink(FileDescriptor& fd, FanOutPolicy::FanOutPolicy policy)
+	: fd(fd), policy(policy), pipe(true), capacity(0), buffered(0), delivered(0), dropped(0), connected(true)
+{
+}
@@ -0,0 +1,94 @@
+/**
+ * src/timer.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/timer.h>
+#include <sfd/metrics.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <errno.h>
+
+using namespace sfd;
+
+/**
+ * Creates a new, disarmed, managed timerfd object.
+ */
+Timer::Timer() : FileDescriptor(::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC))
+{
+	if (!valid()) {
+		throw TimerException("Error whilst creating timerfd");
+	}
+}
+
+/**
+ * Arms the timer.
+ * @param initial_ns The time until the first expiry, in nanoseconds.  This must be non-zero.
+ * @param interval_ns The period of subsequent expiries, in nanoseconds, or zero for a one-shot timer.
+ */
+void Timer::arm(uint64_t initial_ns, uint64_t interval_ns)
+{
+	struct itimerspec spec;
+	spec.it_value.tv_sec = initial_ns / 1000000000ull;
+	spec.it_value.tv_nsec = initial_ns % 1000000000ull;
+	spec.it_interval.tv_sec = interval_ns / 1000000000ull;
+	spec.it_interval.tv_nsec = interval_ns % 1000000000ull;
+
+	int rc = ::timerfd_settime(fd(), 0, &spec, NULL);
+	SFD_METRIC_SYSCALL(TIMER, rc);
+
+	if (rc < 0) {
+		throw TimerException("Unable to arm timer");
+	}
+}
+
+/**
+ * Disarms the timer.
+ */
+void Timer::disarm()
+{
+	struct itimerspec spec = {};
+
+	int rc = ::timerfd_settime(fd(), 0, &spec, NULL);
+	SFD_METRIC_SYSCALL(TIMER, rc);
+
+	if (rc < 0) {
+		throw TimerException("Unable to disarm timer");
+	}
+}
+
+/**
+ * Acknowledges the timer, by reading and resetting its expiry count.
+ * @return The number of times the timer has expired since it was last acknowledged, or zero
+ * if it has not expired.
+ */
+uint64_t Timer::acknowledge()
+{
+	uint64_t expirations;
+
+	int rc = ::read(fd(), &expirations, sizeof(expirations));
+	SFD_METRIC_SYSCALL(TIMER, rc);
+
+	if (rc != sizeof(expirations)) {
+		if (errno == EAGAIN) {
+			return 0;
+		}
+
+		throw TimerException("Unable to acknowledge timer");
+	}
+
+	return expirations;
+}
@@ -0,0 +1,248 @@
+/**
+ * src/trace.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/trace.h>
+#include <sfd/regular-file.h>
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <vector>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+using namespace sfd;
+using namespace sfd::trace;
+
+namespace {
+	/**
+	 * Tracks the trace ring of every live thread.  The rings of threads that have exited are
+	 * released with them.
+	 */
+	struct Registry {
+		std::mutex lock;
+		std::vector<TraceRing *> rings;
+		size_t records_per_thread;
+		uint64_t calibration_ticks;
+		uint64_t calibration_ns;
+
+		Registry() : records_per_thread(65536) {
+			calibrate(calibration_ticks, calibration_ns);
+		}
+
+		static void calibrate(uint64_t& ticks, uint64_t& ns) {
+			struct timespec ts;
+
+			ticks = timestamp();
+			::clock_gettime(CLOCK_MONOTONIC, &ts);
+			ns = (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+		}
+	};
+
+	Registry& registry()
+	{
+		// Deliberately leaked, so that threads exiting during static destruction can still
+		// unregister their rings.
+		static Registry *instance = new Registry();
+		return *instance;
+	}
+
+	/**
+	 * Owns a thread's trace ring, registering it when the thread first records an event and
+	 * unregistering it when the thread exits.
+	 */
+	struct TraceRingHolder {
+		TraceRing ring;
+
+		TraceRingHolder() {
+			Registry& r = registry();
+			std::lock_guard<std::mutex> guard(r.lock);
+
+			// Round the capacity up to a power of two, so that positions can be masked.
+			size_t capacity = 1;
+			while (capacity < r.records_per_thread) {
+				capacity <<= 1;
+			}
+
+			ring.head.store(0, std::memory_order_relaxed);
+			ring.mask = capacity - 1;
+			ring.records = new TraceRecord[capacity]();
+			ring.thread_id = (uint64_t)::syscall(SYS_gettid);
+
+			r.rings.push_back(&ring);
+		}
+
+		~TraceRingHolder() {
+			Registry& r = registry();
+			std::lock_guard<std::mutex> guard(r.lock);
+
+			r.rings.erase(std::remove(r.rings.begin(), r.rings.end(), &ring), r.rings.end());
+			delete[] ring.records;
+		}
+	};
+
+	void append(std::vector<char>& buffer, const void *data, size_t length)
+	{
+		buffer.insert(buffer.end(), (const char *)data, (const char *)data + length);
+	}
+
+	void write_fully(FileDescriptor& out, const void *data, size_t length)
+	{
+		const char *p = (const char *)data;
+
+		while (length > 0) {
+			int rc = out.write(p, length);
+			if (rc <= 0) {
+				throw FileDescriptorException("Unable to write trace dump");
+			}
+
+			p += rc;
+			length -= rc;
+		}
+	}
+}
+
+/**
+ * Returns true if the library was built with tracing enabled (SFD_TRACE).
+ */
+bool sfd::trace::enabled()
+{
+#ifdef SFD_TRACE
+	return true;
+#else
+	return false;
+#endif
+}
+
+/**
+ * Sets the number of records each thread's trace ring holds.  This only affects threads
+ * that have not yet recorded an event, so it should be called early, before any threads
+ * are started.
+ * @param records_per_thread The number of records per ring, rounded up to a power of two.
+ */
+void sfd::trace::configure(size_t records_per_thread)
+{
+	Registry& r = registry();
+	std::lock_guard<std::mutex> guard(r.lock);
+
+	r.records_per_thread = std::max(records_per_thread, (size_t)1);
+}
+
+/**
+ * Returns the calling thread's trace ring, creating it on first use.
+ */
+TraceRing& sfd::trace::thread_ring()
+{
+	static thread_local TraceRingHolder holder;
+	return holder.ring;
+}
+
+/**
+ * Writes the contents of every thread's trace ring to the given file descriptor, in the
+ * format described by TraceFileHeader.  The threads are not stopped while this happens.
+ * @param out The file descriptor to write the dump to.
+ */
+void sfd::trace::dump(FileDescriptor& out)
+{
+	Registry& r = registry();
+	std::vector<char> snapshot;
+
+	// The rings are copied out under the lock, and written after it is released: writing
+	// records a trace event, which may register the calling thread's ring, and so take the
+	// lock itself.
+	{
+		std::lock_guard<std::mutex> guard(r.lock);
+
+		TraceFileHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, TraceMagic, sizeof(header.magic));
+		header.version = TraceVersion;
+		header.clock = clock();
+		header.calibration_ticks[0] = r.calibration_ticks;
+		header.calibration_ns[0] = r.calibration_ns;
+		Registry::calibrate(header.calibration_ticks[1], header.calibration_ns[1]);
+		header.thread_count = r.rings.size();
+		header.record_size = sizeof(TraceRecord);
+
+		append(snapshot, &header, sizeof(header));
+
+		for (const TraceRing *ring : r.rings) {
+			uint64_t head = ring->head.load(std::memory_order_acquire);
+			uint64_t capacity = ring->mask + 1;
+			uint64_t first = head > capacity ? head - capacity : 0;
+
+			TraceThreadHeader thread_header;
+			thread_header.thread_id = ring->thread_id;
+			thread_header.record_count = head - first;
+
+			append(snapshot, &thread_header, sizeof(thread_header));
+
+			for (uint64_t position = first; position < head; position++) {
+				append(snapshot, &ring->records[position & ring->mask], sizeof(TraceRecord));
+			}
+		}
+	}
+
+	write_fully(out, snapshot.data(), snapshot.size());
+}
+
+/**
+ * Creates a signalfd that dumps the trace rings when the given signal arrives.  Each dump is
+ * written to a new file named <path_prefix>.<pid>.<sequence>.trace.
+ * @param path_prefix The prefix of the dump file names.
+ * @param signal The signal that triggers a dump.
+ */
+TraceDumpSignal::TraceDumpSignal(const std::string& path_prefix, Signals::Signals signal)
+	: Signal({ signal }), _path_prefix(path_prefix), _sequence(0)
+{
+}
+
+/**
+ * Handles a readiness event, if it belongs to this signalfd, by writing a dump for each
+ * pending signal.
+ * @param event The event returned from Epoll::wait.
+ * @return True if the event was consumed.
+ */
+bool TraceDumpSignal::handle(const EpollEvent& event)
+{
+	if (event.fd != this) {
+		return false;
+	}
+
+	while (acknowledge() != 0) {
+		dump_now();
+	}
+
+	return true;
+}
+
+/**
+ * Writes a dump immediately.
+ * @return The name of the file the dump was written to.
+ */
+std::string TraceDumpSignal::dump_now()
+{
+	std::stringstream path;
+	path << _path_prefix << "." << ::getpid() << "." << _sequence++ << ".trace";
+
+	RegularFile file(path.str(), FileOpenMode::WRITE | FileOpenMode::CREATE | FileOpenMode::TRUNCATE);
+	dump(file);
+
+	return path.str();
+}
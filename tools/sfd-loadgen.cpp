@@ -0,0 +1,719 @@
+/**
+ * tools/sfd-loadgen.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/epoll.h>
+#include <sfd/event.h>
+#include <sfd/metrics.h>
+#include <sfd/net/socket.h>
+#include <sfd/net/ip-endpoint.h>
+#include <sfd/net/unix-endpoint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <errno.h>
+#include <getopt.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+using namespace sfd;
+using namespace sfd::net;
+
+/**
+ * A loopback load generator.  Runs an echo server and a multi-threaded client against it over
+ * TCP, UDP or Unix stream sockets, and prints a JSON report of the throughput, connection rate
+ * and latency of the run.  The server and client can also be run separately.
+ *
+ * Modes:
+ *   rr   Each connection sends a message and waits for it to be echoed, keeping up to
+ *        --depth messages outstanding.  Measures message rate, throughput and round-trip latency.
+ *   cps  Each client thread repeatedly connects, exchanges one message and disconnects.
+ *        Measures the connection rate and the latency of the whole exchange.  With --fast-open,
+ *        the message is carried in the SYN where the server accepts TCP Fast Open.
+ */
+
+namespace {
+	enum class Transport { TCP, UDP, Unix };
+	enum class Mode { RR, CPS };
+
+	struct Options {
+		Transport transport = Transport::TCP;
+		Mode mode = Mode::RR;
+		unsigned int connections = 16;
+		unsigned int threads = 2;
+		unsigned int server_threads = 2;
+		unsigned int depth = 1;
+		size_t size = 64;
+		double duration = 5.0;
+		int port = 47700;
+		std::string path = "/tmp/sfd-loadgen.sock";
+		bool run_server = true;
+		bool run_client = true;
+		bool fast_open = false;
+		bool defer_accept = false;
+	};
+
+	const char *transport_name(Transport transport)
+	{
+		switch (transport) {
+		case Transport::TCP: return "tcp";
+		case Transport::UDP: return "udp";
+		default: return "unix";
+		}
+	}
+
+	EndPoint *create_endpoint(const Options& options)
+	{
+		if (options.transport == Transport::Unix) {
+			return new UnixEndPoint(options.path);
+		}
+
+		return new IPEndPoint(IPAddress::localhost(), options.port);
+	}
+
+	Socket *create_socket(const Options& options)
+	{
+		switch (options.transport) {
+		case Transport::TCP: return new IPSocket(SocketType::Stream, ProtocolType::TCP);
+		case Transport::UDP: return new IPSocket(SocketType::Datagram, ProtocolType::UDP);
+		default: return new UnixSocket(SocketType::Stream);
+		}
+	}
+
+	bool would_block(int rc)
+	{
+		return rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+	}
+
+	/**
+	 * An echo server with one epoll loop per thread.  Stream listeners are registered with
+	 * every loop, and whichever loop wins the accept serves the connection.  The UDP socket is
+	 * shared in the same way.
+	 */
+	class EchoServer {
+	public:
+		EchoServer(const Options& options) : _options(options), _socket(nullptr), _stopping(false) {
+		}
+
+		~EchoServer() {
+			stop();
+		}
+
+		void start() {
+			EndPoint *ep = create_endpoint(_options);
+
+			if (_options.transport == Transport::Unix) {
+				::unlink(_options.path.c_str());
+			}
+
+			_socket = create_socket(_options);
+
+			_socket->reuse_address(true);
+
+			_socket->bind(*ep);
+			delete ep;
+
+			if (_options.transport == Transport::TCP) {
+				ListenOptions listen_options;
+				listen_options.fast_open_queue = _options.fast_open ? 1024 : 0;
+				listen_options.defer_accept_seconds = _options.defer_accept ? 1 : 0;
+
+				_socket->listen(1024, listen_options);
+			} else if (_options.transport != Transport::UDP) {
+				_socket->listen(1024);
+			}
+
+			_socket->non_blocking(true);
+
+			for (unsigned int i = 0; i < _options.server_threads; i++) {
+				_stops.push_back(new Event());
+			}
+
+			for (unsigned int i = 0; i < _options.server_threads; i++) {
+				_threads.push_back(std::thread(&EchoServer::loop, this, _stops[i]));
+			}
+		}
+
+		void stop() {
+			if (_stopping) {
+				return;
+			}
+
+			_stopping = true;
+
+			for (Event *stop : _stops) {
+				stop->invoke();
+			}
+
+			for (std::thread& thread : _threads) {
+				thread.join();
+			}
+
+			for (Event *stop : _stops) {
+				delete stop;
+			}
+
+			delete _socket;
+		}
+
+	private:
+		struct Connection {
+			Socket *socket;
+			std::vector<char> pending;
+			size_t pending_offset;
+		};
+
+		void loop(Event *stop) {
+			Epoll epoll;
+			std::unordered_map<FileDescriptor *, Connection *> connections;
+			std::vector<char> buffer(std::max(_options.size, (size_t)65536));
+
+			epoll.add(stop, EpollEventType::IN);
+			epoll.add(_socket, EpollEventType::IN | EpollEventType::ET);
+
+			for (;;) {
+				std::vector<EpollEvent> events;
+				epoll.wait(events, 256, -1);
+
+				for (const EpollEvent& event : events) {
+					if (event.fd == stop) {
+						for (auto& entry : connections) {
+							delete entry.second->socket;
+							delete entry.second;
+						}
+
+						return;
+					}
+
+					if (event.fd == _socket) {
+						if (_options.transport == Transport::UDP) {
+							echo_datagrams(buffer);
+						} else {
+							accept_all(epoll, connections);
+						}
+
+						continue;
+					}
+
+					auto connection = connections.find(event.fd);
+					if (connection == connections.end()) {
+						continue;
+					}
+
+					if (!serve(*connection->second, buffer)) {
+						epoll.remove(connection->second->socket);
+						delete connection->second->socket;
+						delete connection->second;
+						connections.erase(connection);
+					}
+				}
+			}
+		}
+
+		void accept_all(Epoll& epoll, std::unordered_map<FileDescriptor *, Connection *>& connections) {
+			for (;;) {
+				Socket *socket = _socket->accept();
+				if (!socket) {
+					return;
+				}
+
+				socket->non_blocking(true);
+
+				if (_options.transport == Transport::TCP) {
+					socket->no_delay(true);
+				}
+
+				Connection *connection = new Connection { socket, std::vector<char>(), 0 };
+				connections[socket] = connection;
+				epoll.add(socket, EpollEventType::IN | EpollEventType::OUT | EpollEventType::RDHUP | EpollEventType::ET);
+			}
+		}
+
+		/**
+		 * Echoes everything readable on a stream connection, buffering whatever cannot be
+		 * written immediately.  Reading stops while anything is buffered, and resumes on the
+		 * writable edge that follows.
+		 * @return False if the connection has closed.
+		 */
+		bool serve(Connection& connection, std::vector<char>& buffer) {
+			for (;;) {
+				while (connection.pending_offset < connection.pending.size()) {
+					int rc = connection.socket->write(connection.pending.data() + connection.pending_offset, connection.pending.size() - connection.pending_offset);
+					if (would_block(rc)) {
+						return true;
+					} else if (rc <= 0) {
+						return false;
+					}
+
+					connection.pending_offset += rc;
+				}
+
+				connection.pending.clear();
+				connection.pending_offset = 0;
+
+				int rc = connection.socket->read(buffer.data(), buffer.size());
+				if (would_block(rc)) {
+					return true;
+				} else if (rc <= 0) {
+					return false;
+				}
+
+				int written = connection.socket->write(buffer.data(), rc);
+				if (would_block(written)) {
+					written = 0;
+				} else if (written < 0) {
+					return false;
+				}
+
+				if (written < rc) {
+					connection.pending.assign(buffer.data() + written, buffer.data() + rc);
+				}
+			}
+		}
+
+		void echo_datagrams(std::vector<char>& buffer) {
+			for (;;) {
+				// Socket::recv_from throws when the socket would block, which is the normal way
+				// out of this loop, so the datagrams are echoed with recvfrom and sendto directly.
+				struct sockaddr_storage from;
+				socklen_t from_length = sizeof(from);
+
+				ssize_t rc = ::recvfrom(_socket->fd(), buffer.data(), buffer.size(), 0, (struct sockaddr *)&from, &from_length);
+				if (rc < 0) {
+					return;
+				}
+
+				::sendto(_socket->fd(), buffer.data(), rc, 0, (struct sockaddr *)&from, from_length);
+			}
+		}
+
+		const Options& _options;
+		Socket *_socket;
+		std::vector<Event *> _stops;
+		std::vector<std::thread> _threads;
+		bool _stopping;
+	};
+
+	struct ClientResult {
+		uint64_t messages = 0;
+		uint64_t bytes = 0;
+		uint64_t connections = 0;
+		uint64_t errors = 0;
+		metrics::LatencyHistogram latency;
+	};
+
+	/**
+	 * Runs request-response traffic over a thread's share of the connections, until the
+	 * deadline passes.
+	 */
+	void run_rr_client(const Options& options, unsigned int connection_count, uint64_t deadline, ClientResult& result)
+	{
+		struct Connection {
+			Socket *socket;
+			std::deque<uint64_t> sent_at;
+			size_t send_offset;
+			size_t received;
+		};
+
+		EndPoint *ep = create_endpoint(options);
+		Epoll epoll;
+		std::unordered_map<FileDescriptor *, Connection *> connections;
+		std::vector<char> message(options.size, 'x');
+		std::vector<char> buffer(std::max(options.size, (size_t)65536));
+
+		for (unsigned int i = 0; i < connection_count; i++) {
+			Socket *socket = create_socket(options);
+
+			try {
+				socket->connect(*ep);
+			} catch (const SocketException&) {
+				result.errors++;
+				delete socket;
+				continue;
+			}
+
+			if (options.transport == Transport::TCP) {
+				socket->no_delay(true);
+			}
+
+			socket->non_blocking(true);
+			result.connections++;
+
+			Connection *connection = new Connection { socket, std::deque<uint64_t>(), 0, 0 };
+			connections[socket] = connection;
+			epoll.add(socket, EpollEventType::IN | EpollEventType::OUT | EpollEventType::ET);
+		}
+
+		// Sends messages until the connection has depth outstanding, or the socket is full.
+		auto send_more = [&](Connection& c) -> bool {
+			uint64_t now = metrics::now();
+
+			while (c.sent_at.size() < options.depth || c.send_offset > 0) {
+				if (now >= deadline && c.send_offset == 0) {
+					return true;
+				}
+
+				int rc = c.socket->write(message.data() + c.send_offset, message.size() - c.send_offset);
+				if (would_block(rc)) {
+					return true;
+				} else if (rc <= 0) {
+					return false;
+				}
+
+				if (c.send_offset == 0) {
+					c.sent_at.push_back(now);
+				}
+
+				c.send_offset += rc;
+				if (c.send_offset == message.size() || options.transport == Transport::UDP) {
+					c.send_offset = 0;
+				}
+			}
+
+			return true;
+		};
+
+		auto receive = [&](Connection& c) -> bool {
+			for (;;) {
+				int rc = c.socket->read(buffer.data(), buffer.size());
+				if (would_block(rc)) {
+					return true;
+				} else if (rc <= 0) {
+					return false;
+				}
+
+				result.bytes += rc;
+				c.received += (options.transport == Transport::UDP) ? options.size : (size_t)rc;
+
+				while (c.received >= options.size && !c.sent_at.empty()) {
+					c.received -= options.size;
+					result.latency.record(metrics::now() - c.sent_at.front());
+					result.messages++;
+					c.sent_at.pop_front();
+				}
+			}
+		};
+
+		for (auto& entry : connections) {
+			send_more(*entry.second);
+		}
+
+		uint64_t last_progress = metrics::now();
+
+		while (!connections.empty()) {
+			uint64_t now = metrics::now();
+			bool outstanding = false;
+
+			for (auto& entry : connections) {
+				outstanding |= !entry.second->sent_at.empty();
+			}
+
+			if (now >= deadline && !outstanding) {
+				break;
+			}
+
+			// Datagrams can be lost, which would stall a closed loop forever, so give up on
+			// replies that have not arrived within a second.
+			if (now - last_progress > 1000000000ull) {
+				for (auto& entry : connections) {
+					result.errors += entry.second->sent_at.size();
+					entry.second->sent_at.clear();
+					entry.second->received = 0;
+
+					if (now < deadline) {
+						send_more(*entry.second);
+					}
+				}
+
+				last_progress = now;
+				continue;
+			}
+
+			std::vector<EpollEvent> events;
+			epoll.wait(events, 256, 100);
+
+			for (const EpollEvent& event : events) {
+				auto entry = connections.find(event.fd);
+				if (entry == connections.end()) {
+					continue;
+				}
+
+				Connection& c = *entry->second;
+				uint64_t before = result.messages;
+
+				if (!receive(c) || !send_more(c)) {
+					result.errors++;
+					epoll.remove(c.socket);
+					delete c.socket;
+					delete entry->second;
+					connections.erase(entry);
+					continue;
+				}
+
+				if (result.messages != before) {
+					last_progress = metrics::now();
+				}
+			}
+		}
+
+		for (auto& entry : connections) {
+			delete entry.second->socket;
+			delete entry.second;
+		}
+
+		delete ep;
+	}
+
+	/**
+	 * Repeatedly connects, exchanges one message and disconnects, until the deadline passes.
+	 */
+	void run_cps_client(const Options& options, uint64_t deadline, ClientResult& result)
+	{
+		EndPoint *ep = create_endpoint(options);
+		std::vector<char> message(options.size, 'x');
+		std::vector<char> buffer(options.size);
+
+		while (metrics::now() < deadline) {
+			uint64_t start = metrics::now();
+			Socket *socket = create_socket(options);
+
+			try {
+				size_t sent;
+
+				if (options.fast_open) {
+					sent = socket->connect_with_data(*ep, message.data(), message.size());
+				} else {
+					socket->connect(*ep);
+					sent = socket->write(message.data(), message.size());
+				}
+
+				size_t received = 0;
+				if (sent == message.size()) {
+					while (received < options.size) {
+						int rc = socket->read(buffer.data(), buffer.size());
+						if (rc <= 0) {
+							break;
+						}
+
+						received += rc;
+					}
+				}
+
+				if (received == options.size) {
+					result.connections++;
+					result.messages++;
+					result.bytes += received;
+					result.latency.record(metrics::now() - start);
+				} else {
+					result.errors++;
+				}
+
+				// Reset rather than close gracefully, so that connections in TIME_WAIT do not
+				// exhaust the ephemeral ports during a long run.
+				struct linger linger = { 1, 0 };
+				::setsockopt(socket->fd(), SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+			} catch (const SocketException&) {
+				result.errors++;
+			}
+
+			delete socket;
+		}
+
+		delete ep;
+	}
+
+	void report(const Options& options, const std::vector<ClientResult>& results, uint64_t elapsed_ns)
+	{
+		ClientResult total;
+
+		for (const ClientResult& result : results) {
+			total.messages += result.messages;
+			total.bytes += result.bytes;
+			total.connections += result.connections;
+			total.errors += result.errors;
+			total.latency.merge(result.latency);
+		}
+
+		double seconds = (double)elapsed_ns / 1e9;
+
+		printf("{\"tool\":\"sfd-loadgen\",\"transport\":\"%s\",\"mode\":\"%s\",\"connections\":%u,\"threads\":%u,\"server_threads\":%u,"
+				"\"depth\":%u,\"size\":%zu,\"duration_s\":%.3f,\"fast_open\":%d,\"defer_accept\":%d,\"metrics\":%d,",
+				transport_name(options.transport), options.mode == Mode::RR ? "rr" : "cps",
+				options.connections, options.threads, options.server_threads, options.depth, options.size,
+				seconds, options.fast_open, options.defer_accept, metrics::enabled());
+
+		printf("\"messages\":%lu,\"messages_per_sec\":%.1f,\"mb_per_sec\":%.3f,\"connections_established\":%lu,\"connections_per_sec\":%.1f,\"errors\":%lu,",
+				(unsigned long)total.messages, (double)total.messages / seconds, (double)total.bytes / seconds / 1e6,
+				(unsigned long)total.connections, options.mode == Mode::CPS ? (double)total.connections / seconds : 0.0,
+				(unsigned long)total.errors);
+
+		printf("\"latency_p50_ns\":%lu,\"latency_p99_ns\":%lu,\"latency_p999_ns\":%lu,\"latency_max_ns\":%lu}\n",
+				(unsigned long)total.latency.percentile(50), (unsigned long)total.latency.percentile(99),
+				(unsigned long)total.latency.percentile(99.9), (unsigned long)total.latency.max());
+	}
+
+	void usage(const char *program)
+	{
+		fprintf(stderr,
+			"usage: %s [options]\n"
+			"  --transport tcp|udp|unix  transport to use (default tcp)\n"
+			"  --mode rr|cps             request-response or connection-rate (default rr)\n"
+			"  --connections N           concurrent client connections (default 16)\n"
+			"  --threads N               client threads (default 2)\n"
+			"  --server-threads N        server threads (default 2)\n"
+			"  --depth N                 outstanding messages per connection (default 1)\n"
+			"  --size BYTES              message size (default 64)\n"
+			"  --duration SECONDS        length of the run (default 5)\n"
+			"  --port PORT               TCP/UDP port (default 47700)\n"
+			"  --path PATH               Unix socket path (default /tmp/sfd-loadgen.sock)\n"
+			"  --fast-open               use TCP Fast Open (server queue and client SYN data)\n"
+			"  --defer-accept            only wake the server once a connection has sent data\n"
+			"  --server-only             only run the server, until interrupted\n"
+			"  --client-only             only run the client, against an existing server\n",
+			program);
+	}
+
+	bool parse(int argc, char **argv, Options& options)
+	{
+		static const struct option long_options[] = {
+			{ "transport", required_argument, NULL, 't' },
+			{ "mode", required_argument, NULL, 'm' },
+			{ "connections", required_argument, NULL, 'c' },
+			{ "threads", required_argument, NULL, 'T' },
+			{ "server-threads", required_argument, NULL, 'S' },
+			{ "depth", required_argument, NULL, 'd' },
+			{ "size", required_argument, NULL, 's' },
+			{ "duration", required_argument, NULL, 'D' },
+			{ "port", required_argument, NULL, 'p' },
+			{ "path", required_argument, NULL, 'P' },
+			{ "server-only", no_argument, NULL, 'o' },
+			{ "client-only", no_argument, NULL, 'C' },
+			{ "fast-open", no_argument, NULL, 'F' },
+			{ "defer-accept", no_argument, NULL, 'A' },
+			{ NULL, 0, NULL, 0 }
+		};
+
+		int option;
+		while ((option = getopt_long(argc, argv, "", long_options, NULL)) != -1) {
+			switch (option) {
+			case 't':
+				if (strcmp(optarg, "tcp") == 0) options.transport = Transport::TCP;
+				else if (strcmp(optarg, "udp") == 0) options.transport = Transport::UDP;
+				else if (strcmp(optarg, "unix") == 0) options.transport = Transport::Unix;
+				else return false;
+				break;
+			case 'm':
+				if (strcmp(optarg, "rr") == 0) options.mode = Mode::RR;
+				else if (strcmp(optarg, "cps") == 0) options.mode = Mode::CPS;
+				else return false;
+				break;
+			case 'c': options.connections = std::max(1, atoi(optarg)); break;
+			case 'T': options.threads = std::max(1, atoi(optarg)); break;
+			case 'S': options.server_threads = std::max(1, atoi(optarg)); break;
+			case 'd': options.depth = std::max(1, atoi(optarg)); break;
+			case 's': options.size = std::max(1, atoi(optarg)); break;
+			case 'D': options.duration = atof(optarg); break;
+			case 'p': options.port = atoi(optarg); break;
+			case 'P': options.path = optarg; break;
+			case 'o': options.run_client = false; break;
+			case 'C': options.run_server = false; break;
+			case 'F': options.fast_open = true; break;
+			case 'A': options.defer_accept = true; break;
+			default: return false;
+			}
+		}
+
+		if (options.mode == Mode::CPS && options.transport == Transport::UDP) {
+			fprintf(stderr, "error: cps mode needs a connection-oriented transport\n");
+			return false;
+		}
+
+		if ((options.fast_open || options.defer_accept) && options.transport != Transport::TCP) {
+			fprintf(stderr, "error: --fast-open and --defer-accept need the tcp transport\n");
+			return false;
+		}
+
+		if (options.transport == Transport::UDP && options.size > 65507) {
+			fprintf(stderr, "error: UDP messages are limited to 65507 bytes\n");
+			return false;
+		}
+
+		return true;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	Options options;
+
+	if (!parse(argc, argv, options)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	EchoServer server(options);
+
+	try {
+		if (options.run_server) {
+			server.start();
+		}
+
+		if (!options.run_client) {
+			pause();
+			return 0;
+		}
+
+		std::vector<ClientResult> results(options.threads);
+		std::vector<std::thread> threads;
+
+		uint64_t start = metrics::now();
+		uint64_t deadline = start + (uint64_t)(options.duration * 1e9);
+
+		for (unsigned int i = 0; i < options.threads; i++) {
+			// Spread the connections over the threads as evenly as possible.
+			unsigned int share = options.connections / options.threads + (i < options.connections % options.threads ? 1 : 0);
+
+			threads.push_back(std::thread([&options, &results, i, share, deadline]() {
+				if (options.mode == Mode::RR) {
+					run_rr_client(options, share, deadline, results[i]);
+				} else {
+					run_cps_client(options, deadline, results[i]);
+				}
+			}));
+		}
+
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+
+		report(options, results, metrics::now() - start);
+	} catch (const Exception& ex) {
+		fprintf(stderr, "error: %s\n", ex.message().c_str());
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,156 @@
+/**
+ * tools/sfd-trace-decode.cpp
+ *
+ * Copyright (c) 2016 Tom Spink <tspink@gmail.com>
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <sfd/trace.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+
+using namespace sfd::trace;
+
+/**
+ * Decodes a trace dump written by sfd::trace::dump (e.g. via TraceDumpSignal), and prints the
+ * records of every thread merged into a single timeline.
+ *
+ * Usage: sfd-trace-decode <dump-file> [thread-id]
+ */
+
+struct DecodedRecord {
+	uint64_t thread_id;
+	TraceRecord record;
+};
+
+static const char *event_name(uint16_t type)
+{
+	switch (type) {
+	case TraceEventType::EPOLL_WAKE: return "epoll_wake";
+	case TraceEventType::FD_READY: return "fd_ready";
+	case TraceEventType::HANDLER_START: return "handler_start";
+	case TraceEventType::HANDLER_END: return "handler_end";
+	case TraceEventType::ACCEPT: return "accept";
+	case TraceEventType::CONNECT: return "connect";
+	case TraceEventType::READ: return "read";
+	case TraceEventType::WRITE: return "write";
+	default: return "unknown";
+	}
+}
+
+static bool read_fully(FILE *f, void *buffer, size_t length)
+{
+	return fread(buffer, 1, length, f) == length;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2 || argc > 3) {
+		fprintf(stderr, "usage: %s <dump-file> [thread-id]\n", argv[0]);
+		return 1;
+	}
+
+	uint64_t only_thread = argc == 3 ? strtoull(argv[2], NULL, 10) : 0;
+
+	FILE *f = fopen(argv[1], "rb");
+	if (!f) {
+		perror("fopen");
+		return 1;
+	}
+
+	TraceFileHeader header;
+	if (!read_fully(f, &header, sizeof(header)) || memcmp(header.magic, TraceMagic, sizeof(header.magic)) != 0) {
+		fprintf(stderr, "error: not a trace dump\n");
+		return 1;
+	}
+
+	if (header.version != TraceVersion || header.record_size != sizeof(TraceRecord)) {
+		fprintf(stderr, "error: unsupported trace dump version %u (record size %u)\n", header.version, header.record_size);
+		return 1;
+	}
+
+	std::vector<DecodedRecord> records;
+	for (uint32_t i = 0; i < header.thread_count; i++) {
+		TraceThreadHeader thread_header;
+		if (!read_fully(f, &thread_header, sizeof(thread_header))) {
+			fprintf(stderr, "error: truncated trace dump\n");
+			return 1;
+		}
+
+		for (uint64_t j = 0; j < thread_header.record_count; j++) {
+			DecodedRecord r;
+			r.thread_id = thread_header.thread_id;
+
+			if (!read_fully(f, &r.record, sizeof(r.record))) {
+				fprintf(stderr, "error: truncated trace dump\n");
+				return 1;
+			}
+
+			// Skip records that were never written, or were torn by the dump.
+			if (r.record.type == 0) {
+				continue;
+			}
+
+			if (only_thread == 0 || r.thread_id == only_thread) {
+				records.push_back(r);
+			}
+		}
+	}
+
+	fclose(f);
+
+	std::stable_sort(records.begin(), records.end(), [](const DecodedRecord& l, const DecodedRecord& r) {
+		return l.record.timestamp < r.record.timestamp;
+	});
+
+	if (records.empty()) {
+		return 0;
+	}
+
+	// Convert timestamps to nanoseconds.  TSC timestamps are scaled using the two calibration
+	// points taken when the first ring was created and when the dump was written.
+	double ns_per_tick = 1.0;
+	if (header.clock == TraceClock::TSC && header.calibration_ticks[1] > header.calibration_ticks[0]) {
+		ns_per_tick = (double)(header.calibration_ns[1] - header.calibration_ns[0]) / (double)(header.calibration_ticks[1] - header.calibration_ticks[0]);
+	}
+
+	uint64_t origin = records.front().record.timestamp;
+	std::map<uint64_t, std::vector<uint64_t>> handler_starts;
+
+	printf("%14s %8s %-14s %6s %s\n", "time_us", "thread", "event", "fd", "argument");
+
+	for (const DecodedRecord& r : records) {
+		double time_us = (double)(r.record.timestamp - origin) * ns_per_tick / 1000.0;
+
+		printf("%14.3f %8lu %-14s %6d %ld", time_us, (unsigned long)r.thread_id, event_name(r.record.type), r.record.fd, (long)r.record.argument);
+
+		// Pair up handler start and end records on each thread, and report the duration.
+		std::vector<uint64_t>& starts = handler_starts[r.thread_id];
+		if (r.record.type == TraceEventType::HANDLER_START) {
+			starts.push_back(r.record.timestamp);
+		} else if (r.record.type == TraceEventType::HANDLER_END && !starts.empty()) {
+			printf("  (%.3f us)", (double)(r.record.timestamp - starts.back()) * ns_per_tick / 1000.0);
+			starts.pop_back();
+		}
+
+		printf("\n");
+	}
+
+	return 0;
+}